@@ -0,0 +1,83 @@
+#include "Allocator.h"
+
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+namespace {
+	const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	inline size_t roundUp(size_t x, size_t align) {
+		return (x + align - 1) / align * align;
+	}
+
+	class AlignedAllocator : public BufferAllocator {
+	public:
+		void * allocate(size_t bytes) override {
+#ifdef _WIN32
+			void * p = _aligned_malloc(bytes, ALIGNMENT);
+#else
+			void * p = nullptr;
+			if (posix_memalign(&p, ALIGNMENT, bytes)) p = nullptr;
+#endif
+			if (!p) throw std::bad_alloc();
+			return p;
+		}
+		void deallocate(void * p, size_t) override {
+#ifdef _WIN32
+			_aligned_free(p);
+#else
+			free(p);
+#endif
+		}
+		const char * name() const override { return "aligned"; }
+	};
+
+	class HugePageAllocator : public BufferAllocator {
+	public:
+		void * allocate(size_t bytes) override {
+#ifdef _WIN32
+			void * p = nullptr;
+			SIZE_T large = GetLargePageMinimum();
+			if (large)
+				p = VirtualAlloc(nullptr, roundUp(bytes, large), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (!p)
+				p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			// 按大页对齐并补齐为整数个大页, 使整块内存都可以由大页映射
+			size_t size = roundUp(bytes, HUGE_PAGE_SIZE);
+			void * p = nullptr;
+			if (posix_memalign(&p, HUGE_PAGE_SIZE, size)) p = nullptr;
+#ifdef MADV_HUGEPAGE
+			if (p) madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+			if (!p) throw std::bad_alloc();
+			return p;
+		}
+		void deallocate(void * p, size_t) override {
+#ifdef _WIN32
+			VirtualFree(p, 0, MEM_RELEASE);
+#else
+			free(p);
+#endif
+		}
+		const char * name() const override { return "huge"; }
+	};
+}
+
+BufferAllocator & BufferAllocator::aligned() {
+	static AlignedAllocator allocator;
+	return allocator;
+}
+
+BufferAllocator & BufferAllocator::hugePage() {
+	static HugePageAllocator allocator;
+	return allocator;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef _ALLOCATOR_H_
+#define _ALLOCATOR_H_
+
+#include "Define.h"
+
+// 帧缓冲区等大块内存的分配器, 可以继承实现自定义的分配方式
+class BufferAllocator {
+public:
+	static const size_t ALIGNMENT = 64;         // 缓存行大小, 分配的内存至少按此对齐
+
+	virtual ~BufferAllocator() {}
+	// 分配失败时抛出std::bad_alloc
+	virtual void * allocate(size_t bytes) = 0;
+	virtual void deallocate(void * p, size_t bytes) = 0;
+	virtual const char * name() const = 0;
+
+	// 按缓存行对齐的分配器(默认)
+	static BufferAllocator & aligned();
+	// 大页分配器: Linux上按2MB对齐并建议内核使用透明大页; Windows上使用大页(需要锁定内存页的权限), 失败时退回普通页
+	static BufferAllocator & hugePage();
+};
+
+// 帧缓冲区的内存选项
+struct BufferOptions {
+	BufferAllocator * allocator;
+	bool padPitch;          // 行距补齐为奇数个缓存行, 避免相邻行的同一列映射到相同的缓存组
+	int tileSize;           // 分块布局: tileSize x tileSize(2的幂)的分块在内存中连续存放, 0为按行线性存放(此时才补齐行距)
+
+	BufferOptions(BufferAllocator * allocator = &BufferAllocator::aligned(), bool padPitch = false, int tileSize = 0)
+		: allocator(allocator), padPitch(padPitch), tileSize(tileSize) {}
+};
+
+#endif
\ No newline at end of file
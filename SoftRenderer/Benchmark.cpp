@@ -0,0 +1,1110 @@
+// 使用标准C的fopen/sscanf
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Benchmark.h"
+#include "DemoScene.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	const int totalSceneNum = DemoScene::sceneNum + DemoScene::stressSceneNum;
+
+	// 每个场景的摄像机(绕X轴角度, 绕Y轴角度, 距离)
+	const float sceneCameras[totalSceneNum][3] = {
+		{ 0, 0, 1.5f },     // triangle
+		{ 30, 40, 1.5f },   // cube
+		{ 0, 0, 1.5f },     // lines
+		{ 20, 0, 20 },      // solar_system
+		{ 0, 0, 1.5f },     // sphere_grid
+		{ 0, 0, 1.5f },     // overdraw
+	};
+
+	const char * sceneName(int index) {
+		return index < DemoScene::sceneNum ? DemoScene::sceneNames[index] : DemoScene::stressSceneNames[index - DemoScene::sceneNum];
+	}
+
+	void createScene(Scene & scene, int index, const shared_ptr<Texture> & texture, const Shader & shader, int frame, float aspect) {
+		if (index < DemoScene::sceneNum)
+			DemoScene::createScene(scene, index, texture, shader, frame);
+		else
+			DemoScene::createStressScene(scene, index - DemoScene::sceneNum, texture, shader);
+		const float * camera = sceneCameras[index];
+		DemoScene::setCamera(scene, aspect, camera[0], camera[1], camera[2]);
+	}
+
+	// 解析以逗号分隔的整数列表
+	bool parseList(const char * value, vector<int> & list, int minValue, int maxValue) {
+		list.clear();
+		for (const char * p = value; *p; ) {
+			char * end;
+			long v = strtol(p, &end, 10);
+			if (end == p || v < minValue || v > maxValue) return false;
+			list.push_back((int)v);
+			p = *end == ',' ? end + 1 : end;
+			if (*end && *end != ',') return false;
+		}
+		return !list.empty();
+	}
+
+	bool parseSizes(const char * value, vector<int> & widths, vector<int> & heights) {
+		widths.clear();
+		heights.clear();
+		for (const char * p = value; *p; ) {
+			int w, h, n;
+			if (sscanf(p, "%dx%d%n", &w, &h, &n) != 2 || w <= 0 || h <= 0) return false;
+			widths.push_back(w);
+			heights.push_back(h);
+			p += n;
+			if (*p == ',') p++;
+			else if (*p) return false;
+		}
+		return !widths.empty();
+	}
+
+	////          数学库微基准          ////
+
+	const int mathCount = 4096;     // 每轮对多少组输入各运算一次
+
+	// 可复现的伪随机数, [-1, 1)
+	struct Random {
+		unsigned state = 12345;
+		float next() {
+			state = state * 1664525u + 1013904223u;
+			return (float)(state >> 8) / (1 << 23) - 1.0f;
+		}
+	};
+
+	// 随机的仿射变换与透视投影的组合, 保证可逆
+	Matrix44 randomMatrix(Random & random) {
+		Matrix44 m;
+		m.scale(1.5f + random.next(), 1.5f + random.next(), 1.5f + random.next());
+		m.rotate(random.next(), random.next(), random.next() + 2.f, random.next() * 180);
+		m.translate(random.next() * 5, random.next() * 5, random.next() * 5 + 10);
+		Matrix44 projection;
+		projection.setPerspective(60, 1.4f, 0.1f, 100);
+		return random.next() > 0 ? m * projection : m;
+	}
+
+	// 两个矩阵元素之差的最大值
+	float maxDiff(const Matrix44 & a, const Matrix44 & b) {
+		float d = 0;
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				d = std::max(d, std::fabs(a[i][j] - b[i][j]));
+		return d;
+	}
+	float maxDiff(const Vector4 & a, const Vector4 & b) {
+		return std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)), std::max(std::fabs(a.z - b.z), std::fabs(a.w - b.w)));
+	}
+
+	// 计时: 预热后每轮对全部输入调用一次op(i), 返回每次运算的纳秒数
+	template <typename Op>
+	vector<double> timeMath(const Benchmark::Options & options, Op op) {
+		vector<double> times;
+		for (int round = 0; round < options.warmup + options.frames; round++) {
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < mathCount; i++) op(i);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / mathCount;
+			if (round >= options.warmup) times.push_back(ns);
+		}
+		return times;
+	}
+
+	// 最近秩法求分位数(times已排序)
+	double percentile(const vector<double> & times, double p) {
+		size_t rank = (size_t)std::ceil(p * times.size());
+		return times[rank > 0 ? rank - 1 : 0];
+	}
+
+	void addStats(Stats::ThreadStats & sum, const Stats::ThreadStats & frame) {
+		for (int i = 0; i < Stats::STAGE_COUNT; i++) sum.stageTime[i] += frame.stageTime[i];
+		for (int i = 0; i < Stats::COUNTER_COUNT; i++) sum.counters[i] += frame.counters[i];
+	}
+
+	const char * simdName(Simd::Level level) {
+		static const char * const names[] = { "scalar", "sse2", "avx2" };
+		return names[level];
+	}
+
+	////          覆盖测试          ////
+
+	// 不做深度测试, 把扫描线上每个像素的颜色缓冲区值加1
+	class CoverageProgram : public ShaderProgram {
+	public:
+		void shadeSpan(const ShadeSpan & span) const override {
+			for (int i = 0; i < span.count; i++)
+				span.fbPtr[i]++;
+		}
+	};
+
+	// 由屏幕坐标的顶点构成的网格, 三角形都朝向屏幕
+	struct CoverageMesh {
+		vector<Vector3> points;     // 屏幕坐标(像素)
+		vector<Primitive> triangles;
+
+		void add(size_t a, size_t b, size_t c) {
+			// 屏幕空间y向下, cross(p1 - p0, p2 - p1).z > 0 的三角形不被背面剔除
+			Vector3 e0 = points[b] - points[a], e1 = points[c] - points[b];
+			if (e0.x * e1.y - e0.y * e1.x < 0) swap(b, c);
+			triangles.push_back(Primitive{ a, b, c });
+		}
+		// 规则网格, 超出屏幕margin像素, cell为格子边长, jitter为内部顶点的随机偏移
+		void grid(int width, int height, float cell, float margin, float jitter, Random & random) {
+			int nx = (int)std::ceil((width + 2 * margin) / cell), ny = (int)std::ceil((height + 2 * margin) / cell);
+			for (int j = 0; j <= ny; j++)
+				for (int i = 0; i <= nx; i++) {
+					bool inner = i > 0 && j > 0 && i < nx && j < ny;
+					float x = -margin + i * cell + (inner ? random.next() * jitter : 0);
+					float y = -margin + j * cell + (inner ? random.next() * jitter : 0);
+					points.push_back(Vector3(x, y, 0));
+				}
+			for (int j = 0; j < ny; j++)
+				for (int i = 0; i < nx; i++) {
+					size_t a = j * (nx + 1) + i, b = a + 1, c = a + nx + 1, d = c + 1;
+					// 交替切分方向,使对角线的两个方向都被测试到
+					if ((i + j) & 1) add(a, b, d), add(a, d, c);
+					else add(a, b, c), add(b, d, c);
+				}
+		}
+		// 以屏幕中心为圆心的扇形, 外圈在屏幕外
+		void fan(int width, int height, int segments) {
+			float cx = width * 0.5f, cy = height * 0.5f, r = (float)(width + height);
+			points.push_back(Vector3(cx, cy, 0));
+			for (int i = 0; i < segments; i++) {
+				float a = 2 * Math::PI * i / segments;
+				points.push_back(Vector3(cx + r * std::cos(a), cy + r * std::sin(a), 0));
+			}
+			for (int i = 0; i < segments; i++)
+				add(0, 1 + i, 1 + (i + 1) % segments);
+		}
+	};
+
+	////          纹理缓存测试          ////
+
+	// 组相联、LRU替换的缓存模拟, 只统计命中与缺失
+	class CacheModel {
+		size_t sets, ways;
+		int lineShift;
+		vector<size_t> tags;        // 每组ways个标签, 按最近使用的顺序排列, 0为空
+	public:
+		long long accesses = 0, misses = 0;
+
+		CacheModel(size_t size, size_t ways, int lineShift) : sets(size >> lineShift) , ways(ways), lineShift(lineShift) {
+			sets /= ways;
+			tags.assign(sets * ways, 0);
+		}
+		// 访问一个地址, 缺失时返回false
+		bool access(size_t address) {
+			size_t line = (address >> lineShift) + 1;
+			size_t * set = &tags[(line % sets) * ways];
+			accesses++;
+			size_t i = 0;
+			while (i < ways && set[i] != line) i++;
+			bool hit = i < ways;
+			if (!hit) {
+				misses++;
+				i = ways - 1;
+			}
+			for (; i > 0; i--) set[i] = set[i - 1];
+			set[0] = line;
+			return hit;
+		}
+		double missRate() const { return accesses ? (double)misses / accesses : 0; }
+	};
+
+	// 屏幕像素(x, y)的纹理坐标: 纹理绕屏幕中心旋转angle度, 一个像素对应一个纹素
+	inline Vector2 rotatedTexCoord(int x, int y, int width, int height, float c, float s, int texWidth, int texHeight) {
+		float dx = x + 0.5f - width * 0.5f, dy = y + 0.5f - height * 0.5f;
+		return Vector2((c * dx - s * dy) / texWidth + 0.5f, (s * dx + c * dy) / texHeight + 0.5f);
+	}
+
+	////          帧缓冲区内存测试          ////
+
+	// 在对齐的分配上偏移4字节, 模拟没有对齐保证时最差的情况(16字节的写入有四分之一跨缓存行)
+	class OffsetAllocator : public BufferAllocator {
+	public:
+		void * allocate(size_t bytes) override { return (char *)aligned().allocate(bytes + ALIGNMENT) + 4; }
+		void deallocate(void * p, size_t bytes) override { aligned().deallocate((char *)p - 4, bytes + ALIGNMENT); }
+		const char * name() const override { return "offset4"; }
+	};
+
+	string bufferName(const BufferOptions & options) {
+		string name = string(options.allocator->name()) + (options.padPitch ? "+pitch" : "");
+		if (options.tileSize) name += "+tiled" + std::to_string(options.tileSize);
+		return name;
+	}
+
+	////          结果输出          ////
+
+	// 打开--output指定的文件(未指定时为stdout), 失败时输出错误并返回空
+	FILE * openOutput(const Benchmark::Options & options) {
+		if (options.output.empty()) return stdout;
+		FILE * out = fopen(options.output.c_str(), "w");
+		if (!out) fprintf(stderr, "failed to open %s\n", options.output.c_str());
+		return out;
+	}
+
+	// 一行测试结果: 按顺序记录各字段在CSV与JSON中的值.
+	// beginGroup之后的字段在JSON中放进一个嵌套对象, 在CSV中展开为普通的列
+	class Row {
+	public:
+		struct Field {
+			string column;          // CSV的列名
+			string key;             // JSON的键
+			const char * group;     // JSON中所在的嵌套对象, 空为顶层
+			string csv, json;
+		};
+		vector<Field> fields;
+
+		Row & text(const char * name, const string & value) { return add(name, value, "\"" + value + "\""); }
+		Row & flag(const char * name, bool value) { return add(name, value ? "1" : "0", value ? "true" : "false"); }
+		Row & integer(const char * name, long long value) { return add(name, std::to_string(value), std::to_string(value)); }
+		// format为printf格式(如"%.4f")
+		Row & number(const char * name, const char * format, double value) {
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), format, value);
+			return add(name, buffer, buffer);
+		}
+		// 之后的字段放进名为name的对象, CSV列名为字段名加suffix; name为空时回到顶层
+		Row & beginGroup(const char * name, const char * suffix) {
+			group = name;
+			this->suffix = suffix;
+			return *this;
+		}
+		Row & endGroup() { return beginGroup(nullptr, ""); }
+
+	private:
+		const char * group = nullptr;
+		const char * suffix = "";
+
+		Row & add(const char * name, const string & csv, const string & json) {
+			fields.push_back(Field{ name + string(suffix), name, group, csv, json });
+			return *this;
+		}
+	};
+
+	// 按CSV(第一行之前输出列名)或JSON Lines逐行写入结果, 析构时关闭openOutput打开的文件
+	class RowWriter {
+		FILE * out;
+		bool csv, header;
+	public:
+		RowWriter(FILE * out, bool csv) : out(out), csv(csv), header(csv) {}
+		~RowWriter() { if (out && out != stdout) fclose(out); }
+		bool isOpen() const { return out != nullptr; }
+
+		void write(const Row & row) {
+			const vector<Row::Field> & fields = row.fields;
+			if (header) {
+				for (size_t i = 0; i < fields.size(); i++)
+					fprintf(out, "%s%s", i ? "," : "", fields[i].column.c_str());
+				fprintf(out, "\n");
+				header = false;
+			}
+			if (csv) {
+				for (size_t i = 0; i < fields.size(); i++)
+					fprintf(out, "%s%s", i ? "," : "", fields[i].csv.c_str());
+				fprintf(out, "\n");
+			} else {
+				const char * group = nullptr;
+				bool first = true, groupFirst = true;   // 顶层与嵌套对象中是否还没有字段
+				fprintf(out, "{");
+				for (const Row::Field & f : fields) {
+					if (f.group != group) {
+						if (group) fprintf(out, "}");
+						if (f.group) fprintf(out, "%s\"%s\":{", first ? "" : ",", f.group);
+						if (f.group) first = false, groupFirst = true;
+						group = f.group;
+					}
+					bool & isFirst = group ? groupFirst : first;
+					fprintf(out, "%s\"%s\":%s", isFirst ? "" : ",", f.key.c_str(), f.json.c_str());
+					isFirst = false;
+				}
+				fprintf(out, group ? "}}\n" : "}\n");
+			}
+			fflush(out);
+		}
+	};
+}
+
+void Benchmark::printUsage(const char * program) {
+	fprintf(stderr, "usage: %s --bench [options]\n"
+		"  --sizes WxH,...   resolutions (default 700x500)\n"
+		"  --threads N,...   worker thread counts (default %d)\n"
+		"  --scenes I,...    scenes:", program, JobSystem::hardwareThreads());
+	for (int i = 0; i < totalSceneNum; i++)
+		fprintf(stderr, " %d %s", i, sceneName(i));
+	fprintf(stderr, "\n  --modes I,...     render states:");
+	for (int i = 0; i < DemoScene::stateNum; i++)
+		fprintf(stderr, " %d %s", i, DemoScene::stateNames[i]);
+	fprintf(stderr, "\n  --shaders I,...   shaders (shading mode only):");
+	for (int i = 0; i < DemoScene::shaderNum; i++)
+		fprintf(stderr, " %d %s", i, DemoScene::shaderNames[i]);
+	fprintf(stderr, "\n"
+		"  --frames N        timed frames per case (default 30)\n"
+		"  --warmup N        untimed frames per case (default 3)\n"
+		"  --tile            tile binning rasterization\n"
+		"  --halfspace       half-space rasterizer\n"
+		"  --fixed           fixed-point half-space rasterizer with top-left fill rule\n"
+		"  --no-hiz          disable hierarchical Z culling\n"
+		"  --no-fast-clear   fill the whole color/depth buffers every frame instead of clearing tiles lazily\n"
+		"  --pin             pin worker threads to CPUs\n"
+		"  --hugepages       allocate the color/depth buffers with the huge page allocator\n"
+		"  --pad-pitch       pad buffer rows to an odd number of cache lines\n"
+		"  --buffer-tiles N  store the color/depth buffers as NxN tiles (8, 16, 32 or 64; 0 = linear)\n"
+		"  --raytrace        ray trace a BVH of the scene instead of rasterizing (primary rays and mirror reflections)\n"
+		"  --ray-depth N     maximum number of reflections when ray tracing (default 2)\n"
+		"  --pathtrace       progressive path tracing, accumulating samples across frames\n"
+		"  --samples N       path tracing samples per pixel per frame (default 1)\n"
+		"  --pipelined       submit frames asynchronously (frame time = interval between completions)\n"
+		"  --simd LEVEL      scalar, sse2 or avx2 (default: best available)\n"
+		"  --filter NAME     texture filter: point (default), bilinear or trilinear (mipmapped)\n"
+		"  --layout NAME     texture memory layout: linear (default), tiled (4x4 blocks), morton or bc1\n"
+		"  --csv             CSV output instead of JSON Lines\n"
+		"  --output FILE     write results to FILE instead of stdout\n"
+		"  --trace FILE      write a Chrome trace-event JSON timeline (latest events per thread)\n"
+		"  --math            Vector4/Matrix44 microbenchmarks, scalar vs SIMD (uses --frames, --warmup)\n"
+		"  --coverage        per-pixel coverage of screen-filling meshes for every rasterizer\n"
+		"                    (exit code 1 if the fixed-point rasterizer leaves holes or overlaps)\n"
+		"  --texcache        simulated L1/L2 miss rates and bilinear sampling time of a rotated texture\n"
+		"                    for every texture layout (uses --sizes, --frames, --warmup)\n"
+		"  --buffers         allocation, clear and tile clear throughput of the color/depth buffers and\n"
+		"                    frame time of the overdraw scene for every allocator and pitch option\n"
+		"                    (uses --sizes, --frames, --warmup, --no-fast-clear)\n"
+		"  --rays            Mrays/s of BVH traversal on tessellated spheres, single rays vs SIMD packets,\n"
+		"                    for coherent primary and incoherent random rays (uses --sizes, --threads,\n"
+		"                    --frames, --warmup, --simd; exit code 1 if packets and single rays disagree)\n");
+}
+
+bool Benchmark::parseArgs(int argc, char * argv[], Options & options) {
+	for (int i = 1; i < argc; i++) {
+		const char * arg = argv[i];
+		const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = true;
+		if (!strcmp(arg, "--help")) {
+			return false;
+		} else if (!strcmp(arg, "--bench")) {
+			continue;
+		} else if (!strcmp(arg, "--tile")) {
+			options.tile = true;
+			continue;
+		} else if (!strcmp(arg, "--raytrace")) {
+			options.rayTrace = true;
+			continue;
+		} else if (!strcmp(arg, "--pathtrace")) {
+			options.pathTrace = true;
+			continue;
+		} else if (!strcmp(arg, "--halfspace")) {
+			options.halfSpace = true;
+			continue;
+		} else if (!strcmp(arg, "--fixed")) {
+			options.fixedPoint = true;
+			continue;
+		} else if (!strcmp(arg, "--no-hiz")) {
+			options.hiZ = false;
+			continue;
+		} else if (!strcmp(arg, "--no-fast-clear")) {
+			options.fastClear = false;
+			continue;
+		} else if (!strcmp(arg, "--pin")) {
+			options.pin = true;
+			continue;
+		} else if (!strcmp(arg, "--hugepages")) {
+			options.hugePages = true;
+			continue;
+		} else if (!strcmp(arg, "--pad-pitch")) {
+			options.padPitch = true;
+			continue;
+		} else if (!strcmp(arg, "--pipelined")) {
+			options.pipelined = true;
+			continue;
+		} else if (!strcmp(arg, "--csv")) {
+			options.csv = true;
+			continue;
+		} else if (!strcmp(arg, "--math")) {
+			options.math = true;
+			continue;
+		} else if (!strcmp(arg, "--coverage")) {
+			options.coverage = true;
+			continue;
+		} else if (!strcmp(arg, "--texcache")) {
+			options.textureCache = true;
+			continue;
+		} else if (!strcmp(arg, "--buffers")) {
+			options.buffers = true;
+			continue;
+		} else if (!strcmp(arg, "--rays")) {
+			options.rays = true;
+			continue;
+		} else if (!value) {
+			fprintf(stderr, "missing value or unknown option: %s\n", arg);
+			return false;
+		} else if (!strcmp(arg, "--sizes")) {
+			ok = parseSizes(value, options.widths, options.heights);
+		} else if (!strcmp(arg, "--threads")) {
+			ok = parseList(value, options.threads, 1, 1024);
+		} else if (!strcmp(arg, "--scenes")) {
+			ok = parseList(value, options.scenes, 0, totalSceneNum - 1);
+		} else if (!strcmp(arg, "--modes")) {
+			ok = parseList(value, options.modes, 0, DemoScene::stateNum - 1);
+		} else if (!strcmp(arg, "--shaders")) {
+			ok = parseList(value, options.shaders, 0, DemoScene::shaderNum - 1);
+		} else if (!strcmp(arg, "--frames")) {
+			options.frames = atoi(value);
+			ok = options.frames > 0;
+		} else if (!strcmp(arg, "--buffer-tiles")) {
+			options.bufferTiles = atoi(value);
+			ok = options.bufferTiles == 0 || (options.bufferTiles >= 8 && options.bufferTiles <= 64 && !(options.bufferTiles & (options.bufferTiles - 1)));
+		} else if (!strcmp(arg, "--ray-depth")) {
+			options.rayDepth = atoi(value);
+			ok = options.rayDepth >= 0;
+		} else if (!strcmp(arg, "--samples")) {
+			options.samples = atoi(value);
+			ok = options.samples > 0;
+		} else if (!strcmp(arg, "--warmup")) {
+			options.warmup = atoi(value);
+			ok = options.warmup >= 0;
+		} else if (!strcmp(arg, "--simd")) {
+			if (!strcmp(value, "scalar")) options.simd = Simd::SCALAR;
+			else if (!strcmp(value, "sse2")) options.simd = Simd::SSE2;
+			else if (!strcmp(value, "avx2")) options.simd = Simd::AVX2;
+			else ok = false;
+		} else if (!strcmp(arg, "--filter")) {
+			options.filter = DemoScene::findFilter(value);
+			ok = options.filter >= 0;
+		} else if (!strcmp(arg, "--layout")) {
+			options.layout = DemoScene::findLayout(value);
+			ok = options.layout >= 0;
+		} else if (!strcmp(arg, "--output")) {
+			options.output = value;
+		} else if (!strcmp(arg, "--trace")) {
+			options.trace = value;
+		} else {
+			fprintf(stderr, "unknown option: %s\n", arg);
+			return false;
+		}
+		if (!ok) {
+			fprintf(stderr, "invalid value for %s\n", arg);
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+int Benchmark::run(const Options & options) {
+	vector<int> widths = options.widths, heights = options.heights;
+	if (widths.empty()) widths.push_back(700), heights.push_back(500);
+	vector<int> threads = options.threads;
+	if (threads.empty()) threads.push_back(JobSystem::hardwareThreads());
+	vector<int> scenes = options.scenes, modes = options.modes, shaders = options.shaders;
+	if (scenes.empty()) for (int i = 0; i < totalSceneNum; i++) scenes.push_back(i);
+	if (modes.empty()) for (int i = 0; i < DemoScene::stateNum; i++) modes.push_back(i);
+	if (shaders.empty()) for (int i = 0; i < DemoScene::shaderNum; i++) shaders.push_back(i);
+
+	RowWriter writer(openOutput(options), options.csv);
+	if (!writer.isOpen()) return 1;
+
+	if (!options.trace.empty()) Trace::start();
+
+	// 固定的程序生成纹理,不依赖外部文件
+	shared_ptr<Texture> texture = DemoScene::checkerTexture(256, 32);
+	texture->setFilter((Texture::Filter)options.filter);
+	texture->setLayout((Texture::Layout)options.layout);
+	const char * filter = DemoScene::filterNames[options.filter];
+	const char * layout = DemoScene::layoutNames[options.layout];
+	Simd::Level simd = std::min(options.simd, Simd::level());
+	const char * parallel = options.tile ? "tile" : "primitive";
+	const char * rasterizer = options.pathTrace ? "pathtrace" : options.rayTrace ? "raytrace" : options.fixedPoint ? "fixed" : options.halfSpace ? "halfspace" : "scanline";
+	string buffer = bufferName(BufferOptions(options.hugePages ? &BufferAllocator::hugePage() : &BufferAllocator::aligned(), options.padPitch, options.bufferTiles));
+
+	for (size_t si = 0; si < widths.size(); si++) {
+		IntBuffer image(widths[si], heights[si], BufferOptions(options.hugePages ? &BufferAllocator::hugePage() : &BufferAllocator::aligned(), options.padPitch));
+		Pipeline pipeline(image);
+		pipeline.setParallelMode(options.tile ? Pipeline::PARALLEL_TILE : Pipeline::PARALLEL_PRIMITIVE);
+		pipeline.setRasterizer(options.fixedPoint ? Pipeline::RASTERIZER_FIXED :
+			options.halfSpace ? Pipeline::RASTERIZER_HALFSPACE : Pipeline::RASTERIZER_SCANLINE);
+		pipeline.setHiZ(options.hiZ);
+		pipeline.setFastClear(options.fastClear);
+		pipeline.setBufferTiling(options.bufferTiles);
+		pipeline.setRayTracing(options.rayTrace);
+		pipeline.setRayDepth(options.rayDepth);
+		pipeline.setPathTracing(options.pathTrace);
+		pipeline.setPathSamples(options.samples);
+		pipeline.setSIMD(options.simd);
+		pipeline.setThreadAffinity(options.pin);
+
+		for (size_t ti = 0; ti < threads.size(); ti++) {
+			pipeline.setThreadCount(threads[ti]);
+			for (size_t ci = 0; ci < scenes.size(); ci++) {
+				for (size_t mi = 0; mi < modes.size(); mi++) {
+					Pipeline::RenderState state = DemoScene::states[modes[mi]];
+					pipeline.setRenderState(state);
+					// 着色器只在着色器模式下有意义
+					size_t shaderCount = state == Pipeline::SHADING ? shaders.size() : 1;
+					for (size_t hi = 0; hi < shaderCount; hi++) {
+						int shaderIndex = state == Pipeline::SHADING ? shaders[hi] : 0;
+						const Shader & shader = DemoScene::shaders[shaderIndex];
+						Scene scene;
+						vector<double> times;
+						Stats::ThreadStats stats;
+						int frameCount = options.warmup + options.frames;
+						// 记录一帧的耗时
+						auto record = [&](int frame, double ms) {
+							if (frame >= options.warmup) {
+								times.push_back(ms);
+								if (Stats::enabled) addStats(stats, pipeline.getStats().total());
+							}
+						};
+						if (options.pipelined) {
+							// 预先构建所有帧的场景, 连续提交, 每帧耗时为相邻两帧完成的间隔
+							vector<Scene> frameScenes(frameCount);
+							for (int frame = 0; frame < frameCount; frame++)
+								createScene(frameScenes[frame], scenes[ci], texture, shader, frame, image.aspect());
+							Pipeline::Fence previous;
+							auto last = std::chrono::steady_clock::now();
+							auto complete = [&](Pipeline::Fence & fence, int frame) {
+								fence.wait();
+								auto now = std::chrono::steady_clock::now();
+								record(frame, std::chrono::duration<double, std::milli>(now - last).count());
+								last = now;
+							};
+							for (int frame = 0; frame < frameCount; frame++) {
+								Pipeline::Fence current;
+								{
+									TRACE_SCOPE("frame", "frame", frame);
+									current = pipeline.renderAsync(frameScenes[frame]);
+								}
+								if (previous) complete(previous, frame - 1);
+								previous = current;
+							}
+							complete(previous, frameCount - 1);
+							scene = frameScenes.back();
+						} else {
+							for (int frame = 0; frame < frameCount; frame++) {
+								// 场景的构建不计入时间,动画只由帧号决定
+								createScene(scene, scenes[ci], texture, shader, frame, image.aspect());
+								auto start = std::chrono::steady_clock::now();
+								{
+									TRACE_SCOPE("frame", "frame", frame);
+									pipeline.render(scene);
+								}
+								record(frame, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+							}
+						}
+
+						Result r;
+						r.scene = sceneName(scenes[ci]);
+						r.mode = DemoScene::stateNames[modes[mi]];
+						r.shader = state == Pipeline::SHADING ? DemoScene::shaderNames[shaderIndex] : "none";
+						r.width = widths[si];
+						r.height = heights[si];
+						r.threads = threads[ti];
+						r.triangles = scene.triangleCount();
+						r.lines = scene.lineCount();
+						r.frames = options.frames;
+						double total = 0;
+						for (size_t i = 0; i < times.size(); i++) total += times[i];
+						std::sort(times.begin(), times.end());
+						r.meanMs = total / times.size();
+						r.minMs = times.front();
+						r.maxMs = times.back();
+						r.p50Ms = percentile(times, 0.5);
+						r.p90Ms = percentile(times, 0.9);
+						r.p99Ms = percentile(times, 0.99);
+						r.trianglesPerSec = r.triangles * 1000.0 / r.meanMs;
+						r.pixelsPerSec = (double)r.width * r.height * 1000.0 / r.meanMs;
+						r.stats = stats;
+
+						Row row;
+						row.text("scene", r.scene).text("mode", r.mode).text("shader", r.shader)
+							.integer("width", r.width).integer("height", r.height).integer("threads", r.threads)
+							.text("parallel", parallel).flag("pipelined", options.pipelined).text("rasterizer", rasterizer)
+							.flag("hiz", options.hiZ).flag("fast_clear", options.fastClear).text("buffer", buffer).text("simd", simdName(simd))
+							.text("filter", filter).text("layout", layout).integer("triangles", r.triangles).integer("lines", r.lines).integer("frames", r.frames)
+							.number("mean_ms", "%.4f", r.meanMs).number("min_ms", "%.4f", r.minMs).number("p50_ms", "%.4f", r.p50Ms)
+							.number("p90_ms", "%.4f", r.p90Ms).number("p99_ms", "%.4f", r.p99Ms).number("max_ms", "%.4f", r.maxMs)
+							.number("triangles_per_sec", "%.0f", r.trianglesPerSec).number("pixels_per_sec", "%.0f", r.pixelsPerSec);
+						if (Stats::enabled) {
+							// 每帧平均的分阶段耗时(所有线程之和)与计数
+							row.beginGroup("stages_ms", "_ms");
+							for (int i = 0; i < Stats::STAGE_COUNT; i++)
+								row.number(Stats::stageName(i), "%.4f", r.stats.stageTime[i] * 1000 / r.frames);
+							row.beginGroup("counters", "");
+							for (int i = 0; i < Stats::COUNTER_COUNT; i++)
+								row.number(Stats::counterName(i), "%.0f", (double)r.stats.counters[i] / r.frames);
+							row.endGroup();
+						}
+						writer.write(row);
+					}
+				}
+			}
+		}
+	}
+
+	if (!options.trace.empty()) {
+		Trace::stop();
+		if (!Trace::write(options.trace.c_str())) {
+			fprintf(stderr, "failed to write %s\n", options.trace.c_str());
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int Benchmark::runMath(const Options & options) {
+	RowWriter writer(openOutput(options), options.csv);
+	if (!writer.isOpen()) return 1;
+
+	Random random;
+	vector<Matrix44> a(mathCount), b(mathCount), scalar(mathCount), simd(mathCount);
+	vector<Vector4> v(mathCount), scalarV(mathCount), simdV(mathCount);
+	for (int i = 0; i < mathCount; i++) {
+		a[i] = randomMatrix(random);
+		b[i] = randomMatrix(random);
+		v[i] = Vector4(random.next() * 10, random.next() * 10, random.next() * 10, 1.0f);
+	}
+
+	// 每个运算的标量实现与SIMD实现, 运行后比较两者的结果
+	struct Case {
+		const char * op;
+		function<void(int)> scalar, simd;
+		bool vector;                    // 结果是Vector4
+	};
+	const Case cases[] = {
+		{ "multiply",
+			[&](int i) { Matrix44::multiplyScalar(a[i], b[i], scalar[i]); },
+			[&](int i) { MathSIMD::multiply(&a[i].x[0][0], &b[i].x[0][0], &simd[i].x[0][0]); }, false },
+		{ "apply",
+			[&](int i) { a[i].applyScalar(v[i], scalarV[i]); },
+			[&](int i) { _mm_storeu_ps(&simdV[i].x, MathSIMD::apply(&a[i].x[0][0], _mm_loadu_ps(&v[i].x))); }, true },
+		{ "apply_point",
+			[&](int i) { a[i].applyScalar(Vector3(v[i].x, v[i].y, v[i].z), scalarV[i]); },
+			[&](int i) { _mm_storeu_ps(&simdV[i].x, MathSIMD::applyPoint(&a[i].x[0][0], v[i].x, v[i].y, v[i].z)); }, true },
+		{ "inverse",
+			[&](int i) { scalar[i] = a[i].inverseScalar(); },
+			[&](int i) { MathSIMD::inverse(&a[i].x[0][0], &simd[i].x[0][0]); }, false },
+		{ "transposed",
+			[&](int i) { scalar[i] = a[i].transposedScalar(); },
+			[&](int i) { MathSIMD::transpose(&a[i].x[0][0], &simd[i].x[0][0]); }, false },
+	};
+
+	for (const Case & c : cases) {
+		vector<double> times[2] = { timeMath(options, c.scalar), timeMath(options, c.simd) };
+		// SIMD与标量结果的最大差(除求逆外应为0)
+		float diff = 0;
+		for (int i = 0; i < mathCount; i++)
+			diff = std::max(diff, c.vector ? maxDiff(scalarV[i], simdV[i]) : maxDiff(scalar[i], simd[i]));
+
+		for (int impl = 0; impl < 2; impl++) {
+			vector<double> & t = times[impl];
+			double mean = 0;
+			for (double x : t) mean += x;
+			mean /= t.size();
+			std::sort(t.begin(), t.end());
+			const char * implName = impl ? "simd" : "scalar";
+			const char * build = SOFTRENDERER_SIMD_MATH ? "simd" : "scalar";
+			writer.write(Row().text("op", c.op).text("impl", implName).text("build", build).integer("count", mathCount).integer("rounds", options.frames)
+				.number("mean_ns", "%.3f", mean).number("min_ns", "%.3f", t.front()).number("p50_ns", "%.3f", percentile(t, 0.5)).number("max_ns", "%.3f", t.back())
+				.number("mops_per_sec", "%.2f", 1000.0 / mean).number("max_diff", "%g", impl ? diff : 0.f));
+		}
+	}
+
+	return 0;
+}
+
+int Benchmark::runCoverage(const Options & options) {
+	int width = options.widths.empty() ? 700 : options.widths[0];
+	int height = options.heights.empty() ? 500 : options.heights[0];
+	RowWriter writer(openOutput(options), options.csv);
+	if (!writer.isOpen()) return 1;
+
+	// 三种铺满屏幕的网格: 顶点在像素中心的规则网格(边恰好穿过像素中心), 顶点随机偏移的网格, 共享中心顶点的扇形
+	Random random;
+	CoverageMesh meshes[3];
+	meshes[0].grid(width, height, 16, 32.5f, 0, random);
+	meshes[1].grid(width, height, 13, 32, 3, random);
+	meshes[2].fan(width, height, 97);
+	const char * const meshNames[] = { "grid", "jittered_grid", "fan" };
+	const Pipeline::RasterizerType rasterizers[] = { Pipeline::RASTERIZER_SCANLINE, Pipeline::RASTERIZER_HALFSPACE, Pipeline::RASTERIZER_FIXED };
+	const char * const rasterizerNames[] = { "scanline", "halfspace", "fixed" };
+
+	IntBuffer image(width, height);
+	Pipeline pipeline(image);
+	pipeline.setRenderState(Pipeline::SHADING);
+	pipeline.setClearColor(Colors::Black);
+	pipeline.setParallelMode(options.tile ? Pipeline::PARALLEL_TILE : Pipeline::PARALLEL_PRIMITIVE);
+	pipeline.setHiZ(options.hiZ);
+	const int cleared = Colors::Black.toRGBInt();
+
+	int result = 0;
+	for (int mi = 0; mi < 3; mi++) {
+		// 投影与视图变换都是单位矩阵, 顶点直接给出NDC坐标
+		shared_ptr<Mesh> mesh = make_shared<Mesh>();
+		for (const Vector3 & p : meshes[mi].points) {
+			Vertex v;
+			v.point = Vector3(p.x * 2 / width - 1, 1 - p.y * 2 / height, 0.5f);
+			v.color = Colors::White;
+			v.texCoord = TexCoord{ 0, 0 };
+			v.normal = Vector3(0, 0, 1);
+			mesh->vertices.push_back(v);
+		}
+		mesh->primitives = meshes[mi].triangles;
+		mesh->shader = Shader(shared_ptr<const ShaderProgram>(make_shared<CoverageProgram>()));
+		Scene scene;
+		scene.addMesh(mesh);
+
+		for (int ri = 0; ri < 3; ri++) {
+			pipeline.setRasterizer(rasterizers[ri]);
+			pipeline.render(scene);
+
+			long long uncovered = 0, overlapped = 0;
+			int maxCoverage = 0;
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++) {
+					int coverage = *image(x, y) - cleared;
+					if (coverage == 0) uncovered++;
+					if (coverage > 1) overlapped++;
+					maxCoverage = std::max(maxCoverage, coverage);
+				}
+			bool watertight = uncovered == 0 && overlapped == 0;
+			if (rasterizers[ri] == Pipeline::RASTERIZER_FIXED && !watertight) result = 1;
+
+			const char * parallel = options.tile ? "tile" : "primitive";
+			writer.write(Row().text("mesh", meshNames[mi]).text("rasterizer", rasterizerNames[ri]).text("parallel", parallel)
+				.integer("width", width).integer("height", height).integer("triangles", meshes[mi].triangles.size()).integer("pixels", width * height)
+				.integer("uncovered", uncovered).integer("overlapped", overlapped).integer("max_coverage", maxCoverage).flag("watertight", watertight));
+		}
+	}
+
+	return result;
+}
+
+int Benchmark::runTextureCache(const Options & options) {
+	int width = options.widths.empty() ? 512 : options.widths[0];
+	int height = options.heights.empty() ? 512 : options.heights[0];
+	RowWriter writer(openOutput(options), options.csv);
+	if (!writer.isOpen()) return 1;
+
+	// 比屏幕大的纹理, 第0级放不进L2缓存
+	const int texSize = 1024;
+	shared_ptr<Texture> texture = DemoScene::checkerTexture(texSize, 16);
+	texture->setFilter(Texture::BILINEAR);
+	const float angles[] = { 0, 30, 45, 60, 90 };
+	const int angleNum = sizeof(angles) / sizeof(angles[0]);
+	unsigned checksums[angleNum];   // 无损布局的采样结果必须相同
+	int result = 0;
+
+	for (int li = 0; li < DemoScene::layoutNum; li++) {
+		texture->setLayout((Texture::Layout)li);
+		// 压缩布局只保留压缩后的数据(最后测试, 不需要再从原图重排)
+		if (li == Texture::BC1) texture->releaseSource();
+		const Texture::Level & level = texture->level(0);
+		size_t bytes = texture->memoryUsage();
+		for (int ai = 0; ai < angleNum; ai++) {
+			float angle = angles[ai];
+			float c = std::cos(angle * Math::DEGREE_TO_RADIUS), s = std::sin(angle * Math::DEGREE_TO_RADIUS);
+
+			// 按扫描线顺序重放双线性采样读取的纹素地址(与Texture::sampleBilinear的寻址相同, BC1布局下为纹素所在块的地址, 不计解码缓存),
+			// L1为32KB 8路组相联, L2为256KB 8路组相联, 缓存行64字节, L1缺失时才访问L2. 两个缺失率都相对于读取的纹素数
+			CacheModel l1(32 << 10, 8, 6), l2(256 << 10, 8, 6);
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++) {
+					Vector2 uv = rotatedTexCoord(x, y, width, height, c, s, texSize, texSize);
+					float tx = Math::fract(uv.x) * texSize - 0.5f, ty = Math::fract(uv.y) * texSize - 0.5f;
+					int x0 = Math::floor(tx), y0 = Math::floor(ty);
+					int xs[2] = { (x0 + texSize) % texSize, (x0 + 1 + texSize) % texSize };
+					int ys[2] = { (y0 + texSize) % texSize, (y0 + 1 + texSize) % texSize };
+					for (int j = 0; j < 2; j++)
+						for (int i = 0; i < 2; i++) {
+							size_t address = (size_t)(level.texels + level.offset(xs[i], ys[j]));
+							if (!l1.access(address)) l2.access(address);
+						}
+				}
+
+			// 真实的采样耗时
+			vector<double> times;
+			unsigned checksum = 0;
+			for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+				auto start = std::chrono::steady_clock::now();
+				for (int y = 0; y < height; y++)
+					for (int x = 0; x < width; x++)
+						checksum += texture->sample(rotatedTexCoord(x, y, width, height, c, s, texSize, texSize), 0);
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				if (frame >= options.warmup) times.push_back(ms);
+			}
+			double total = 0;
+			for (double t : times) total += t;
+			double mean = total / times.size(), minMs = *std::min_element(times.begin(), times.end());
+			double samplesPerSec = (double)width * height / mean / 1000.0;
+			if (li == 0) checksums[ai] = checksum;
+			else if (li != Texture::BC1 && checksums[ai] != checksum) {
+				fprintf(stderr, "texture layout %s: samples differ from linear layout\n", DemoScene::layoutNames[li]);
+				result = 1;
+			}
+
+			writer.write(Row().text("layout", DemoScene::layoutNames[li]).number("angle", "%.0f", angle).integer("width", width).integer("height", height)
+				.integer("texture", texSize).integer("texture_bytes", bytes).integer("fetches", l1.accesses)
+				.number("l1_miss_rate", "%.4f", l1.missRate()).number("l2_miss_rate", "%.4f", (double)l2.misses / l1.accesses)
+				.number("mean_ms", "%.4f", mean).number("min_ms", "%.4f", minMs).number("msamples_per_sec", "%.2f", samplesPerSec));
+		}
+	}
+
+	return result;
+}
+
+int Benchmark::runBuffers(const Options & options) {
+	vector<int> widths = options.widths, heights = options.heights;
+	if (widths.empty()) {
+		widths.push_back(1920), heights.push_back(1080);
+		widths.push_back(3840), heights.push_back(2160);
+	}
+	RowWriter writer(openOutput(options), options.csv);
+	if (!writer.isOpen()) return 1;
+
+	OffsetAllocator offset;
+	BufferAllocator & aligned = BufferAllocator::aligned(), & huge = BufferAllocator::hugePage();
+	const BufferOptions configs[] = {
+		BufferOptions(&offset), BufferOptions(&aligned), BufferOptions(&aligned, true), BufferOptions(&huge), BufferOptions(&huge, true),
+		BufferOptions(&aligned, false, 8), BufferOptions(&aligned, false, 16)
+	};
+	const int tile = 64;                // 与Pipeline的屏幕分块相同
+	const int overdraw = totalSceneNum - 1;
+	typedef std::chrono::steady_clock Clock;
+	auto elapsed = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+	auto mean = [](const vector<double> & times) {
+		double total = 0;
+		for (double t : times) total += t;
+		return total / times.size();
+	};
+
+	for (size_t si = 0; si < widths.size(); si++) {
+		int width = widths[si], height = heights[si];
+		// 颜色与深度缓冲区每次清除写入的字节数(不含补齐部分)
+		double bytes = (double)width * height * (sizeof(int) + sizeof(float));
+		for (const BufferOptions & config : configs) {
+			vector<double> allocTimes, clearTimes, tileTimes, renderTimes;
+			size_t pitch = 0, storage = 0;
+			for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+				// 分配并第一次写入(包括缺页), 然后释放
+				auto start = Clock::now();
+				{
+					IntBuffer color(width, height, config);
+					FloatBuffer depth(width, height, config);
+					color.fill(0);
+					depth.fill(0.f);
+					pitch = color.getPitch();
+					storage = (color.getSize() + depth.getSize()) * sizeof(int);
+				}
+				if (frame >= options.warmup) allocTimes.push_back(elapsed(start));
+			}
+
+			IntBuffer color(width, height, config);
+			FloatBuffer depth(width, height, config);
+			color.fill(0);
+			depth.fill(0.f);
+			for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+				auto start = Clock::now();
+				color.fill(frame);
+				depth.fill(0.f);
+				if (frame >= options.warmup) clearTimes.push_back(elapsed(start));
+
+				// 与快速清除相同, 每个分块逐行填充
+				start = Clock::now();
+				for (int y = 0; y < height; y += tile)
+					for (int x = 0; x < width; x += tile) {
+						int x1 = MIN(x + tile, width), y1 = MIN(y + tile, height);
+						color.fill(x, y, x1, y1, frame);
+						depth.fill(x, y, x1, y1, 0.f);
+					}
+				if (frame >= options.warmup) tileTimes.push_back(elapsed(start));
+			}
+
+			// 以相同的选项渲染(深度缓冲区使用目标的选项), 分块布局时光栅化到内部的分块缓冲区, 每帧复制到线性的目标
+			BufferOptions linear = config;
+			linear.tileSize = 0;
+			IntBuffer target(width, height, linear);
+			Pipeline pipeline(target);
+			pipeline.setBufferTiling(config.tileSize);
+			pipeline.setRenderState(Pipeline::COLOR);
+			pipeline.setFastClear(options.fastClear);
+			if (!options.threads.empty()) pipeline.setThreadCount(options.threads[0]);
+			for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+				Scene scene;
+				createScene(scene, overdraw, nullptr, DemoScene::shaders[0], frame, target.aspect());
+				auto start = Clock::now();
+				pipeline.render(scene);
+				if (frame >= options.warmup) renderTimes.push_back(elapsed(start));
+			}
+
+			string name = bufferName(config);
+			double allocMs = mean(allocTimes), clearMs = mean(clearTimes), tileMs = mean(tileTimes), renderMs = mean(renderTimes);
+			writer.write(Row().text("buffer", name).integer("width", width).integer("height", height).integer("pitch", pitch).integer("bytes", storage)
+				.number("alloc_ms", "%.4f", allocMs).number("clear_ms", "%.4f", clearMs).number("clear_gb_per_sec", "%.2f", bytes / clearMs / 1e6)
+				.number("tile_clear_ms", "%.4f", tileMs).number("tile_clear_gb_per_sec", "%.2f", bytes / tileMs / 1e6).number("render_ms", "%.4f", renderMs));
+		}
+	}
+
+	return 0;
+}
+
+int Benchmark::runRays(const Options & options) {
+	int width = options.widths.empty() ? 700 : options.widths[0];
+	int height = options.heights.empty() ? 500 : options.heights[0];
+	vector<int> threads = options.threads;
+	if (threads.empty()) threads.push_back(JobSystem::hardwareThreads());
+	RowWriter writer(openOutput(options), options.csv);
+	if (!writer.isOpen()) return 1;
+
+	// 各实现: 逐条求交(BVH::intersect)与光线包求交
+	struct Impl {
+		const char * name;
+		PacketIntersectFunc intersect;
+	};
+	vector<Impl> impls = { { "scalar", nullptr } };
+	Simd::Level simd = std::min(options.simd, Simd::level());
+	if (simd >= Simd::SSE2) impls.push_back({ "sse2", RaySIMD::intersect_SSE2 });
+	if (simd >= Simd::AVX2) impls.push_back({ "avx2", RaySIMD::intersect_AVX2 });
+	// 球体经纬度的间隔(度), 1度时每个球约26万个三角形
+	const int spaces[] = { 6, 3, 2, 1 };
+	const int GRID = 3;                 // GRIDxGRID个球, 间隔1, 半径0.45
+	const int PACKET_W = 4, PACKET_H = RayPacket::SIZE / PACKET_W;
+	int packetsX = (width + PACKET_W - 1) / PACKET_W, packetsY = (height + PACKET_H - 1) / PACKET_H;
+	int packetCount = packetsX * packetsY;
+	typedef std::chrono::steady_clock Clock;
+	JobSystem jobs(threads[0]);
+	int result = 0;
+
+	for (int space : spaces) {
+		Scene scene;
+		shared_ptr<Mesh> sphere = DemoScene::createSphere(0.45f, space);
+		for (int y = 0; y < GRID; y++)
+			for (int x = 0; x < GRID; x++)
+				scene.addMesh(sphere, Matrix44().translate(x - (GRID - 1) * .5f, y - (GRID - 1) * .5f, 0));
+		BVH bvh;
+		JobSystem::Group group;
+		auto start = Clock::now();
+		bvh.build(scene, jobs, group, []() {});
+		jobs.wait(group);
+		double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		// 主光线: 摄像机在z = -4处看向+z, 按4x2像素一组排列, 屏幕外的光线不参与求交
+		vector<Ray> rays[2];
+		rays[0].resize(packetCount * RayPacket::SIZE);
+		float half = GRID * .55f, aspect = (float)height / width;
+		for (int p = 0; p < packetCount; p++)
+			for (int i = 0; i < RayPacket::SIZE; i++) {
+				int x = p % packetsX * PACKET_W + i % PACKET_W, y = p / packetsX * PACKET_H + i / PACKET_W;
+				Ray & ray = rays[0][p * RayPacket::SIZE + i];
+				ray.origin = Vector3(0, 0, -4);
+				ray.dir = Vector3(((x + .5f) / width * 2 - 1) * half, (1 - (y + .5f) / height * 2) * half * aspect, 4);
+				ray.tMin = 0.f;
+				ray.tMax = x < width && y < height ? FLT_MAX : -1.f;
+			}
+		vector<RayHit> hits[2], reference[2];
+		hits[0].resize(rays[0].size());
+		for (size_t i = 0; i < rays[0].size(); i++)
+			if (!bvh.intersect(rays[0][i], hits[0][i])) hits[0][i].triangle = -1;
+
+		// 不一致的光线: 从主光线的交点向法线一侧的随机方向发出, 相邻光线的方向互不相关
+		Random random;
+		rays[1] = rays[0];
+		for (size_t i = 0; i < rays[1].size(); i++) {
+			Ray & ray = rays[1][i];
+			if (hits[0][i].triangle < 0) {
+				ray.tMin = 1.f;
+				ray.tMax = -1.f;
+				continue;
+			}
+			const BVH::Triangle & tri = bvh.triangle(hits[0][i].triangle);
+			Vector3 n = cross(tri.e1, tri.e2), d;
+			if (n * ray.dir > 0) n = -n;
+			do d = Vector3(random.next(), random.next(), random.next()); while (d * d > 1.f || d * d < 1e-4f);
+			ray.origin = ray.origin + ray.dir * hits[0][i].t;
+			ray.dir = d * n < 0 ? -d : d;
+			ray.tMin = 1e-4f;
+			ray.tMax = FLT_MAX;
+		}
+
+		const char * kinds[2] = { "primary", "incoherent" };
+		for (int kind = 0; kind < 2; kind++) {
+			const vector<Ray> & kindRays = rays[kind];
+			long long count = 0;
+			for (const Ray & ray : kindRays)
+				if (ray.tMin <= ray.tMax) count++;
+			reference[kind].resize(kindRays.size());
+			hits[kind].resize(kindRays.size());
+			for (size_t ii = 0; ii < impls.size(); ii++) {
+				const Impl & impl = impls[ii];
+				vector<RayHit> & found = ii == 0 ? reference[kind] : hits[kind];
+				for (int threadCount : threads) {
+					jobs.setThreadCount(threadCount);
+					vector<double> times;
+					for (int round = 0; round < options.warmup + options.frames; round++) {
+						auto roundStart = Clock::now();
+						jobs.parallelFor(group, packetCount, 64, [&](int begin, int end) {
+							RayPacket packet;
+							for (int p = begin; p < end; p++) {
+								const Ray * r = &kindRays[p * RayPacket::SIZE];
+								RayHit * h = &found[p * RayPacket::SIZE];
+								if (impl.intersect) {
+									for (int i = 0; i < RayPacket::SIZE; i++) packet.set(i, r[i]);
+									impl.intersect(bvh, packet, h);
+								} else {
+									for (int i = 0; i < RayPacket::SIZE; i++)
+										if (!bvh.intersect(r[i], h[i])) h[i].triangle = -1;
+								}
+							}
+						});
+						jobs.wait(group);
+						double ms = std::chrono::duration<double, std::milli>(Clock::now() - roundStart).count();
+						if (round >= options.warmup) times.push_back(ms);
+					}
+
+					// 与逐条求交比较命中与否和交点距离. 访问节点的顺序不同, 舍入误差内距离相等的交点可能是另一个三角形(如网格接缝两侧)
+					long long hitCount = 0, mismatches = 0;
+					for (size_t i = 0; i < kindRays.size(); i++) {
+						if (kindRays[i].tMin > kindRays[i].tMax) continue;
+						const RayHit & a = found[i], & b = reference[kind][i];
+						if (a.triangle >= 0) hitCount++;
+						if ((a.triangle >= 0) != (b.triangle >= 0) || (a.triangle >= 0 && std::fabs(a.t - b.t) > 1e-5f * b.t)) mismatches++;
+					}
+					if (mismatches) {
+						fprintf(stderr, "ray packets (%s): %lld %s rays differ from single rays\n", impl.name, mismatches, kinds[kind]);
+						result = 1;
+					}
+					double total = 0;
+					for (double t : times) total += t;
+					double mean = total / times.size(), minMs = *std::min_element(times.begin(), times.end());
+					writer.write(Row().integer("space", space).integer("triangles", bvh.triangleCount()).integer("nodes", bvh.nodeSize())
+						.number("build_ms", "%.3f", buildMs).text("rays", kinds[kind]).text("impl", impl.name).integer("threads", threadCount)
+						.integer("width", width).integer("height", height).integer("count", count).number("mean_ms", "%.4f", mean).number("min_ms", "%.4f", minMs)
+						.number("mrays_per_sec", "%.2f", count / mean / 1000.0).integer("hits", hitCount).integer("mismatches", mismatches));
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+int Benchmark::run(int argc, char * argv[]) {
+	Options options;
+	if (!parseArgs(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.math) return runMath(options);
+	if (options.coverage) return runCoverage(options);
+	if (options.textureCache) return runTextureCache(options);
+	if (options.buffers) return runBuffers(options);
+	if (options.rays) return runRays(options);
+	return run(options);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include "Pipeline.h"
+
+// 基准测试: 在内置场景与压力测试场景上遍历渲染状态/着色器/分辨率/线程数,
+// 统计每帧耗时的分位数以及三角形、像素吞吐量, 以JSON Lines或CSV输出
+namespace Benchmark {
+	// 测试参数(对应命令行选项)
+	struct Options {
+		vector<int> widths, heights;    // --sizes WxH,WxH   (默认700x500)
+		vector<int> threads;            // --threads N,N     工作线程数(默认硬件线程数)
+		vector<int> scenes;             // --scenes I,I      场景编号, 内置场景之后依次是压力测试场景(默认全部)
+		vector<int> modes;              // --modes I,I       渲染状态编号(默认全部)
+		vector<int> shaders;            // --shaders I,I     着色器编号, 只在着色器模式下遍历(默认全部)
+		int frames = 30;                // --frames N        每个用例计时的帧数
+		int warmup = 3;                 // --warmup N        每个用例计时前预热的帧数
+		bool tile = false;              // --tile
+		bool halfSpace = false;         // --halfspace
+		bool fixedPoint = false;        // --fixed
+		bool hiZ = true;                // --no-hiz
+		bool fastClear = true;          // --no-fast-clear   每帧整体填充颜色/深度缓冲区, 而不是按分块延迟清除
+		bool pin = false;               // --pin             把工作线程绑定到固定的CPU
+		bool hugePages = false;         // --hugepages       颜色/深度缓冲区使用大页分配器
+		bool padPitch = false;          // --pad-pitch       颜色/深度缓冲区的行距补齐为奇数个缓存行
+		int bufferTiles = 0;            // --buffer-tiles N  颜色/深度缓冲区按NxN分块存放(8, 16, 32, 64), 0为线性布局
+		bool rayTrace = false;          // --raytrace        以光线追踪代替光栅化(rasterizer列为raytrace)
+		int rayDepth = 2;               // --ray-depth N     光线追踪的最大反射次数
+		bool pathTrace = false;         // --pathtrace       路径追踪, 逐帧累积(rasterizer列为pathtrace)
+		int samples = 1;                // --samples N       路径追踪每帧每像素的样本数
+		bool pipelined = false;         // --pipelined       异步渲染, 每帧耗时为相邻两帧完成的间隔
+		int filter = Texture::POINT;    // --filter point|bilinear|trilinear  纹理过滤方式
+		int layout = Texture::LINEAR;   // --layout linear|tiled|morton|bc1   纹理内存布局
+		Simd::Level simd = Simd::AVX2;  // --simd scalar|sse2|avx2
+		bool csv = false;               // --csv             输出CSV(默认JSON Lines)
+		string output;                  // --output FILE     (默认标准输出)
+		bool math = false;              // --math            运行Vector4/Matrix44的微基准(标量与SIMD实现对比)
+		string trace;                   // --trace FILE      输出所有帧的Chrome trace-event JSON时间线(每个线程保留最近的事件)
+		bool coverage = false;          // --coverage        统计相邻三角形组成的网格的逐像素覆盖次数(各光栅化算法对比)
+		bool textureCache = false;      // --texcache        旋转纹理双线性采样的缓存缺失率与耗时(各内存布局对比)
+		bool buffers = false;           // --buffers         帧缓冲区的分配、清除与填充耗时(各分配器与行距对比)
+		bool rays = false;              // --rays            BVH光线求交的吞吐量(逐条求交与SIMD光线包对比)
+	};
+
+	// 一个用例的测试结果
+	struct Result {
+		string scene, mode, shader;
+		int width, height, threads;
+		size_t triangles, lines;        // 每帧提交的三角形/直线数
+		int frames;
+		double meanMs, minMs, p50Ms, p90Ms, p99Ms, maxMs;
+		double trianglesPerSec;         // 每秒提交的三角形数
+		double pixelsPerSec;            // 每秒输出的像素数(分辨率 * 帧率)
+		Stats::ThreadStats stats;       // 计时帧的分阶段统计之和(SOFTRENDERER_STATS为1时)
+	};
+
+	// 解析命令行,失败时返回false并输出错误
+	bool parseArgs(int argc, char * argv[], Options & options);
+	// 输出命令行用法
+	void printUsage(const char * program);
+
+	// 按参数运行全部用例,返回进程退出码
+	int run(const Options & options);
+	// 运行矩阵乘法/变换/求逆/转置的微基准(使用frames, warmup, csv, output参数),返回进程退出码
+	int runMath(const Options & options);
+	// 运行覆盖测试(使用sizes, tile, no-hiz, csv, output参数): 用三角形网格铺满屏幕, 统计每个像素被着色的次数.
+	// 定点数光栅化出现空洞或重复着色时返回非0
+	int runCoverage(const Options & options);
+	// 运行纹理缓存测试(使用sizes, frames, warmup, csv, output参数): 按扫描线顺序对旋转后的1024x1024纹理双线性采样,
+	// 对每种内存布局输出纹理占用的内存、模拟的L1/L2缓存缺失率与实际采样耗时. 无损布局的采样结果不同时返回非0
+	int runTextureCache(const Options & options);
+	// 运行帧缓冲区内存测试(使用sizes, frames, warmup, no-fast-clear, csv, output参数): 对每种内存选项(偏移4字节的未对齐分配,
+	// 64字节对齐, 大页, 是否补齐行距, 以及8x8/16x16分块布局)输出颜色+深度缓冲区的分配与首次写入、整体清除、按64x64分块清除的耗时与带宽,
+	// 以及以该缓冲区为目标渲染overdraw场景的耗时
+	int runBuffers(const Options & options);
+	// 运行光线求交测试(使用sizes, threads, frames, warmup, simd, csv, output参数): 对不同细分程度的createSphere球体网格构建BVH,
+	// 按逐条求交、4条一组(SSE2)、8条一组(AVX2)求交相邻像素的主光线(一致)和从交点向随机方向发出的光线(不一致), 输出每秒求交的光线数(百万).
+	// 光线包与逐条求交的交点距离不同时返回非0
+	int runRays(const Options & options);
+	// 解析命令行并运行,返回进程退出码
+	int run(int argc, char * argv[]);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "DemoScene.h"
+
+#include <cstring>
+
+const Pipeline::RenderState DemoScene::states[] = { 
+	Pipeline::WIREFRAME, 
+	Pipeline::COLOR, 
+	Pipeline::TEXTURE,
+	Pipeline::COLOR_TEXTURE, 
+	Pipeline::SHADING
+};
+const Shader DemoScene::shaders[] = {
+	FragmentShader::depth(1.5f, 0),
+	FragmentShader::normal(),
+	FragmentShader::lambert_direction_light(Vector3(.5f, .5f, -1)),
+	FragmentShader::phong_direction_light(Vector3(1, 1, -1), Colors::Black, Colors::White * .3f, Colors::White * .9f, 7.f),
+	FragmentShader::blinn_phong_direction_light(Vector3(1, 1, -1), Colors::Black, Colors::White * .3f, Colors::White * .9f, 7.f),
+	FragmentShader::blinn_phong_direction_light_color_textured(Vector3(1, 1, -1), Colors::White * .1f, Colors::White * .45f, Colors::White * 1.5f, 6.f),
+};
+
+const char * const DemoScene::sceneNames[] = { "triangle", "cube", "lines", "solar_system" };
+const char * const DemoScene::stressSceneNames[] = { "sphere_grid", "overdraw" };
+const char * const DemoScene::stateNames[] = { "wireframe", "color", "texture", "color_texture", "shading" };
+const char * const DemoScene::shaderNames[] = { "depth", "normal", "lambert", "phong", "blinn_phong", "blinn_phong_textured" };
+const char * const DemoScene::filterNames[] = { "point", "bilinear", "trilinear" };
+const char * const DemoScene::layoutNames[] = { "linear", "tiled", "morton", "bc1" };
+
+namespace {
+	// 设置光线追踪时的反射比例(用于静态Mesh的初始化)
+	shared_ptr<Mesh> reflective(const shared_ptr<Mesh> & mesh, float reflectivity) {
+		mesh->reflectivity = reflectivity;
+		return mesh;
+	}
+}
+
+int DemoScene::findFilter(const char * name) {
+	for (int i = 0; i < filterNum; i++)
+		if (!strcmp(name, filterNames[i])) return i;
+	return -1;
+}
+
+int DemoScene::findLayout(const char * name) {
+	for (int i = 0; i < layoutNum; i++)
+		if (!strcmp(name, layoutNames[i])) return i;
+	return -1;
+}
+
+shared_ptr<Mesh> DemoScene::createSphere(float radius, int space, const shared_ptr<Texture> & texture, const Shader & shader) {
+	const float & dtr = Math::DEGREE_TO_RADIUS;
+	size_t vertexCount = (180 / space) * (360 / space) * 4;
+	shared_ptr<Mesh> m = make_shared<Mesh>();
+	Vertex v;
+	v.color = Colors::White;
+	for (int b = 0; b < 180; b += space) {
+		for (int a = 0; a < 360; a += space) {
+			v.point.x = radius * sin(a * dtr) * sin(b * dtr);
+			v.point.y = radius * cos(a * dtr) * sin(b * dtr);
+			v.point.z = radius * cos(b * dtr);
+			v.texCoord.x = a / 360.f;
+			v.texCoord.y = b / 180.f;
+			v.normal = v.point;
+			m->vertices.push_back(v);
+
+			v.point.x = radius * sin(a * dtr) * sin((b + space) * dtr);
+			v.point.y = radius * cos(a * dtr) * sin((b + space) * dtr);
+			v.point.z = radius * cos((b + space) * dtr);
+			v.texCoord.x = a / 360.f;
+			v.texCoord.y = (b + space) / 180.f;
+			v.normal = v.point;
+			m->vertices.push_back(v);
+
+			v.point.x = radius * sin((a + space) * dtr) * sin(b * dtr);
+			v.point.y = radius * cos((a + space) * dtr) * sin(b * dtr);
+			v.point.z = radius * cos(b * dtr);
+			v.texCoord.x = (a + space) / 360.f;
+			v.texCoord.y = b / 180.f;
+			v.normal = v.point;
+			m->vertices.push_back(v);
+
+			v.point.x = radius * sin((a + space) * dtr) * sin((b + space) * dtr);
+			v.point.y = radius * cos((a + space) * dtr) * sin((b + space) * dtr);
+			v.point.z = radius * cos((b + space) * dtr);
+			v.texCoord.x = (a + space) / 360.f;
+			v.texCoord.y = (b + space) / 180.f;
+			v.normal = v.point;
+			m->vertices.push_back(v);
+		}
+	}
+	
+	for (size_t i = 0; i < vertexCount - 2; i++) {
+		// 保证每个面方向一致
+		m->primitives.push_back(i % 2 ? Primitive{ i, i + 1, i + 2 } : Primitive{ i + 2, i + 1, i });
+	}
+
+	m->buildStreams();
+	m->texture = texture;
+	m->shader = shader;
+	return m;
+}
+
+void DemoScene::solarSystem(Scene & scene, int frame) {
+	static shared_ptr<Mesh> sun = createSphere(3, 9, nullptr,
+		ShadeFunc([](RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) -> bool {
+		out = RGBColor(1, 1, 0);
+		return true;
+	}));
+	// 着色器在创建时设置, 每帧不再修改共享的Mesh(异步渲染时前一帧可能仍在使用)
+	static Shader shader = FragmentShader::blinn_phong_direction_light(Vector3(0, 0, 1), Colors::White * .1f, Colors::White * .45f, Colors::White * 1.5f, 4.f);
+	// 光线追踪时地球与月球反射太阳和彼此
+	static shared_ptr<Mesh> earth = reflective(createSphere(1, 10, nullptr, shader), .3f);
+	static shared_ptr<Mesh> moon = reflective(createSphere(0.5, 15, nullptr, shader), .3f);
+
+	scene.addMesh(sun);
+
+	// 动画只由帧号决定,保证同一帧的场景完全相同
+	float earthRevolution = 0.1f * (frame + 1);
+	float earthRotation = 1.f * (frame + 1);
+
+	scene.rotate(0, 1, 0, earthRotation);
+	scene.translate(0, 0, 10);
+	scene.rotate(0, 1, 0, earthRevolution);
+	scene.addMesh(earth);
+
+	float moonRevolution = 0.24f * (frame + 1);
+	scene.rotate(0, 1, 0, moonRevolution);
+	scene.translate(0, 0, 3);
+	scene.addMesh(moon);
+}
+
+void DemoScene::createScene(Scene & scene, int index, const shared_ptr<Texture> & texture, const Shader & shader, int frame) {
+	scene.clear();
+	shared_ptr<Mesh> m = make_shared<Mesh>();
+	m->texture = texture;
+	m->shader = shader;
+	switch (index) {
+	case 0:
+		m->vertices = { 
+			{ Vector3(0,1,0), Colors::Green, TexCoord{ 0, 1 } },
+			{ Vector3(1,0,0), Colors::Blue, TexCoord{ 1, 0 } },
+			{ Vector3(0,0,0), Colors::Red, TexCoord{ 0, 0 } },
+		};
+		m->primitives = { Primitive{ 0,1,2, Vector3(0,0,1) } };
+		scene.addMesh(m, Matrix44().translate(-.5f, -.5f, 0));
+		break;
+	case 1:
+		m->vertices = {
+			{ Vector3(-0.5f, -0.5f,  0.5f), Colors::Red,   TexCoord{ 0, 0 } },
+			{ Vector3(0.5f, -0.5f,  0.5f),  Colors::Green, TexCoord{ 1, 0 } },
+			{ Vector3(0.5f,  0.5f,  0.5f),  Colors::Blue,  TexCoord{ 1, 1 } },
+			{ Vector3(-0.5f,  0.5f,  0.5f), Colors::White, TexCoord{ 0, 1 } },
+			{ Vector3(-0.5f, -0.5f, -0.5f), Colors::Blue,  TexCoord{ 1, 0 } },
+			{ Vector3(-0.5f,  0.5f, -0.5f), Colors::Red,   TexCoord{ 1, 1 } },
+			{ Vector3(0.5f,  0.5f, -0.5f),  Colors::Green, TexCoord{ 0, 1 } },
+			{ Vector3(0.5f, -0.5f, -0.5f),  Colors::White, TexCoord{ 0, 0 } }
+		};
+		m->primitives = {
+			Primitive{ 0,1,2, Vector3(0,0,1) }, Primitive{ 0,2,3, Vector3(0,0,1) },
+			Primitive{ 4,5,6, Vector3(0,0,-1) }, Primitive{ 4,6,7, Vector3(0,0,-1) },
+			Primitive{ 5,3,2, Vector3(0,1,0) }, Primitive{ 5,2,6, Vector3(0,1,0) },
+			Primitive{ 4,7,1, Vector3(0,-1,0) }, Primitive{ 4,1,0, Vector3(0,-1,0) },
+			Primitive{ 7,6,2, Vector3(1,0,0) }, Primitive{ 7,2,1, Vector3(1,0,0) },
+			Primitive{ 4,0,3, Vector3(-1,0,0) }, Primitive{ 4,3,5, Vector3(-1,0,0) },
+		};
+		scene.addMesh(m);
+		break;
+	case 2:
+		for (float i = 0; i < 360; i += 5) {
+			scene.addLine(Line{
+			    Vertex { Vector3(0,0,0), Colors::White },
+			    Vertex { Vector3(0.7f * cos(i),0.7f * sin(i),1), Colors::Random() }
+			});
+		}
+		break;
+	case 3:
+		solarSystem(scene, frame);
+		break;
+	}
+}
+
+void DemoScene::setCamera(Scene & scene, float aspect, float rotateX, float rotateY, float translateZ) {
+	scene.setPerspective(70, aspect, 0.5f, 1000);
+	scene.setViewMatrix(Matrix44().rotate(0, 1, 0, rotateY).rotate(1, 0, 0, rotateX).translate(0, 0, translateZ));
+}
+
+void DemoScene::createStressScene(Scene & scene, int index, const shared_ptr<Texture> & texture, const Shader & shader) {
+	scene.clear();
+	switch (index) {
+	case 0: {
+		// 6x6个高面数球体(每个约7000个三角形)
+		// 光线追踪时相邻的球体互相反射
+		// 提交过的Mesh在异步渲染时可能仍被前一帧使用, 不能修改
+		// 每种纹理与着色器的组合各缓存一个Mesh, 几何数据只细分一次
+		static const shared_ptr<Mesh> geometry = reflective(createSphere(0.16f, 6), .5f);
+		static vector<shared_ptr<Mesh>> spheres;
+		shared_ptr<Mesh> sphere;
+		for (size_t i = 0; i < spheres.size() && !sphere; i++)
+			if (spheres[i]->texture == texture && spheres[i]->shader == shader) sphere = spheres[i];
+		if (!sphere) {
+			sphere = make_shared<Mesh>(*geometry);
+			sphere->texture = texture;
+			sphere->shader = shader;
+			spheres.push_back(sphere);
+		}
+		for (int y = 0; y < 6; y++)
+			for (int x = 0; x < 6; x++)
+				scene.addMesh(sphere, Matrix44().translate(-0.85f + x * 0.34f, -0.85f + y * 0.34f, 0.5f));
+		break;
+	}
+	case 1: {
+		// 16层由远及近绘制的四边形,每层都通过深度测试(最坏情况的重复绘制)
+		// 四边形大小随距离缩放,使每层在默认摄像机(距离1.5)下覆盖相同的屏幕区域
+		const int layers = 16;
+		shared_ptr<Mesh> m = make_shared<Mesh>();
+		m->texture = texture;
+		m->shader = shader;
+		for (int i = 0; i < layers; i++) {
+			float z = 2.f - i * 0.1f;
+			float hx = 0.8f * (z + 1.5f), hy = 0.6f * (z + 1.5f);
+			RGBColor color = RGBColor((float)i / layers, 1.f - (float)i / layers, 0.5f);
+			size_t base = m->vertices.size();
+			m->vertices.push_back(Vertex{ Vector3(-hx, -hy, z), color, TexCoord{ 0, 0 }, Vector3(0, 0, -1) });
+			m->vertices.push_back(Vertex{ Vector3(-hx,  hy, z), color, TexCoord{ 0, 1 }, Vector3(0, 0, -1) });
+			m->vertices.push_back(Vertex{ Vector3( hx,  hy, z), color, TexCoord{ 1, 1 }, Vector3(0, 0, -1) });
+			m->vertices.push_back(Vertex{ Vector3( hx, -hy, z), color, TexCoord{ 1, 0 }, Vector3(0, 0, -1) });
+			m->primitives.push_back(Primitive{ base, base + 1, base + 2 });
+			m->primitives.push_back(Primitive{ base, base + 2, base + 3 });
+		}
+		scene.addMesh(m);
+		break;
+	}
+	}
+}
+
+shared_ptr<Texture> DemoScene::checkerTexture(int size, int cellSize) {
+	shared_ptr<Texture> texture = make_shared<Texture>(size, size);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			texture->set(x, y, ((x / cellSize + y / cellSize) & 1) ? 0xff8040 : 0x2040ff);
+	texture->buildMipmaps();
+	return texture;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef _DEMOSCENE_H_
+#define _DEMOSCENE_H_
+
+#include "Pipeline.h"
+#include "ShaderPrefab.h"
+
+// 演示场景(窗口程序与无窗口渲染共用)
+namespace DemoScene {
+	const int stateNum = 5;
+	const int shaderNum = 6;
+	const int sceneNum = 4;
+	const int stressSceneNum = 2;
+	const int filterNum = 3;
+	const int layoutNum = 4;
+
+	// 可切换的渲染状态(线框,颜色,纹理,混色纹理,着色器)
+	extern const Pipeline::RenderState states[stateNum];
+	// 可切换的着色器(深度,法线,Lambert,Phong,Blinn-Phong,带纹理的Blinn-Phong)
+	extern const Shader shaders[shaderNum];
+
+	// 名称(用于输出)
+	extern const char * const sceneNames[sceneNum];
+	extern const char * const stressSceneNames[stressSceneNum];
+	extern const char * const stateNames[stateNum];
+	extern const char * const shaderNames[shaderNum];
+	extern const char * const filterNames[filterNum];   // 按Texture::Filter的顺序
+	extern const char * const layoutNames[layoutNum];   // 按Texture::Layout的顺序
+	// 按名称查找纹理过滤方式/内存布局, 找不到时返回-1
+	int findFilter(const char * name);
+	int findLayout(const char * name);
+
+	// 创建球体
+	shared_ptr<Mesh> createSphere(float radius, int space = 10, const shared_ptr<Texture> & texture = nullptr, const Shader & shader = nullptr);
+	// 太阳系场景(frame为动画帧号)
+	void solarSystem(Scene & scene, int frame);
+	// 根据编号创建场景(frame为动画帧号,只影响太阳系场景)
+	void createScene(Scene & scene, int index, const shared_ptr<Texture> & texture, const Shader & shader, int frame = 0);
+	// 根据编号创建压力测试场景(0: 高面数球体阵列, 1: 由远及近叠放的全屏四边形)
+	void createStressScene(Scene & scene, int index, const shared_ptr<Texture> & texture, const Shader & shader);
+	// 生成棋盘格纹理
+	shared_ptr<Texture> checkerTexture(int size, int cellSize);
+	// 设置摄像机(透视投影与观察矩阵)
+	void setCamera(Scene & scene, float aspect, float rotateX, float rotateY, float translateZ);
+}
+
+#endif
\ No newline at end of file
@@ -1,15 +1,55 @@
-#include "FrameBuffer.h"
+#include "Texture.h"
+#include <climits>
+#include <cstdio>
 #define STB_IMAGE_IMPLEMENTATION
-#include "include\stb_image.h"
+#include "include/stb_image.h"
 
-shared_ptr<IntBuffer> CreateTexture(const char * filename) {
+namespace {
+	// 读入整个文件, 失败时返回false
+	bool readFile(const char * filename, vector<unsigned char> & data) {
+		FILE * file = fopen(filename, "rb");
+		if (!file) return false;
+		unsigned char chunk[65536];
+		size_t n;
+		while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+			data.insert(data.end(), chunk, chunk + n);
+		bool ok = !ferror(file);
+		fclose(file);
+		return ok;
+	}
+
+	// 32位FNV-1a散列
+	unsigned hashBytes(const vector<unsigned char> & data) {
+		unsigned hash = 2166136261u;
+		for (unsigned char c : data)
+			hash = (hash ^ c) * 16777619u;
+		return hash;
+	}
+}
+
+shared_ptr<Texture> CreateTexture(const char * filename, Texture::Layout layout) {
+	vector<unsigned char> file;
+	if (!readFile(filename, file) || file.empty() || file.size() > INT_MAX) return shared_ptr<Texture>();
 	int width, height, comp;
-	stbi_uc * data = stbi_load(filename, &width, &height, &comp, STBI_rgb);
-	if (!data) return shared_ptr<IntBuffer>();
-	shared_ptr<IntBuffer> buffer = make_shared<IntBuffer>(width, height);
+	string cache = string(filename) + ".bc1";
+	unsigned sourceSize = (unsigned)file.size(), sourceHash = hashBytes(file);
+	if (layout == Texture::BC1 && stbi_info_from_memory(file.data(), (int)file.size(), &width, &height, &comp)) {
+		// 缓存由同一个图片文件生成且尺寸一致时使用缓存
+		shared_ptr<Texture> cached = Texture::loadCompressed(cache.c_str(), sourceSize, sourceHash);
+		if (cached && cached->getWidth() == (size_t)width && cached->getHeight() == (size_t)height) return cached;
+	}
+	stbi_uc * data = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &comp, STBI_rgb);
+	if (!data) return shared_ptr<Texture>();
+	shared_ptr<Texture> buffer = make_shared<Texture>(width, height);
 	for (int i = 0; i < width * height; i++) {
 		*(*buffer)(i) = (data[3 * i] << 16) | (data[3 * i + 1] << 8) | data[3 * i + 2];
 	}
 	stbi_image_free(data);
+	buffer->setLayout(layout);
+	if (layout == Texture::BC1) {
+		// 写缓存失败不影响本次使用
+		buffer->saveCompressed(cache.c_str(), sourceSize, sourceHash);
+		buffer->releaseSource();
+	}
 	return buffer;
 }
\ No newline at end of file
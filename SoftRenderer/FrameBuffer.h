@@ -5,43 +5,184 @@
 
 #include "Vector.h"
 #include "Color.h"
+#include "Allocator.h"
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <emmintrin.h>
 
 template <class T>
 class FrameBuffer {
 protected:
 	size_t width, height;
-	size_t size;
+	size_t pitch;           // 行距(元素数), 不补齐时等于width; 分块布局时为补齐到分块边长整数倍的宽度
+	size_t size;            // 存储的元素数
 	T * buffer;
+	BufferOptions options;
+	size_t tileSize;        // 分块边长, 0为按行线性存放
+	int tileShift;
+
+	// 行距: 分块布局时补齐到整数个分块, 否则按需补齐为奇数个缓存行
+	static size_t paddedPitch(size_t width, const BufferOptions & options) {
+		if (options.tileSize)
+			return (width + options.tileSize - 1) / options.tileSize * options.tileSize;
+		const size_t line = BufferAllocator::ALIGNMENT;
+		if (!options.padPitch || line % sizeof(T)) return width;
+		size_t lines = (width * sizeof(T) + line - 1) / line;
+		if (lines % 2 == 0) lines++;
+		return lines * line / sizeof(T);
+	}
+	// 用分配器分配并构造所有元素(分块布局时高度也补齐到整数个分块)
+	void allocate() {
+		size = pitch * (tileSize ? (height + tileSize - 1) / tileSize * tileSize : height);
+		buffer = (T *)options.allocator->allocate(size * sizeof(T));
+		for (size_t i = 0; i < size; i++) new (buffer + i) T;
+	}
+	void release() {
+		if (!buffer) return;
+		for (size_t i = 0; i < size; i++) buffer[i].~T();
+		options.allocator->deallocate(buffer, size * sizeof(T));
+		buffer = nullptr;
+		size = 0;
+	}
+
+	// 用data填充连续的count个元素: 4字节的平凡类型用SSE2每次写16字节, 其余逐个赋值
+	static void fillSpan(T * p, size_t count, const T & data, std::true_type) {
+		int bits;
+		memcpy(&bits, &data, sizeof(bits));
+		__m128i v = _mm_set1_epi32(bits);
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			_mm_storeu_si128((__m128i *)(p + i), v);
+			_mm_storeu_si128((__m128i *)(p + i + 4), v);
+			_mm_storeu_si128((__m128i *)(p + i + 8), v);
+			_mm_storeu_si128((__m128i *)(p + i + 12), v);
+		}
+		for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i *)(p + i), v);
+		for (; i < count; i++) p[i] = data;
+	}
+	static void fillSpan(T * p, size_t count, const T & data, std::false_type) {
+		for (size_t i = 0; i < count; i++) p[i] = data;
+	}
+	static void fillSpan(T * p, size_t count, const T & data) {
+		fillSpan(p, count, data, std::integral_constant<bool, sizeof(T) == 4 && std::is_trivially_copyable<T>::value>());
+	}
 
 public:
-	FrameBuffer(size_t width, size_t height) : width(width), height(height), size(width * height) {
-		buffer = new T[size];
+	FrameBuffer(size_t width, size_t height, const BufferOptions & options = BufferOptions())
+		: width(width), height(height), pitch(paddedPitch(width, options)), options(options), tileSize(options.tileSize), tileShift(0) {
+		assert((tileSize & (tileSize - 1)) == 0);
+		while (((size_t)1 << tileShift) < tileSize) tileShift++;
+		allocate();
 	}
 	~FrameBuffer() {
-		delete[] buffer;
+		release();
 	}
+	// 按新的内存选项重新分配(内容不保留)
+	void reset(const BufferOptions & options) {
+		release();
+		this->options = options;
+		pitch = paddedPitch(width, options);
+		tileSize = options.tileSize;
+		assert((tileSize & (tileSize - 1)) == 0);
+		for (tileShift = 0; ((size_t)1 << tileShift) < tileSize; tileShift++);
+		allocate();
+	}
+	FrameBuffer(const FrameBuffer &) = delete;
+	FrameBuffer & operator=(const FrameBuffer &) = delete;
 
 	inline size_t getWidth() const { return width; }
 	inline size_t getHeight() const { return height; }
+	inline size_t getPitch() const { return pitch; }
 	inline size_t getSize() const { return size; }
+	const BufferOptions & getOptions() const { return options; }
 	inline float aspect() const { return (float)getWidth() / getHeight(); }
 
-	void set(size_t x, size_t y, const T & data) { assert(y * width + x < size); buffer[y * width + x] = data; }
+	// 元素(x, y)在存储中的位置. 分块布局时分块按行排列, 分块内按行存放
+	size_t offset(size_t x, size_t y) const {
+		if (!tileSize) return y * pitch + x;
+		size_t mask = tileSize - 1;
+		return (((y >> tileShift) * pitch + (x & ~mask)) << tileShift) + ((y & mask) << tileShift) + (x & mask);
+	}
+	// 第x列开始在同一行内连续存放的元素数(到行尾, 分块布局时到分块的右边界)
+	size_t rowRun(size_t x) const {
+		return tileSize ? MIN(tileSize - (x & (tileSize - 1)), width - x) : width - x;
+	}
+
+	void set(size_t x, size_t y, const T & data) { assert(offset(x, y) < size); buffer[offset(x, y)] = data; }
+	// 以index为下标的接口按存储位置(offset(x, y))寻址
 	void set(size_t index, const T & data) { assert(index < size); buffer[index] = data; }
-	void add(size_t x, size_t y, const T & data) { assert(y * width + x < size); buffer[y * width + x] += data; }
+	void add(size_t x, size_t y, const T & data) { assert(offset(x, y) < size); buffer[offset(x, y)] += data; }
 	void add(size_t index, const T & data) { assert(index < size); buffer[index] += data; }
 
-	void clear(size_t x, size_t y) { assert(y * width + x < size); buffer[y * width + x] = T(); }
+	void clear(size_t x, size_t y) { assert(offset(x, y) < size); buffer[offset(x, y)] = T(); }
 	void fill(const T & data) { 
-		for (size_t i = 0; i < size; i++) buffer[i] = data;
+		fillSpan(buffer, size, data);
 	}
-	T get(size_t x, size_t y) const { assert(y * width + x < size); return buffer[y * width + x]; }
+	// 填充矩形[x0, x1) x [y0, y1)
+	void fill(size_t x0, size_t y0, size_t x1, size_t y1, const T & data) {
+		assert(x0 <= x1 && x1 <= width && y0 <= y1 && y1 <= height);
+		size_t mask = tileSize - 1;
+		if (tileSize && !(x0 & mask) && !(y0 & mask) && (!(x1 & mask) || x1 == width) && (!(y1 & mask) || y1 == height)) {
+			// 由整数个分块组成时, 同一分块行中相邻的分块在存储中连续(右侧与下方的分块连同补齐部分一起填充)
+			size_t x1Aligned = (x1 + mask) & ~mask;
+			for (size_t y = y0; y < y1; y += tileSize)
+				fillSpan(buffer + offset(x0, y), (x1Aligned - x0) << tileShift, data);
+			return;
+		}
+		for (size_t y = y0; y < y1; y++)
+			for (size_t x = x0; x < x1; ) {
+				size_t n = MIN(rowRun(x), x1 - x);
+				fillSpan(buffer + offset(x, y), n, data);
+				x += n;
+			}
+	}
+	// 复制矩形[x0, x1) x [y0, y1)到尺寸相同的dst, 两者的布局可以不同(如分块布局到线性布局)
+	void copyTo(FrameBuffer & dst, size_t x0, size_t y0, size_t x1, size_t y1) const {
+		assert(dst.width == width && dst.height == height && x0 <= x1 && x1 <= width && y0 <= y1 && y1 <= height);
+		if (tileSize && !dst.tileSize && !(x0 & (tileSize - 1))) {
+			// 分块到线性: 每行依次取各分块中的一行, 按固定步长前进, 不逐段计算位置
+			size_t full = x0 + ((x1 - x0) >> tileShift << tileShift), step = tileSize << tileShift;
+			for (size_t y = y0; y < y1; y++) {
+				const T * src = buffer + offset(x0, y);
+				T * row = dst.buffer + y * dst.pitch;
+				for (size_t x = x0; x < full; x += tileSize, src += step)
+					for (size_t i = 0; i < tileSize; i++) row[x + i] = src[i];
+				for (size_t x = full; x < x1; x++) row[x] = src[x - full];
+			}
+			return;
+		}
+		for (size_t y = y0; y < y1; y++)
+			for (size_t x = x0; x < x1; ) {
+				size_t n = MIN(MIN(rowRun(x), dst.rowRun(x)), x1 - x);
+				memcpy(dst.buffer + dst.offset(x, y), buffer + offset(x, y), n * sizeof(T));
+				x += n;
+			}
+	}
+	// 按行复制到连续的width * height个元素
+	void copyTo(T * dst) const {
+		if (pitch == width && !tileSize) {
+			memcpy(dst, buffer, width * height * sizeof(T));
+			return;
+		}
+		for (size_t y = 0; y < height; y++)
+			for (size_t x = 0; x < width; ) {
+				size_t n = rowRun(x);
+				memcpy(dst + y * width + x, buffer + offset(x, y), n * sizeof(T));
+				x += n;
+			}
+	}
+	T get(size_t x, size_t y) const { assert(offset(x, y) < size); return buffer[offset(x, y)]; }
 	T get(size_t index) const { assert(index < size); return buffer[index]; }
-	void get(T & ref, size_t x, size_t y) const { assert(y * width + x < size); ref = buffer[y * width + x]; }
+	void get(T & ref, size_t x, size_t y) const { assert(offset(x, y) < size); ref = buffer[offset(x, y)]; }
 	void get(T & ref, size_t index) const { assert(index < size); ref = buffer[index]; }
 
+	// 分块布局时(x, y)处的指针只在rowRun(x)个元素内有效
 	T * operator()(size_t index = 0) { return buffer + index; }
-	T * operator()(size_t x, size_t y) { return buffer + (y * width + x); }
+	T * operator()(size_t x, size_t y) { return buffer + offset(x, y); }
+	const T * operator()(size_t index = 0) const { return buffer + index; }
+	const T * operator()(size_t x, size_t y) const { return buffer + offset(x, y); }
 
 	// x, y 在[0, 1)范围内
 	T get(float x, float y) const {
@@ -60,6 +201,4 @@ typedef FrameBuffer<float> FloatBuffer;
 typedef FrameBuffer<int> IntBuffer;
 typedef FrameBuffer<RGBColor> ColorBuffer;
 
-shared_ptr<IntBuffer> CreateTexture(const char * filename);
-
 #endif
\ No newline at end of file
@@ -0,0 +1,365 @@
+// 使用标准C的fopen/sscanf
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Headless.h"
+#include "DemoScene.h"
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "include/stb_image_write.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace {
+	// 将0xRRGGBB格式的像素转换为RGB24
+	void toRGB24(const IntBuffer & image, vector<unsigned char> & rgb) {
+		size_t w = image.getWidth(), h = image.getHeight();
+		rgb.resize(w * h * 3);
+		for (size_t y = 0; y < h; y++) {
+			const int * row = image(0, y);
+			for (size_t x = 0; x < w; x++) {
+				size_t i = y * w + x;
+				rgb[3 * i] = (unsigned char)(row[x] >> 16);
+				rgb[3 * i + 1] = (unsigned char)(row[x] >> 8);
+				rgb[3 * i + 2] = (unsigned char)row[x];
+			}
+		}
+	}
+
+	bool endsWith(const string & s, const char * suffix) {
+		size_t n = strlen(suffix);
+		if (s.size() < n) return false;
+		for (size_t i = 0; i < n; i++)
+			if (tolower(s[s.size() - n + i]) != suffix[i]) return false;
+		return true;
+	}
+
+	bool isValueOption(const char * arg) {
+		static const char * const names[] = {
+			"--size", "--frames", "--scene", "--mode", "--shader", "--rotate",
+			"--spin", "--distance", "--texture", "--filter", "--layout", "--output", "--trace", "--threads",
+			"--buffer-tiles", "--ray-depth", "--samples", "--seed"
+		};
+		for (const char * name : names)
+			if (!strcmp(arg, name)) return true;
+		return false;
+	}
+
+	bool isRawOutput(const string & output) {
+		return output == "-" || endsWith(output, ".raw");
+	}
+
+	// 逐帧输出的文件名作为snprintf的格式串, 只允许一个%d(可带宽度, 如%04d)和转义的%%
+	bool isFramePattern(const string & output) {
+		int frames = 0;
+		for (size_t i = 0; i < output.size(); i++) {
+			if (output[i] != '%') continue;
+			if (++i < output.size() && output[i] == '%') continue;
+			while (i < output.size() && isdigit((unsigned char)output[i])) i++;
+			if (i >= output.size() || output[i] != 'd') return false;
+			frames++;
+		}
+		return frames == 1;
+	}
+}
+
+void Headless::printUsage(const char * program) {
+	fprintf(stderr,
+		"usage: %s --headless [options]\n"
+		"  --size WxH        image size (default 700x500)\n"
+		"  --frames N        number of frames to render (default 1)\n"
+		"  --scene I         scene index [0, %d)\n"
+		"  --mode I          render state: 0 wireframe, 1 color, 2 texture, 3 color texture, 4 shading\n"
+		"  --shader I        shader index [0, %d)\n"
+		"  --rotate X,Y      camera rotation in degrees\n"
+		"  --spin D          degrees added to the Y rotation every frame\n"
+		"  --distance Z      camera distance (default 1.5)\n"
+		"  --texture FILE    texture image\n"
+		"  --filter NAME     texture filter: point (default), bilinear or trilinear (mipmapped)\n"
+		"  --layout NAME     texture memory layout: linear (default), tiled (4x4 blocks), morton\n"
+		"                    or bc1 (4x4 block compression, cached next to the image as FILE.bc1)\n"
+		"  --tile            tile binning rasterization\n"
+		"  --halfspace       half-space rasterizer\n"
+		"  --fixed           fixed-point half-space rasterizer with top-left fill rule\n"
+		"  --no-hiz          disable hierarchical Z culling\n"
+		"  --no-fast-clear   fill the whole color/depth buffers every frame instead of clearing tiles lazily\n"
+		"  --buffer-tiles N  store the color/depth buffers as NxN tiles (8, 16, 32 or 64; 0 = linear)\n"
+		"  --raytrace        ray trace a BVH of the scene instead of rasterizing (primary rays and mirror reflections)\n"
+		"  --ray-depth N     maximum number of reflections when ray tracing (default 2)\n"
+		"  --pathtrace       progressive path tracing: every frame adds samples to an accumulation\n"
+		"                    buffer until the camera or the scene changes\n"
+		"  --samples N       path tracing samples per pixel per frame (default 1)\n"
+		"  --seed N          path tracing random seed (default 0)\n"
+		"  --threads N       worker threads including the render thread (default: hardware threads)\n"
+		"  --pin             pin worker threads to CPUs\n"
+		"  --pipelined       overlap the next frame's geometry with rasterizing and writing the current one\n"
+		"  --output FILE     png/bmp/tga/jpg/ppm image of the last frame, a name containing %%d\n"
+		"                    for every frame, or a .raw file / - (stdout) for an RGB24 stream\n"
+		"  --trace FILE      write a Chrome trace-event JSON timeline of the rendered frames\n",
+		program, DemoScene::sceneNum, DemoScene::shaderNum);
+}
+
+bool Headless::parseArgs(int argc, char * argv[], Options & options) {
+	for (int i = 1; i < argc; i++) {
+		const char * arg = argv[i];
+		const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = true;
+		if (!strcmp(arg, "--help")) {
+			return false;
+		} else if (!strcmp(arg, "--headless")) {
+			continue;
+		} else if (!strcmp(arg, "--tile")) {
+			options.tile = true;
+			continue;
+		} else if (!strcmp(arg, "--halfspace")) {
+			options.halfSpace = true;
+			continue;
+		} else if (!strcmp(arg, "--fixed")) {
+			options.fixedPoint = true;
+			continue;
+		} else if (!strcmp(arg, "--no-hiz")) {
+			options.hiZ = false;
+			continue;
+		} else if (!strcmp(arg, "--no-fast-clear")) {
+			options.fastClear = false;
+			continue;
+		} else if (!strcmp(arg, "--raytrace")) {
+			options.rayTrace = true;
+			continue;
+		} else if (!strcmp(arg, "--pathtrace")) {
+			options.pathTrace = true;
+			continue;
+		} else if (!strcmp(arg, "--pin")) {
+			options.pin = true;
+			continue;
+		} else if (!strcmp(arg, "--pipelined")) {
+			options.pipelined = true;
+			continue;
+		} else if (!value) {
+			if (isValueOption(arg))
+				fprintf(stderr, "missing value for %s\n", arg);
+			else
+				fprintf(stderr, "unknown option: %s\n", arg);
+			return false;
+		} else if (!strcmp(arg, "--size")) {
+			ok = sscanf(value, "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+		} else if (!strcmp(arg, "--frames")) {
+			options.frames = atoi(value);
+			ok = options.frames > 0;
+		} else if (!strcmp(arg, "--scene")) {
+			options.scene = atoi(value);
+			ok = options.scene >= 0 && options.scene < DemoScene::sceneNum;
+		} else if (!strcmp(arg, "--mode")) {
+			options.mode = atoi(value);
+			ok = options.mode >= 0 && options.mode < DemoScene::stateNum;
+		} else if (!strcmp(arg, "--shader")) {
+			options.shader = atoi(value);
+			ok = options.shader >= 0 && options.shader < DemoScene::shaderNum;
+		} else if (!strcmp(arg, "--rotate")) {
+			ok = sscanf(value, "%f,%f", &options.rotateX, &options.rotateY) == 2;
+		} else if (!strcmp(arg, "--spin")) {
+			options.spin = (float)atof(value);
+		} else if (!strcmp(arg, "--distance")) {
+			options.translateZ = (float)atof(value);
+		} else if (!strcmp(arg, "--threads")) {
+			options.threads = atoi(value);
+			ok = options.threads > 0 && options.threads <= 1024;
+		} else if (!strcmp(arg, "--buffer-tiles")) {
+			options.bufferTiles = atoi(value);
+			ok = options.bufferTiles == 0 || (options.bufferTiles >= 8 && options.bufferTiles <= 64 && !(options.bufferTiles & (options.bufferTiles - 1)));
+		} else if (!strcmp(arg, "--ray-depth")) {
+			options.rayDepth = atoi(value);
+			ok = options.rayDepth >= 0;
+		} else if (!strcmp(arg, "--samples")) {
+			options.samples = atoi(value);
+			ok = options.samples > 0;
+		} else if (!strcmp(arg, "--seed")) {
+			options.seed = (unsigned)strtoul(value, nullptr, 10);
+		} else if (!strcmp(arg, "--texture")) {
+			options.texture = value;
+		} else if (!strcmp(arg, "--filter")) {
+			options.filter = DemoScene::findFilter(value);
+			ok = options.filter >= 0;
+		} else if (!strcmp(arg, "--layout")) {
+			options.layout = DemoScene::findLayout(value);
+			ok = options.layout >= 0;
+		} else if (!strcmp(arg, "--output")) {
+			options.output = value;
+			ok = options.output.find('%') == string::npos || isFramePattern(options.output);
+		} else if (!strcmp(arg, "--trace")) {
+			options.trace = value;
+		} else {
+			fprintf(stderr, "unknown option: %s\n", arg);
+			return false;
+		}
+		if (!ok) {
+			fprintf(stderr, "invalid value for %s\n", arg);
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+bool Headless::writeImage(const IntBuffer & image, const char * filename) {
+	int w = (int)image.getWidth(), h = (int)image.getHeight();
+	vector<unsigned char> rgb;
+	toRGB24(image, rgb);
+
+	string name(filename);
+	if (endsWith(name, ".png"))
+		return stbi_write_png(filename, w, h, 3, rgb.data(), w * 3) != 0;
+	if (endsWith(name, ".bmp"))
+		return stbi_write_bmp(filename, w, h, 3, rgb.data()) != 0;
+	if (endsWith(name, ".tga"))
+		return stbi_write_tga(filename, w, h, 3, rgb.data()) != 0;
+	if (endsWith(name, ".jpg") || endsWith(name, ".jpeg"))
+		return stbi_write_jpg(filename, w, h, 3, rgb.data(), 95) != 0;
+	if (endsWith(name, ".ppm")) {
+		// stb_image_write不支持PPM,直接写二进制P6
+		FILE * file = fopen(filename, "wb");
+		if (!file) return false;
+		fprintf(file, "P6\n%d %d\n255\n", w, h);
+		bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+		return fclose(file) == 0 && ok;
+	}
+	fprintf(stderr, "unsupported image format: %s\n", filename);
+	return false;
+}
+
+bool Headless::writeRaw(const IntBuffer & image, FILE * file) {
+	vector<unsigned char> rgb;
+	toRGB24(image, rgb);
+	return fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+}
+
+int Headless::run(const Options & options) {
+	IntBuffer image(options.width, options.height);
+	Pipeline pipeline(image);
+	pipeline.setRenderState(DemoScene::states[options.mode]);
+	pipeline.setParallelMode(options.tile ? Pipeline::PARALLEL_TILE : Pipeline::PARALLEL_PRIMITIVE);
+	pipeline.setRasterizer(options.fixedPoint ? Pipeline::RASTERIZER_FIXED :
+		options.halfSpace ? Pipeline::RASTERIZER_HALFSPACE : Pipeline::RASTERIZER_SCANLINE);
+	pipeline.setHiZ(options.hiZ);
+	pipeline.setFastClear(options.fastClear);
+	pipeline.setBufferTiling(options.bufferTiles);
+	pipeline.setRayTracing(options.rayTrace);
+	pipeline.setRayDepth(options.rayDepth);
+	pipeline.setPathTracing(options.pathTrace);
+	pipeline.setPathSamples(options.samples);
+	pipeline.setPathSeed(options.seed);
+	pipeline.setThreadCount(options.threads);
+	pipeline.setThreadAffinity(options.pin);
+
+	shared_ptr<Texture> texture;
+	if (!options.texture.empty()) {
+		texture = CreateTexture(options.texture.c_str(), (Texture::Layout)options.layout);
+		if (!texture) {
+			fprintf(stderr, "failed to load texture: %s\n", options.texture.c_str());
+			return 1;
+		}
+		texture->setFilter((Texture::Filter)options.filter);
+	}
+	const Shader & shader = DemoScene::shaders[options.shader];
+
+	// 原始数据流输出到标准输出或.raw文件, 每帧依次追加
+	FILE * raw = nullptr;
+	if (isRawOutput(options.output)) {
+		if (options.output == "-") {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			raw = stdout;
+		} else {
+			raw = fopen(options.output.c_str(), "wb");
+			if (!raw) {
+				fprintf(stderr, "failed to open %s\n", options.output.c_str());
+				return 1;
+			}
+		}
+	}
+	bool perFrame = options.output.find('%') != string::npos;
+	// 输出完成的一帧
+	auto output = [&](const IntBuffer & frameImage, int frame) {
+		if (raw)
+			return writeRaw(frameImage, raw);
+		if (perFrame) {
+			char filename[1024];
+			snprintf(filename, sizeof(filename), options.output.c_str(), frame);
+			return writeImage(frameImage, filename);
+		}
+		return true;
+	};
+
+	Scene scene;
+	DemoScene::createScene(scene, options.scene, texture, shader);
+	float rotateY = options.rotateY;
+	double renderTime = 0;
+	int result = 0;
+	if (!options.trace.empty()) Trace::start();
+	const IntBuffer * last = &image;
+	Pipeline::Fence previous;
+	for (int frame = 0; frame < options.frames && !result; frame++) {
+		TRACE_SCOPE("frame", "frame", frame);
+		// 动画场景每帧重建(与窗口程序一致)
+		if (frame > 0 && options.scene == 3)
+			DemoScene::createScene(scene, options.scene, texture, shader, frame);
+		DemoScene::setCamera(scene, image.aspect(), options.rotateX, rotateY, options.translateZ);
+		rotateY += options.spin;
+
+		auto start = std::chrono::steady_clock::now();
+		if (options.pipelined) {
+			// 提交本帧后等待并输出上一帧
+			Pipeline::Fence current = pipeline.renderAsync(scene);
+			const IntBuffer * finished = previous ? previous.wait() : nullptr;
+			renderTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			previous = current;
+			if (finished && !output(*finished, frame - 1)) result = 1;
+		} else {
+			pipeline.render(scene);
+			renderTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (!output(image, frame)) result = 1;
+		}
+	}
+	if (previous) {
+		auto start = std::chrono::steady_clock::now();
+		last = previous.wait();
+		renderTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!result && !output(*last, options.frames - 1)) result = 1;
+	}
+	if (!result && !raw && !perFrame && !options.output.empty() && !writeImage(*last, options.output.c_str()))
+		result = 1;
+	if (raw && raw != stdout) fclose(raw);
+	if (!options.trace.empty()) {
+		Trace::stop();
+		if (!Trace::write(options.trace.c_str())) {
+			fprintf(stderr, "failed to write %s\n", options.trace.c_str());
+			return 1;
+		}
+	}
+	if (result) {
+		fprintf(stderr, "failed to write %s\n", options.output.c_str());
+		return result;
+	}
+
+	fprintf(stderr, "%d frames, %.3f ms/frame\n", options.frames, renderTime * 1000 / options.frames);
+	return 0;
+}
+
+int Headless::run(int argc, char * argv[]) {
+	Options options;
+	if (!parseArgs(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	return run(options);
+}
\ No newline at end of file
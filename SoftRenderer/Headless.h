@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#include "Texture.h"
+
+#include <cstdio>
+
+// 无窗口渲染: 不依赖任何窗口系统,渲染指定帧数并输出到图像文件或原始数据流
+namespace Headless {
+	// 渲染参数(对应命令行选项)
+	struct Options {
+		int width = 700, height = 500;  // --size WxH
+		int frames = 1;                 // --frames N
+		int scene = 0;                  // --scene I   场景编号
+		int mode = 0;                   // --mode I    渲染状态编号(线框,颜色,纹理,混色纹理,着色器)
+		int shader = 0;                 // --shader I  着色器编号
+		float rotateX = 0, rotateY = 0; // --rotate X,Y 视角(角度)
+		float spin = 0;                 // --spin D    每帧绕Y轴增加的角度
+		float translateZ = 1.5f;        // --distance Z
+		bool tile = false;              // --tile      分块分箱光栅化
+		bool halfSpace = false;         // --halfspace 边函数光栅化
+		bool fixedPoint = false;        // --fixed     定点数边函数光栅化(左上填充规则)
+		bool hiZ = true;                // --no-hiz    关闭层次Z剔除
+		bool fastClear = true;          // --no-fast-clear 每帧整体填充缓冲区(关闭按分块的延迟清除)
+		int bufferTiles = 0;            // --buffer-tiles N 颜色/深度缓冲区按NxN分块存放(8, 16, 32, 64), 0为线性布局
+		bool rayTrace = false;          // --raytrace  以光线追踪代替光栅化(BVH, 主光线与镜面反射)
+		int rayDepth = 2;               // --ray-depth N 光线追踪的最大反射次数
+		bool pathTrace = false;         // --pathtrace 路径追踪, 逐帧累积样本(场景与相机不变时)
+		int samples = 1;                // --samples N 路径追踪每帧每像素的样本数
+		unsigned seed = 0;              // --seed N    路径追踪的随机种子
+		int threads = 0;                // --threads N 工作线程数(0为硬件线程数)
+		bool pin = false;               // --pin       把工作线程绑定到固定的CPU
+		bool pipelined = false;         // --pipelined 异步渲染: 下一帧的几何处理与上一帧的光栅化、输出同时进行
+		string texture;                 // --texture FILE
+		int filter = Texture::POINT;    // --filter NAME 纹理过滤方式(point, bilinear, trilinear)
+		int layout = Texture::LINEAR;   // --layout NAME 纹理内存布局(linear, tiled, morton, bc1)
+		string output;                  // --output FILE (png/bmp/tga/jpg/ppm/raw, 含%d时逐帧输出, -为标准输出的原始数据流)
+		string trace;                   // --trace FILE  输出Chrome trace-event JSON格式的帧时间线
+	};
+
+	// 解析命令行,失败时返回false并输出错误
+	bool parseArgs(int argc, char * argv[], Options & options);
+	// 输出命令行用法
+	void printUsage(const char * program);
+
+	// 按扩展名保存图像(ppm/png/bmp/tga/jpg)
+	bool writeImage(const IntBuffer & image, const char * filename);
+	// 以RGB24原始格式追加写入一帧
+	bool writeRaw(const IntBuffer & image, FILE * file);
+
+	// 按参数渲染并输出,返回进程退出码
+	int run(const Options & options);
+	// 解析命令行并渲染,返回进程退出码
+	int run(int argc, char * argv[]);
+}
+
+#endif
\ No newline at end of file
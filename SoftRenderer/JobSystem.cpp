@@ -0,0 +1,201 @@
+#include "JobSystem.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+	thread_local int localIndex = 0;
+
+	// 没有任务时先自旋若干次再休眠, 避免帧内短暂的空隙导致线程反复睡眠唤醒
+	const int SPIN_COUNT = 2000;
+
+	// 调用线程绑定前的亲和性(每个线程各自记录), 关闭绑定时恢复
+	struct CallerAffinity {
+		bool saved = false;
+#ifdef _WIN32
+		DWORD_PTR mask = 0;
+#elif defined(__linux__)
+		cpu_set_t mask;
+#endif
+	};
+	thread_local CallerAffinity callerAffinity;
+
+	// 把调用线程绑定到CPU 0(pinned为true), 或恢复绑定前的亲和性
+	void pinCaller(bool pinned) {
+		CallerAffinity & a = callerAffinity;
+#ifdef _WIN32
+		if (pinned) {
+			DWORD_PTR previous = SetThreadAffinityMask(GetCurrentThread(), 1);
+			if (previous && !a.saved) a.mask = previous, a.saved = true;
+		} else if (a.saved) {
+			SetThreadAffinityMask(GetCurrentThread(), a.mask);
+			a.saved = false;
+		}
+#elif defined(__linux__)
+		if (pinned) {
+			if (!a.saved) a.saved = pthread_getaffinity_np(pthread_self(), sizeof(a.mask), &a.mask) == 0;
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(0, &set);
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		} else if (a.saved) {
+			pthread_setaffinity_np(pthread_self(), sizeof(a.mask), &a.mask);
+			a.saved = false;
+		}
+#else
+		(void)pinned;
+		(void)a;
+#endif
+	}
+}
+
+JobSystem::JobSystem(int threadCount) : running(false), queued(0), pinned(false) {
+	start(threadCount > 0 ? threadCount : hardwareThreads());
+}
+
+JobSystem::~JobSystem() {
+	stop();
+	if (pinned) pinCaller(false);
+}
+
+int JobSystem::threadIndex() {
+	return localIndex;
+}
+
+int JobSystem::hardwareThreads() {
+	int n = (int)std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void JobSystem::start(int threadCount) {
+	workers.clear();
+	for (int i = 0; i < threadCount; i++)
+		workers.emplace_back(new Worker());
+	running = true;
+	for (int i = 1; i < threadCount; i++) {
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+		if (pinned) pin(i);
+	}
+}
+
+void JobSystem::stop() {
+	{
+		std::lock_guard<std::mutex> guard(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (size_t i = 1; i < workers.size(); i++)
+		if (workers[i]->thread.joinable()) workers[i]->thread.join();
+}
+
+void JobSystem::setThreadCount(int threadCount) {
+	threadCount = MAX(threadCount, 1);
+	if (threadCount == getThreadCount()) return;
+	stop();
+	start(threadCount);
+}
+
+void JobSystem::setAffinity(bool pinned) {
+	if (this->pinned == pinned) return;
+	this->pinned = pinned;
+	// 调用线程同样执行任务, 与后台线程一起绑定
+	pinCaller(pinned);
+	// 重新创建线程以恢复(或设置)默认的亲和性
+	int threadCount = getThreadCount();
+	stop();
+	start(threadCount);
+}
+
+void JobSystem::pin(int index) {
+	int cpu = index % hardwareThreads();
+#ifdef _WIN32
+	SetThreadAffinityMask((HANDLE)workers[index]->thread.native_handle(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(workers[index]->thread.native_handle(), sizeof(set), &set);
+#else
+	(void)cpu;
+#endif
+}
+
+void JobSystem::spawn(Group & group, Job job) {
+	group.pending.fetch_add(1, std::memory_order_relaxed);
+	int self = MIN(threadIndex(), getThreadCount() - 1);
+	Worker & w = *workers[self];
+	{
+		std::lock_guard<std::mutex> guard(w.mutex);
+		w.tasks.push_back(Task{ std::move(job), &group });
+	}
+	queued.fetch_add(1, std::memory_order_release);
+	if (workers.size() > 1) {
+		// 与休眠线程的条件检查互斥, 避免丢失唤醒
+		std::lock_guard<std::mutex> guard(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+void JobSystem::parallelFor(Group & group, int count, int grain, const function<void(int, int)> & body) {
+	grain = MAX(grain, 1);
+	// 从最后一段开始提交: 当前线程从队列尾部取出时按从前到后的顺序执行, 窃取的线程从另一端取走靠后的段
+	for (int begin = (count - 1) / grain * grain; begin >= 0; begin -= grain) {
+		int end = MIN(begin + grain, count);
+		spawn(group, [body, begin, end]() { body(begin, end); });
+	}
+}
+
+bool JobSystem::runOne(int self) {
+	Task task;
+	bool found = false;
+	int n = getThreadCount();
+	// 先取自己最近提交的任务, 再从其他线程的队列头部窃取最早提交的任务
+	for (int k = 0; k < n && !found; k++) {
+		Worker & w = *workers[(self + k) % n];
+		std::lock_guard<std::mutex> guard(w.mutex);
+		if (w.tasks.empty()) continue;
+		if (k == 0) {
+			task = std::move(w.tasks.back());
+			w.tasks.pop_back();
+		} else {
+			task = std::move(w.tasks.front());
+			w.tasks.pop_front();
+		}
+		found = true;
+	}
+	if (!found) return false;
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	task.job();
+	task.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+	return true;
+}
+
+void JobSystem::workerLoop(int index) {
+	localIndex = index;
+	int idle = 0;
+	while (running.load(std::memory_order_relaxed)) {
+		if (runOne(index)) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < SPIN_COUNT) {
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return !running || queued.load(std::memory_order_acquire) > 0; });
+		idle = 0;
+	}
+}
+
+void JobSystem::wait(Group & group) {
+	int self = threadIndex();
+	while (!group.done()) {
+		if (!runOne(self))
+			std::this_thread::yield();
+	}
+}
\ No newline at end of file
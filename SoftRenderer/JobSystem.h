@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef _JOBSYSTEM_H_
+#define _JOBSYSTEM_H_
+
+#include "Define.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// 持久的工作窃取线程池. 每个工作线程有自己的任务队列, 新任务放入当前线程的队列,
+// 空闲的线程从其他线程的队列头部窃取. 提交任务并调用wait的线程(渲染线程)是0号工作线程,
+// 其余threadCount - 1个线程常驻后台, 没有任务时休眠.
+// 只允许一个线程提交任务和等待(任务内部可以继续提交)
+class JobSystem {
+public:
+	typedef function<void()> Job;
+
+	// 一组任务的完成计数. 任务执行期间可以向同一组继续添加任务, wait在全部完成后返回
+	class Group {
+		std::atomic<int> pending;
+		friend class JobSystem;
+	public:
+		Group() : pending(0) {}
+		bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+	};
+
+private:
+	struct Task {
+		Job job;
+		Group * group;
+	};
+
+	// 一个工作线程的任务队列: 自己从尾部取出最新的任务(LIFO, 数据仍在缓存中), 其他线程从头部窃取最早的任务(FIFO)
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+
+	vector<std::unique_ptr<Worker>> workers;
+	std::atomic<bool> running;
+	std::atomic<int> queued;                // 所有队列中的任务数
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool pinned;                            // 工作线程是否绑定到固定的CPU
+
+	// 从自己的队列或其他线程的队列中取出一个任务执行, 没有任务时返回false
+	bool runOne(int self);
+	void workerLoop(int index);
+	void start(int threadCount);
+	void stop();
+	// 把第index个工作线程绑定到CPU(index % CPU数)
+	void pin(int index);
+
+public:
+	// threadCount为0时使用硬件线程数
+	explicit JobSystem(int threadCount = 0);
+	~JobSystem();
+
+	// 设置线程数(包括调用wait的线程), 不能在任务执行期间调用
+	void setThreadCount(int threadCount);
+	int getThreadCount() const { return (int)workers.size(); }
+	// 设置是否把工作线程绑定到固定的CPU(第i个线程绑定到CPU i). 调用线程也执行任务, 作为0号线程绑定到CPU 0,
+	// 关闭绑定时恢复其原来的亲和性. 只能在提交任务的线程调用
+	void setAffinity(bool pinned);
+	bool getAffinity() const { return pinned; }
+
+	// 当前线程的工作线程编号, 在[0, getThreadCount())内; 非工作线程为0
+	static int threadIndex();
+	// 硬件线程数
+	static int hardwareThreads();
+
+	// 向组提交一个任务
+	void spawn(Group & group, Job job);
+	// 把[0, count)按grain个一段提交为多个任务, 每个任务调用body(begin, end)
+	void parallelFor(Group & group, int count, int grain, const function<void(int, int)> & body);
+	// 给组增加一个不对应任务的计数, release之前wait不会返回(用于等待任务以外的条件)
+	void retain(Group & group) { group.pending.fetch_add(1, std::memory_order_relaxed); }
+	void release(Group & group) { group.pending.fetch_sub(1, std::memory_order_acq_rel); }
+	// 执行任务直到组内的任务全部完成
+	void wait(Group & group);
+};
+
+#endif
\ No newline at end of file
@@ -1,171 +1,32 @@
-﻿#include "Window.h"
-#include "Pipeline.h"
-#include "ShaderPrefab.h"
+﻿#include "DemoScene.h"
+#include "Headless.h"
+#include "Benchmark.h"
+
+#include <cstring>
 
 using namespace std;
 
-const Pipeline::RenderState states[] = { 
-	Pipeline::WIREFRAME, 
-	Pipeline::COLOR, 
-	Pipeline::TEXTURE,
-	Pipeline::COLOR_TEXTURE, 
-	Pipeline::SHADING
-};
-const ShadeFunc shaders[] = {
-	FragmentShader::depth(1.5f, 0),
-	FragmentShader::normal(),
-	FragmentShader::lambert_direction_light(Vector3(.5f, .5f, -1)),
-	FragmentShader::phong_direction_light(Vector3(1, 1, -1), Colors::Black, Colors::White * .3f, Colors::White * .9f, 7.f),
-	FragmentShader::blinn_phong_direction_light(Vector3(1, 1, -1), Colors::Black, Colors::White * .3f, Colors::White * .9f, 7.f),
-	FragmentShader::blinn_phong_direction_light_color_textured(Vector3(1, 1, -1), Colors::White * .1f, Colors::White * .45f, Colors::White * 1.5f, 6.f),
-};
-const int shaderNum = 6;
-const int sceneNum = 4;
+#ifdef _WIN32
+#include "Window.h"
 
 static float aspect;
 static float translateZ = 1.5f;
 static float rotateX = 0, rotateY = 0;
-static shared_ptr<IntBuffer> texture;
-static ShadeFunc currentShader;
-
-shared_ptr<Mesh> createSphere(float radius, int space = 10, const shared_ptr<IntBuffer> & texture = nullptr, const ShadeFunc & shader = nullptr) {
-	const float & dtr = Math::DEGREE_TO_RADIUS;
-	size_t vertexCount = (180 / space) * (360 / space) * 4;
-	shared_ptr<Mesh> m = make_shared<Mesh>();
-	Vertex v;
-	v.color = Colors::White;
-	for (int b = 0; b < 180; b += space) {
-		for (int a = 0; a < 360; a += space) {
-			v.point.x = radius * sin(a * dtr) * sin(b * dtr);
-			v.point.y = radius * cos(a * dtr) * sin(b * dtr);
-			v.point.z = radius * cos(b * dtr);
-			v.texCoord.x = a / 360.f;
-			v.texCoord.y = b / 180.f;
-			v.normal = v.point;
-			m->vertices.push_back(v);
-
-			v.point.x = radius * sin(a * dtr) * sin((b + space) * dtr);
-			v.point.y = radius * cos(a * dtr) * sin((b + space) * dtr);
-			v.point.z = radius * cos((b + space) * dtr);
-			v.texCoord.x = a / 360.f;
-			v.texCoord.y = (b + space) / 180.f;
-			v.normal = v.point;
-			m->vertices.push_back(v);
-
-			v.point.x = radius * sin((a + space) * dtr) * sin(b * dtr);
-			v.point.y = radius * cos((a + space) * dtr) * sin(b * dtr);
-			v.point.z = radius * cos(b * dtr);
-			v.texCoord.x = (a + space) / 360.f;
-			v.texCoord.y = b / 180.f;
-			v.normal = v.point;
-			m->vertices.push_back(v);
-
-			v.point.x = radius * sin((a + space) * dtr) * sin((b + space) * dtr);
-			v.point.y = radius * cos((a + space) * dtr) * sin((b + space) * dtr);
-			v.point.z = radius * cos((b + space) * dtr);
-			v.texCoord.x = (a + space) / 360.f;
-			v.texCoord.y = (b + space) / 180.f;
-			v.normal = v.point;
-			m->vertices.push_back(v);
-		}
-	}
-	
-	for (size_t i = 0; i < vertexCount - 2; i++) {
-		// 保证每个面方向一致
-		m->primitives.push_back(i % 2 ? Primitive{ i, i + 1, i + 2 } : Primitive{ i + 2, i + 1, i });
-	}
-
-	m->texture = texture;
-	m->shadeFunc = shader;
-	return m;
-}
-
-void solarSystem(Scene & scene) {
-	static shared_ptr<Mesh> sun = createSphere(3, 9, nullptr,
-		[](RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const shared_ptr<IntBuffer> & texture, const TexCoord & texCoord) -> bool {
-		out = RGBColor(1, 1, 0);
-		return true;
-	});
-	static shared_ptr<Mesh> earth = createSphere(1, 10);
-	static shared_ptr<Mesh> moon = createSphere(0.5, 15);
-
-	scene.addMesh(sun);
-
-	static float earthRevolution, earthRotation;
-	earthRevolution += 0.1f;
-	earthRotation += 1.f;
-
-	Vector3 lightVec(0, 0, 1);
-	ShadeFunc shader = FragmentShader::blinn_phong_direction_light(lightVec, Colors::White * .1f, Colors::White * .45f, Colors::White * 1.5f, 4.f);
-
-	scene.rotate(0, 1, 0, earthRotation);
-	scene.translate(0, 0, 10);
-	scene.rotate(0, 1, 0, earthRevolution);
-	earth->shadeFunc = shader;
-	scene.addMesh(earth);
+static shared_ptr<Texture> texture;
+static Shader currentShader;
+#endif
 
-	static float moonRevolution;
-	moonRevolution += 0.24f;
-	scene.rotate(0, 1, 0, moonRevolution);
-	scene.translate(0, 0, 3);
-	
-	moon->shadeFunc = shader;
-	scene.addMesh(moon);
-}
-
-void createScene(Scene & scene, int index) {
-	scene.clear();
-	shared_ptr<Mesh> m = make_shared<Mesh>();
-	m->texture = texture;
-	m->shadeFunc = currentShader;
-	switch (index) {
-	case 0:
-		m->vertices = { 
-			{ Vector3(0,1,0), Colors::Green, TexCoord{ 0, 1 } },
-			{ Vector3(1,0,0), Colors::Blue, TexCoord{ 1, 0 } },
-			{ Vector3(0,0,0), Colors::Red, TexCoord{ 0, 0 } },
-		};
-		m->primitives = { Primitive{ 0,1,2, Vector3(0,0,1) } };
-		scene.addMesh(m, Matrix44().translate(-.5f, -.5f, 0));
-		break;
-	case 1:
-		m->vertices = {
-			{ Vector3(-0.5f, -0.5f,  0.5f), Colors::Red,   TexCoord{ 0, 0 } },
-			{ Vector3(0.5f, -0.5f,  0.5f),  Colors::Green, TexCoord{ 1, 0 } },
-			{ Vector3(0.5f,  0.5f,  0.5f),  Colors::Blue,  TexCoord{ 1, 1 } },
-			{ Vector3(-0.5f,  0.5f,  0.5f), Colors::White, TexCoord{ 0, 1 } },
-			{ Vector3(-0.5f, -0.5f, -0.5f), Colors::Blue,  TexCoord{ 1, 0 } },
-			{ Vector3(-0.5f,  0.5f, -0.5f), Colors::Red,   TexCoord{ 1, 1 } },
-			{ Vector3(0.5f,  0.5f, -0.5f),  Colors::Green, TexCoord{ 0, 1 } },
-			{ Vector3(0.5f, -0.5f, -0.5f),  Colors::White, TexCoord{ 0, 0 } }
-		};
-		m->primitives = {
-			Primitive{ 0,1,2, Vector3(0,0,1) }, Primitive{ 0,2,3, Vector3(0,0,1) },
-			Primitive{ 4,5,6, Vector3(0,0,-1) }, Primitive{ 4,6,7, Vector3(0,0,-1) },
-			Primitive{ 5,3,2, Vector3(0,1,0) }, Primitive{ 5,2,6, Vector3(0,1,0) },
-			Primitive{ 4,7,1, Vector3(0,-1,0) }, Primitive{ 4,1,0, Vector3(0,-1,0) },
-			Primitive{ 7,6,2, Vector3(1,0,0) }, Primitive{ 7,2,1, Vector3(1,0,0) },
-			Primitive{ 4,0,3, Vector3(-1,0,0) }, Primitive{ 4,3,5, Vector3(-1,0,0) },
-		};
-		scene.addMesh(m);
-		break;
-	case 2:
-		for (float i = 0; i < 360; i += 5) {
-			scene.addLine(Line{
-			    Vertex { Vector3(0,0,0), Colors::White },
-			    Vertex { Vector3(0.7f * cos(i),0.7f * sin(i),1), Colors::Random() }
-			});
-		}
-		break;
-	case 3:
-		solarSystem(scene);
-		break;
-	}
-}
+int main(int argc, char * argv[]) {
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(argv[i], "--bench")) return Benchmark::run(argc, argv);
 
+#ifndef _WIN32
+	// 非Windows平台只支持无窗口渲染
+	return Headless::run(argc, argv);
+#else
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(argv[i], "--headless")) return Headless::run(argc, argv);
 
-
-int main() {
 	SetPriorityClass(GetCurrentProcess(), BELOW_NORMAL_PRIORITY_CLASS);
 
 	texture = CreateTexture("C:\\Users\\dhb\\Pictures\\pika.jpg");
@@ -177,22 +38,35 @@ int main() {
 	Window window(image.getWidth(), image.getHeight(), _T("SoftRenderer"));
 	aspect = image.aspect();
 
-	bool kbhit[3] = { false };
-	int sceneI = 0, modeI = 0, shaderI = 0;
-	currentShader = shaders[shaderI];
+	bool kbhit[9] = { false };
+	int sceneI = 0, modeI = 0, shaderI = 0, filterI = 0, frame = 0;
+	bool tileMode = false, hiZ = true, rayTracing = false, pathTracing = false;
+	int rasterizer = Pipeline::RASTERIZER_SCANLINE;
+	currentShader = DemoScene::shaders[shaderI];
 
-	createScene(scene, sceneI);
+	DemoScene::createScene(scene, sceneI, texture, currentShader);
+	Pipeline::Fence previous;   // 上一帧
 	
 	while (window.is_run()) {
-		scene.setPerspective(70, aspect, 0.5f, 1000);
-		scene.setViewMatrix(Matrix44().rotate(0, 1, 0, rotateY).rotate(1, 0, 0, rotateX).translate(0, 0, translateZ));
-
-		pipeline.render(scene);
-
-		memcpy(window(), image(), image.getSize() * sizeof(int));
-		window.update();
+		DemoScene::setCamera(scene, aspect, rotateX, rotateY, translateZ);
+
+		// 先提交本帧, 显示上一帧的同时本帧的几何处理在工作线程上进行
+		Pipeline::Fence current = pipeline.renderAsync(scene);
+		if (previous) {
+			const IntBuffer * frameImage = previous.wait();
+			frameImage->copyTo(window());
+			window.update();
+		}
+		previous = current;
 		ostringstream s;
-		s << "SoftRenderer(Space switch scene, Ctrl switch mode, Shift switch shader) Fps:" << window.get_fps();
+		s << "SoftRenderer(Space switch scene, Ctrl switch mode, Shift switch shader, T switch tile binning, R switch rasterizer, Z switch HiZ, F switch texture filter, Y switch ray tracing, P switch path tracing) Fps:" << window.get_fps();
+		if (pathTracing)
+			s << " Samples:" << pipeline.getAccumulatedSamples();
+		if (hiZ) {
+			const Pipeline::HiZStats & stats = pipeline.getHiZStats();
+			s << " HiZ culled triangles:" << stats.trianglesCulled << "/" << stats.trianglesTested
+				<< " blocks:" << stats.blocksCulled << "/" << stats.blocksTested;
+		}
 		window.setTitle(_T(s.str().c_str()));
 		if (window.is_key(VK_ESCAPE)) window.destory();
 		if (window.is_key(VK_LEFT)) rotateY -= 2.5f;
@@ -204,29 +78,76 @@ int main() {
 
 		if (window.is_key(VK_CONTROL)) {
 			if (!kbhit[0]) {
-				modeI = ++modeI % 5;
-				pipeline.setRenderState(Pipeline::RenderState(states[modeI]));
+				modeI = ++modeI % DemoScene::stateNum;
+				pipeline.setRenderState(DemoScene::states[modeI]);
 			}
 			kbhit[0] = true;
 		} else kbhit[0] = false;
 		if (window.is_key(VK_SPACE)) {
 			if (!kbhit[1]) {
-				sceneI = ++sceneI % sceneNum;
-				createScene(scene, sceneI);
+				sceneI = ++sceneI % DemoScene::sceneNum;
+				DemoScene::createScene(scene, sceneI, texture, currentShader);
 			}
 			kbhit[1] = true;
 		} else {
 			kbhit[1] = false;
-			if (sceneI == 3) createScene(scene, 3);
+			if (sceneI == 3) DemoScene::createScene(scene, 3, texture, currentShader, ++frame);
 		}
 		if (window.is_key(VK_SHIFT)) {
 			if (!kbhit[2]) {
-				shaderI = ++shaderI % shaderNum;
-				currentShader = shaders[shaderI];
-				createScene(scene, sceneI);
+				shaderI = ++shaderI % DemoScene::shaderNum;
+				currentShader = DemoScene::shaders[shaderI];
+				DemoScene::createScene(scene, sceneI, texture, currentShader);
 			}
 			kbhit[2] = true;
 		} else kbhit[2] = false;
+		if (window.is_key('T')) {
+			if (!kbhit[3]) {
+				tileMode = !tileMode;
+				pipeline.setParallelMode(tileMode ? Pipeline::PARALLEL_TILE : Pipeline::PARALLEL_PRIMITIVE);
+			}
+			kbhit[3] = true;
+		} else kbhit[3] = false;
+		if (window.is_key('R')) {
+			if (!kbhit[4]) {
+				// 依次切换扫描线/边函数/定点数边函数光栅化
+				rasterizer = (rasterizer + 1) % 3;
+				pipeline.setRasterizer((Pipeline::RasterizerType)rasterizer);
+			}
+			kbhit[4] = true;
+		} else kbhit[4] = false;
+		if (window.is_key('Z')) {
+			if (!kbhit[5]) {
+				hiZ = !hiZ;
+				pipeline.setHiZ(hiZ);
+			}
+			kbhit[5] = true;
+		} else kbhit[5] = false;
+		if (window.is_key('F')) {
+			if (!kbhit[6] && texture) {
+				// 依次切换点采样/双线性/三线性过滤
+				filterI = ++filterI % DemoScene::filterNum;
+				pipeline.finish();
+				texture->setFilter((Texture::Filter)filterI);
+			}
+			kbhit[6] = true;
+		} else kbhit[6] = false;
+		if (window.is_key('Y')) {
+			if (!kbhit[7]) {
+				rayTracing = !rayTracing;
+				pipeline.setRayTracing(rayTracing);
+			}
+			kbhit[7] = true;
+		} else kbhit[7] = false;
+		if (window.is_key('P')) {
+			if (!kbhit[8]) {
+				pathTracing = !pathTracing;
+				pipeline.setPathTracing(pathTracing);
+			}
+			kbhit[8] = true;
+		} else kbhit[8] = false;
 		Sleep(1);
 	}
+	return 0;
+#endif
 }
\ No newline at end of file
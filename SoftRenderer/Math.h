@@ -69,17 +69,33 @@ namespace Math {
 	}
 
 	inline int floor(float x) {
-		return int(x) - (x >= 0 ? 0 : 1);
+		int i = int(x);
+		return x < i ? i - 1 : i;
 	}
 
 	inline int ceil(float x) {
-		return int(x) + (x >= 0 ? 1 : 0);
+		int i = int(x);
+		return x > i ? i + 1 : i;
 	}
 
 	inline int round(float x) {
 		return floor(x + 0.5f);
 	}
 
+	// 不小于x的最小的2的幂, x > 0
+	inline int nextPowerOfTwo(int x) {
+		int p = 1;
+		while (p < x) p <<= 1;
+		return p;
+	}
+
+	// 2的幂x的以2为底的对数
+	inline int log2(int x) {
+		int n = 0;
+		while (x > 1) x >>= 1, n++;
+		return n;
+	}
+
 	inline float fract(float x) {
 		return x - std::floor(x);
 	}
@@ -128,6 +144,15 @@ namespace Math {
 		return x;
 	}
 
+	// 以指数位加尾数的线性近似求log2(x), x > 0, 误差不超过0.09
+	inline float fastLog2(float x) {
+		union {
+			float f;
+			int i;
+		} u = { x };
+		return (u.i - (127 << 23)) * (1.0f / (1 << 23));
+	}
+
 	inline float fastSin(float x) {
 		x = (x - PI / 2) / (2 * PI);
 		x -= floor(x);
@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef _MATHSIMD_H_
+#define _MATHSIMD_H_
+
+#include <emmintrin.h>
+
+// Vector4/Matrix44的SIMD实现的编译开关: 定义SOFTRENDERER_SIMD_MATH为1时两者按16字节对齐,
+// 运算改用下面的SSE2函数; 为0(默认)时使用原来的标量代码.
+// 除求逆外各运算的乘加顺序与标量代码一致,结果逐位相同
+#ifndef SOFTRENDERER_SIMD_MATH
+#define SOFTRENDERER_SIMD_MATH 0
+#endif
+
+#if SOFTRENDERER_SIMD_MATH
+#define MATH_ALIGN alignas(16)
+#else
+#define MATH_ALIGN
+#endif
+
+// 按行存放的4x4矩阵与4维向量的SSE2运算, 所有函数都不要求地址对齐
+namespace MathSIMD {
+	// 把v的w分量替换为1
+	inline __m128 withW1(__m128 v) {
+		const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		return _mm_or_ps(_mm_and_ps(xyz, v), _mm_set_ps(1.f, 0, 0, 0));
+	}
+	// 取v的xyz分量与old的w分量
+	inline __m128 keepW(__m128 v, __m128 old) {
+		const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		return _mm_or_ps(_mm_and_ps(xyz, v), _mm_andnot_ps(xyz, old));
+	}
+	// xyz分量的点积, 按x,y,z的顺序累加
+	inline float dot3(__m128 a, __m128 b) {
+		__m128 m = _mm_mul_ps(a, b);
+		__m128 s = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))));
+	}
+
+	// c = a * b, c可以与a或b相同
+	inline void multiply(const float * a, const float * b, float * c) {
+		__m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+		for (int i = 0; i < 4; i++) {
+			__m128 row = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(a[4 * i]), b0),
+				_mm_mul_ps(_mm_set1_ps(a[4 * i + 1]), b1)),
+				_mm_mul_ps(_mm_set1_ps(a[4 * i + 2]), b2)),
+				_mm_mul_ps(_mm_set1_ps(a[4 * i + 3]), b3));
+			_mm_storeu_ps(c + 4 * i, row);
+		}
+	}
+
+	// 行向量(x, y, z, w)乘以矩阵
+	inline __m128 apply(const float * m, __m128 v) {
+		__m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(x, _mm_loadu_ps(m)),
+			_mm_mul_ps(y, _mm_loadu_ps(m + 4))),
+			_mm_mul_ps(z, _mm_loadu_ps(m + 8))),
+			_mm_mul_ps(w, _mm_loadu_ps(m + 12)));
+	}
+	// 点(x, y, z, 1)乘以矩阵
+	inline __m128 applyPoint(const float * m, float x, float y, float z) {
+		return _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(x), _mm_loadu_ps(m)),
+			_mm_mul_ps(_mm_set1_ps(y), _mm_loadu_ps(m + 4))),
+			_mm_mul_ps(_mm_set1_ps(z), _mm_loadu_ps(m + 8))),
+			_mm_loadu_ps(m + 12));
+	}
+	// 方向(x, y, z, 0)乘以矩阵左上角的3x3部分, 结果的w分量无意义
+	inline __m128 applyDir(const float * m, float x, float y, float z) {
+		return _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(x), _mm_loadu_ps(m)),
+			_mm_mul_ps(_mm_set1_ps(y), _mm_loadu_ps(m + 4))),
+			_mm_mul_ps(_mm_set1_ps(z), _mm_loadu_ps(m + 8)));
+	}
+
+	// c = a的转置, c可以与a相同
+	inline void transpose(const float * a, float * c) {
+		__m128 r0 = _mm_loadu_ps(a), r1 = _mm_loadu_ps(a + 4), r2 = _mm_loadu_ps(a + 8), r3 = _mm_loadu_ps(a + 12);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(c, r0);
+		_mm_storeu_ps(c + 4, r1);
+		_mm_storeu_ps(c + 8, r2);
+		_mm_storeu_ps(c + 12, r3);
+	}
+
+#define MATHSIMD_SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+#define MATHSIMD_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+	// 按行存放的2x2矩阵(a b c d)的乘法 A * B
+	inline __m128 mat2Mul(__m128 a, __m128 b) {
+		return _mm_add_ps(_mm_mul_ps(a, MATHSIMD_SWIZZLE(b, 0, 3, 0, 3)),
+			_mm_mul_ps(MATHSIMD_SWIZZLE(a, 1, 0, 3, 2), MATHSIMD_SWIZZLE(b, 2, 1, 2, 1)));
+	}
+	// adj(A) * B
+	inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+		return _mm_sub_ps(_mm_mul_ps(MATHSIMD_SWIZZLE(a, 3, 3, 0, 0), b),
+			_mm_mul_ps(MATHSIMD_SWIZZLE(a, 1, 1, 2, 2), MATHSIMD_SWIZZLE(b, 2, 3, 0, 1)));
+	}
+	// A * adj(B)
+	inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+		return _mm_sub_ps(_mm_mul_ps(a, MATHSIMD_SWIZZLE(b, 3, 0, 3, 0)),
+			_mm_mul_ps(MATHSIMD_SWIZZLE(a, 1, 0, 3, 2), MATHSIMD_SWIZZLE(b, 2, 1, 2, 1)));
+	}
+
+	// c = a的逆矩阵, 用2x2分块与伴随矩阵求解(结果与 Matrix44::inverseScalar 的高斯消元不逐位相同).
+	// 奇异矩阵返回false且不写入c
+	inline bool inverse(const float * a, float * c) {
+		__m128 r0 = _mm_loadu_ps(a), r1 = _mm_loadu_ps(a + 4), r2 = _mm_loadu_ps(a + 8), r3 = _mm_loadu_ps(a + 12);
+		// 分块 | A B |
+		//      | C D |
+		__m128 A = _mm_movelh_ps(r0, r1);
+		__m128 B = _mm_movehl_ps(r1, r0);
+		__m128 C = _mm_movelh_ps(r2, r3);
+		__m128 D = _mm_movehl_ps(r3, r2);
+
+		// (|A| |B| |C| |D|)
+		__m128 detSub = _mm_sub_ps(
+			_mm_mul_ps(MATHSIMD_SHUFFLE(r0, r2, 0, 2, 0, 2), MATHSIMD_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+			_mm_mul_ps(MATHSIMD_SHUFFLE(r0, r2, 1, 3, 1, 3), MATHSIMD_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+		__m128 detA = MATHSIMD_SWIZZLE(detSub, 0, 0, 0, 0);
+		__m128 detB = MATHSIMD_SWIZZLE(detSub, 1, 1, 1, 1);
+		__m128 detC = MATHSIMD_SWIZZLE(detSub, 2, 2, 2, 2);
+		__m128 detD = MATHSIMD_SWIZZLE(detSub, 3, 3, 3, 3);
+
+		__m128 D_C = mat2AdjMul(D, C);
+		__m128 A_B = mat2AdjMul(A, B);
+		// 逆矩阵各分块的伴随
+		__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, D_C));
+		__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, A_B));
+		__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, A_B));
+		__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, D_C));
+
+		// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+		__m128 tr = _mm_mul_ps(A_B, MATHSIMD_SWIZZLE(D_C, 0, 2, 1, 3));
+		tr = _mm_add_ps(tr, MATHSIMD_SWIZZLE(tr, 2, 3, 0, 1));
+		tr = _mm_add_ps(tr, MATHSIMD_SWIZZLE(tr, 1, 0, 3, 2));
+		__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+		if (_mm_cvtss_f32(detM) == 0)
+			return false;
+
+		__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), detM);
+		X_ = _mm_mul_ps(X_, rDetM);
+		Y_ = _mm_mul_ps(Y_, rDetM);
+		Z_ = _mm_mul_ps(Z_, rDetM);
+		W_ = _mm_mul_ps(W_, rDetM);
+
+		_mm_storeu_ps(c, MATHSIMD_SHUFFLE(X_, Y_, 3, 1, 3, 1));
+		_mm_storeu_ps(c + 4, MATHSIMD_SHUFFLE(X_, Y_, 2, 0, 2, 0));
+		_mm_storeu_ps(c + 8, MATHSIMD_SHUFFLE(Z_, W_, 3, 1, 3, 1));
+		_mm_storeu_ps(c + 12, MATHSIMD_SHUFFLE(Z_, W_, 2, 0, 2, 0));
+		return true;
+	}
+
+#undef MATHSIMD_SWIZZLE
+#undef MATHSIMD_SHUFFLE
+}
+
+#endif
\ No newline at end of file
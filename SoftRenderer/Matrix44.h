@@ -5,7 +5,7 @@
 
 #include "Vector.h"
 
-class Matrix44 {
+class MATH_ALIGN Matrix44 {
 public:
 	float x[4][4] = { { 1,0,0,0 },{ 0,1,0,0 },{ 0,0,1,0 },{ 0,0,0,1 } };
 
@@ -58,6 +58,15 @@ public:
 	// useful nor really necessary (but nice to have -- and it gives you an example of how
 	// it can be done, as this how you will this operation implemented in most libraries).
 	static void multiply(const Matrix44 &a, const Matrix44& b, Matrix44 &c) {
+	#if SOFTRENDERER_SIMD_MATH
+		MathSIMD::multiply(&a.x[0][0], &b.x[0][0], &c.x[0][0]);
+	#else
+		multiplyScalar(a, b, c);
+	#endif
+	}
+
+	// 标量实现(c不能与a或b相同)
+	static void multiplyScalar(const Matrix44 &a, const Matrix44& b, Matrix44 &c) {
 	#if 0
 		for (uint8_t i = 0; i < 4; ++i) {
 			for (uint8_t j = 0; j < 4; ++j) {
@@ -120,6 +129,16 @@ public:
 
 	// return a transposed copy of the current matrix as a new matrix
 	Matrix44 transposed() const {
+	#if SOFTRENDERER_SIMD_MATH
+		Matrix44 t;
+		MathSIMD::transpose(&x[0][0], &t.x[0][0]);
+		return t;
+	#else
+		return transposedScalar();
+	#endif
+	}
+
+	Matrix44 transposedScalar() const {
 	#if 0
 		Matrix44 t;
 		for (uint8_t i = 0; i < 4; ++i) {
@@ -151,6 +170,9 @@ public:
 
 	// transpose itself
 	Matrix44& transpose() {
+	#if SOFTRENDERER_SIMD_MATH
+		MathSIMD::transpose(&x[0][0], &x[0][0]);
+	#else
 		Matrix44 tmp(x[0][0],
 			x[1][0],
 			x[2][0],
@@ -168,7 +190,7 @@ public:
 			x[2][3],
 			x[3][3]);
 		*this = tmp;
-
+	#endif
 		return *this;
 	}
 
@@ -184,13 +206,30 @@ public:
 	// The coordinate w is more often than not equals to 1, but it can be different than
 	// 1 especially when the matrix is projective matrix (perspective projection matrix).
 	void apply(const Vector4 &src, Vector4 &dst) const {
+	#if SOFTRENDERER_SIMD_MATH
+		_mm_store_ps(&dst.x, MathSIMD::apply(&x[0][0], _mm_load_ps(&src.x)));
+	#else
+		applyScalar(src, dst);
+	#endif
+	}
+
+	void apply(const Vector3 &src, Vector4 &dst) const {
+	#if SOFTRENDERER_SIMD_MATH
+		_mm_store_ps(&dst.x, MathSIMD::applyPoint(&x[0][0], src.x, src.y, src.z));
+	#else
+		applyScalar(src, dst);
+	#endif
+	}
+
+	// 标量实现(dst不能与src相同)
+	void applyScalar(const Vector4 &src, Vector4 &dst) const {
 		dst.x = src[0] * x[0][0] + src[1] * x[1][0] + src[2] * x[2][0] + src[3] * x[3][0];
 		dst.y = src[0] * x[0][1] + src[1] * x[1][1] + src[2] * x[2][1] + src[3] * x[3][1];
 		dst.z = src[0] * x[0][2] + src[1] * x[1][2] + src[2] * x[2][2] + src[3] * x[3][2];
 		dst.w = src[0] * x[0][3] + src[1] * x[1][3] + src[2] * x[2][3] + src[3] * x[3][3];
 	}
 
-	void apply(const Vector3 &src, Vector4 &dst) const {
+	void applyScalar(const Vector3 &src, Vector4 &dst) const {
 		dst.x = src[0] * x[0][0] + src[1] * x[1][0] + src[2] * x[2][0] + x[3][0];
 		dst.y = src[0] * x[0][1] + src[1] * x[1][1] + src[2] * x[2][1] + x[3][1];
 		dst.z = src[0] * x[0][2] + src[1] * x[1][2] + src[2] * x[2][2] + x[3][2];
@@ -235,10 +274,14 @@ public:
 	}
 
 	void applyDir(const Vector3 &src, Vector4 &dst) const {
+	#if SOFTRENDERER_SIMD_MATH
+		_mm_store_ps(&dst.x, MathSIMD::withW1(MathSIMD::applyDir(&x[0][0], src.x, src.y, src.z)));
+	#else
 		dst.x = src[0] * x[0][0] + src[1] * x[1][0] + src[2] * x[2][0];
 		dst.y = src[0] * x[0][1] + src[1] * x[1][1] + src[2] * x[2][1];
 		dst.z = src[0] * x[0][2] + src[1] * x[1][2] + src[2] * x[2][2];
 		dst.w = 1.0f;
+	#endif
 	}
 
 	// Compute the inverse of the matrix using the Gauss-Jordan (or reduced row) elimination method.
@@ -248,7 +291,18 @@ public:
 	// which is why we've added this code. For now, you can just use it and rely on it
 	// for doing what it's supposed to do. If you want to learn how this works though, check the lesson
 	// on called Matrix Inverse in the "Mathematics and Physics of Computer Graphics" section.
-	Matrix44 inverse() {
+	Matrix44 inverse() const {
+	#if SOFTRENDERER_SIMD_MATH
+		Matrix44 s;
+		if (!MathSIMD::inverse(&x[0][0], &s.x[0][0]))
+			return Matrix44();
+		return s;
+	#else
+		return inverseScalar();
+	#endif
+	}
+
+	Matrix44 inverseScalar() const {
 		int i, j, k;
 		Matrix44 s;
 		Matrix44 t(*this);
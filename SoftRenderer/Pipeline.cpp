@@ -1,25 +1,89 @@
 #include "Pipeline.h"
 #include <algorithm>
+#include <cfloat>
 
-Pipeline::Pipeline(IntBuffer & renderBuffer) : renderBuffer(renderBuffer),
+Pipeline::Pipeline(IntBuffer & renderBuffer) : renderBuffer(renderBuffer), bufferTiling(0),
+ZBuffer(renderBuffer.getWidth(), renderBuffer.getHeight(), renderBuffer.getOptions()),
 screenWidth((int)renderBuffer.getWidth()), screenHeight((int)renderBuffer.getHeight()),
-renderState(WIREFRAME), clearState(CLEAR_COLOR_DEPTH),
-smoothLine(true),
-ZBuffer(renderBuffer.getWidth(), renderBuffer.getHeight()) {
-	locks = new omp_lock_t[renderBuffer.getHeight()];
-	for (size_t i = 0; i < renderBuffer.getHeight(); i++)
-		omp_init_lock(locks + i);
+tileCountX(((int)renderBuffer.getWidth() + TILE_SIZE - 1) / TILE_SIZE),
+tileCountY(((int)renderBuffer.getHeight() + TILE_SIZE - 1) / TILE_SIZE),
+blockCountX(((int)renderBuffer.getWidth() + BLOCK_SIZE - 1) / BLOCK_SIZE),
+blockCountY(((int)renderBuffer.getHeight() + BLOCK_SIZE - 1) / BLOCK_SIZE),
+guardX(1.0f + 2.0f * GUARD_BAND / renderBuffer.getWidth()),
+guardY(1.0f + 2.0f * GUARD_BAND / renderBuffer.getHeight()),
+fastClear(true), clearValue(0), hiZEnabled(true),
+renderState(WIREFRAME), clearState(CLEAR_COLOR_DEPTH), parallelMode(PARALLEL_PRIMITIVE),
+rasterizer(RASTERIZER_SCANLINE), spanFill(RasterSIMD::select()), vertexTransform(VertexSIMD::select()), packetIntersect(RaySIMD::select()),
+smoothLine(true), rayTracing(false), rayDepth(2), pathTracing(false), pathSamples(1), pathSeed(0), skyColor(Colors::White) {
+	locks.reset(new std::mutex[renderBuffer.getHeight()]);
+	hiZ.reset(new HiZBlock[blockCountX * blockCountY]);
+	hiZClear();
+	hiZStats = HiZStats();
+	jobs.reset(new JobSystem());
+	frameSerial = 0;
+	colorBuffer = &renderBuffer;
+	rasterFrame = &frames[0];
+	tileClear.reset(new std::atomic<unsigned char>[tileCountX * tileCountY]);
+	for (int i = 0; i < tileCountX * tileCountY; i++)
+		tileClear[i] = 0;
 }
 
 Pipeline::~Pipeline() {
-	for (size_t i = 0; i < renderBuffer.getHeight(); i++)
-		omp_destroy_lock(locks + i);
-	delete[] locks;
+	finish();
 }
 
+void Pipeline::setBufferTiling(int tileSize) {
+	finish();
+	assert(tileSize == 0 || (tileSize >= BLOCK_SIZE && tileSize <= TILE_SIZE && !(tileSize & (tileSize - 1))));
+	if (tileSize == bufferTiling) return;
+	bufferTiling = tileSize;
+	BufferOptions options = renderBuffer.getOptions();
+	options.tileSize = tileSize;
+	ZBuffer.reset(options);
+	if (tileSize) {
+		tiledColor.reset(new IntBuffer(screenWidth, screenHeight, options));
+		// 保留渲染缓冲区中的内容(不清除颜色时在其上继续绘制)
+		renderBuffer.copyTo(*tiledColor, 0, 0, screenWidth, screenHeight);
+	} else {
+		tiledColor.reset();
+	}
+	colorBuffer = tiledColor ? tiledColor.get() : &renderBuffer;
+	// 重新分配的深度缓冲区没有内容, 清除后与层次Z一致
+	ZBuffer.fill(0.f);
+	hiZClear();
+	for (int i = 0; i < tileCountX * tileCountY; i++)
+		tileClear[i] = 0;
+}
+
+inline void Pipeline::lockScanline(int y) {
+	// 不统计也不追踪时直接加锁
+	if (!Stats::enabled && !Trace::isActive()) {
+		locks[y].lock();
+		return;
+	}
+	if (locks[y].try_lock()) return;
+	// 锁被其他线程占用,记录等待
+	STATS_ONLY(Stats::ThreadStats & ts = threadStats());
+	STATS_SCOPE(ts, Stats::STAGE_LOCK);
+	STATS_ADD(ts, Stats::LOCK_WAITS, 1);
+	TRACE_SCOPE("lock wait", "y", y);
+	locks[y].lock();
+}
+
+#if SOFTRENDERER_STATS
+// 统计一段扫描线中能通过深度测试的片元数(只在开启统计时使用,不修改缓冲区)
+static int countDepthPassed(const float * zbPtr, int count, float rhw, float step) {
+	int passed = 0;
+	for (int i = 0; i < count; i++, rhw += step)
+		if (rhw >= zbPtr[i]) passed++;
+	return passed;
+}
+#endif
+
 inline void Pipeline::drawPixel(int x, int y, const RGBColor & color) {
 	assert(x >= 0 && x < screenWidth && y >= 0 && y < screenHeight);
-	renderBuffer.set(x, y, color.toRGBInt());
+	touchPixel(x, y);
+	colorBuffer->set(x, y, color.toRGBInt());
 }
 
 void Pipeline::rasterizeLine(float _x0, float _y0, float _x1, float _y1, RGBColor c0, RGBColor c1) {
@@ -132,9 +196,9 @@ void Pipeline::rasterizeLine_antialiasing(float x0, float y0, float x1, float y1
 			size_t coordX = (size_t)x;
 			size_t coordY = (size_t)intery;
 
-			colorSrc = renderBuffer.get(coordY, coordX);
+			colorSrc = readPixel(coordY, coordX);
 			drawPixel(coordY,     coordX, Math::lerp(colorSrc, colorDst, 1.0f - fpart));
-			colorSrc = renderBuffer.get(coordY + 1, coordX);
+			colorSrc = readPixel(coordY + 1, coordX);
 			drawPixel(coordY + 1, coordX, Math::lerp(colorSrc, colorDst, fpart));
 
 			intery += gradient;
@@ -146,9 +210,9 @@ void Pipeline::rasterizeLine_antialiasing(float x0, float y0, float x1, float y1
 			size_t coordX = (size_t)x;
 			size_t coordY = (size_t)intery;
 
-			colorSrc = renderBuffer.get(coordX, coordY);
+			colorSrc = readPixel(coordX, coordY);
 			drawPixel(coordX, coordY,     Math::lerp(colorSrc, colorDst, 1.0f - fpart));
-			colorSrc = renderBuffer.get(coordX, coordY + 1);
+			colorSrc = readPixel(coordX, coordY + 1);
 			drawPixel(coordX, coordY + 1, Math::lerp(colorSrc, colorDst, fpart));
 
 			intery += gradient;
@@ -158,80 +222,545 @@ void Pipeline::rasterizeLine_antialiasing(float x0, float y0, float x1, float y1
 	
 }
 
-void Pipeline::rasterizeScanline(Scanline & scanline) {
-	int * fbPtr = renderBuffer(0, scanline.y);
-	float * zbPtr = ZBuffer(0, scanline.y);
-	int x0 = MAX(scanline.x0, 0), x1 = MIN(scanline.x1, screenWidth - 1);
+void Pipeline::rasterizeScanline(Scanline & scanline, const Mesh & mesh, bool lock) {
+	int x0 = scanline.x0, x1 = scanline.x1;
 	TVertex vi = scanline.v0, v;
 	RGBColor c;
-	int rs = currentTexture ? renderState : renderState & (~TEXTURE);
-	rs = currentShadeFunc ? rs : rs & (~SHADING);
-	float invW = 1.f / screenWidth, invH = 1.f / screenHeight;
-	Vector3 pos;
-	omp_set_lock(locks + scanline.y);
-	for (int x = x0; x <= x1; x++) {
-		float rhw = vi.rhw;
-		if (rhw >= zbPtr[x]) {  // 使用Z-buffer判断深度是否满足
-			v = vi * (1.0f / rhw);
-			if (rs & SHADING) {
-				pos = vi.point, pos.x *= invW, pos.y *= invH;
-				if (currentShadeFunc(c, pos, v.color, v.normal.NormalizedVector(), currentTexture, v.texCoord)) {
-					fbPtr[x] = c.toRGBInt();
-					zbPtr[x] = rhw;
-				}
-			} else {
-				if (rs & TEXTURE) {
-					c.setRGBInt(currentTexture->get(v.texCoord));
-					if (rs & COLOR) c *= v.color;
-				} else if (rs & COLOR) {
-					c = v.color;
+	int rs = mesh.texture ? renderState : renderState & (~TEXTURE);
+	rs = mesh.shader ? rs : rs & (~SHADING);
+	// 点采样且布局无损时直接读取按行存放的原图, 否则经过纹理的采样器
+	const bool direct = !mesh.texture || mesh.texture->readsSource();
+	const bool mipmap = mesh.texture && mesh.texture->getFilter() != Texture::POINT;
+	if (lock) lockScanline(scanline.y);
+	touchSpan(scanline.y, x0, x1);
+	STATS_ONLY(Stats::ThreadStats & ts = threadStats());
+	STATS_ADD(ts, Stats::SCANLINES, 1);
+	STATS_ADD(ts, Stats::FRAGMENTS_TESTED, x1 - x0 + 1);
+	// 缓冲区为分块布局时扫描线按分块切成在内存中连续的若干段, 线性布局时只有一段
+	for (int sx = x0; sx <= x1; ) {
+		int count = MIN(x1 - sx + 1, (int)colorBuffer->rowRun(sx));
+		int * fbPtr = (*colorBuffer)(sx, scanline.y);
+		float * zbPtr = ZBuffer(sx, scanline.y);
+		STATS_ONLY(int passed = countDepthPassed(zbPtr, count, vi.rhw, scanline.step.rhw));
+		STATS_ADD(ts, Stats::FRAGMENTS_PASSED, passed);
+		if (rs & SHADING) {
+			// 着色器模式整段交给着色程序
+			ShadeSpan span;
+			span.fbPtr = fbPtr;
+			span.zbPtr = zbPtr;
+			span.count = count;
+			span.v0 = vi;
+			span.step = scanline.step;
+			span.stepY = scanline.stepY;
+			span.invW = 1.f / screenWidth;
+			span.invH = 1.f / screenHeight;
+			span.texture = mesh.texture.get();
+			STATS_SCOPE(ts, Stats::STAGE_SHADING);
+			STATS_ADD(ts, Stats::SHADER_INVOCATIONS, passed);
+			mesh.shader.shadeSpan(span);
+			// 与着色程序相同地逐像素累加, 使下一段的插值与不切分时一致
+			if (sx + count <= x1)
+				for (int i = 0; i < count; i++) vi += scanline.step;
+		} else if (spanFill && (rs & (COLOR | TEXTURE)) && (direct || !(rs & TEXTURE))) {
+			// 颜色/纹理模式使用SIMD批量填充(只支持直接读取原图)
+			SpanFill span;
+			span.fbPtr = fbPtr;
+			span.zbPtr = zbPtr;
+			span.count = count;
+			span.v0 = &scanline.v0;
+			span.first = sx - x0;
+			span.step = &scanline.step;
+			span.texels = (rs & TEXTURE) ? (*mesh.texture)() : nullptr;
+			span.texWidth = (rs & TEXTURE) ? (int)mesh.texture->getWidth() : 0;
+			span.texHeight = (rs & TEXTURE) ? (int)mesh.texture->getHeight() : 0;
+			span.color = (rs & COLOR) != 0;
+			spanFill(span);
+		} else {
+			for (int i = 0; i < count; i++) {
+				float rhw = vi.rhw;
+				if (rhw >= zbPtr[i]) {  // 使用Z-buffer判断深度是否满足
+					float w = 1.0f / rhw;
+					v = vi * w;
+					if (rs & TEXTURE) {
+						if (direct)
+							c.setRGBInt(mesh.texture->get(v.texCoord));
+						else
+							c.setRGBInt(mesh.texture->sample(v.texCoord, mipmap ? textureLod(*mesh.texture, v.texCoord, w, scanline.step, scanline.stepY) : 0));
+						if (rs & COLOR) c *= v.color;
+					} else if (rs & COLOR) {
+						c = v.color;
+					}
+					fbPtr[i] = c.toRGBInt();
+					zbPtr[i] = rhw;
 				}
-				fbPtr[x] = c.toRGBInt();
-				zbPtr[x] = rhw;
+				vi += scanline.step;
 			}
 		}
-		vi += scanline.step;
+		sx += count;
 	}
-	omp_unset_lock(locks + scanline.y);
+	if (lock) locks[scanline.y].unlock();
 }
 
-void Pipeline::rasterizeTriangle(const SplitedTriangle & st) {
+void Pipeline::rasterizeTriangle(const SplitedTriangle & st, const Mesh & mesh, const RasterRect & rect, bool lock) {
 	if (st.type & SplitedTriangle::FLAT_TOP) {
-		int y0 = (int)st.bottom.point.y + 1;
-		int y1 = (int)st.left.point.y;
+		int y0 = MAX(Math::floor(st.bottom.point.y) + 1, rect.y0);
+		int y1 = MIN(Math::floor(st.left.point.y), rect.y1);
 		float yl = st.left.point.y - st.bottom.point.y;
+		// 平行于x轴的边给出x方向的步进, 再由另一个顶点求y方向的步进
+		TVertex stepX = (st.right - st.left) * (1.0f / (st.right.point.x - st.left.point.x));
+		TVertex stepY = (st.left - st.bottom - stepX * (st.left.point.x - st.bottom.point.x)) * (1.0f / yl);
 
 		for (int y = y0; y <= y1; y++) {
 			float factor = (y - st.bottom.point.y) / yl;
 			TVertex left = Math::lerp(st.bottom, st.left, factor);
 			TVertex right = Math::lerp(st.bottom, st.right, factor);
 			Scanline scanline;
-			scanline.x0 = (int)left.point.x;
-			scanline.x1 = (int)right.point.x;
+			scanline.x0 = Math::floor(left.point.x);
+			scanline.x1 = Math::floor(right.point.x);
 			scanline.y = y;
 			scanline.v0 = left;
 			scanline.step = (right - left) * (1.0f / (right.point.x - left.point.x));
-			rasterizeScanline(scanline);
+			scanline.stepY = stepY;
+			clipScanline(scanline, rect);
+			if (scanline.x0 <= scanline.x1) rasterizeScanline(scanline, mesh, lock);
 		}
 	}
 	if (st.type & SplitedTriangle::FLAT_BOTTOM) {
-		int y0 = (int)st.left.point.y + 1;
-		int y1 = (int)st.top.point.y;
+		int y0 = MAX(Math::floor(st.left.point.y) + 1, rect.y0);
+		int y1 = MIN(Math::floor(st.top.point.y), rect.y1);
 		float yl = st.top.point.y - st.left.point.y;
+		TVertex stepX = (st.right - st.left) * (1.0f / (st.right.point.x - st.left.point.x));
+		TVertex stepY = (st.top - st.left - stepX * (st.top.point.x - st.left.point.x)) * (1.0f / yl);
 
 		for (int y = y0; y <= y1; y++) {
 			float factor = (y - st.left.point.y) / yl;
 			TVertex left = Math::lerp(st.left, st.top, factor);
 			TVertex right = Math::lerp(st.right, st.top, factor);
 			Scanline scanline;
-			scanline.x0 = (int)left.point.x;
-			scanline.x1 = (int)right.point.x;
+			scanline.x0 = Math::floor(left.point.x);
+			scanline.x1 = Math::floor(right.point.x);
 			scanline.y = y;
 			scanline.v0 = left;
 			scanline.step = (right - left) * (1.0f / (right.point.x - left.point.x));
-			rasterizeScanline(scanline);
+			scanline.stepY = stepY;
+			clipScanline(scanline, rect);
+			if (scanline.x0 <= scanline.x1) rasterizeScanline(scanline, mesh, lock);
+		}
+	}
+}
+
+void Pipeline::clipScanline(Scanline & scanline, const RasterRect & rect) {
+	if (scanline.x0 < rect.x0) {
+		scanline.v0 += scanline.step * (float)(rect.x0 - scanline.x0);
+		scanline.x0 = rect.x0;
+	}
+	scanline.x1 = MIN(scanline.x1, rect.x1);
+}
+
+void Pipeline::rasterizeTriangleHalfSpace(const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh, const RasterRect & rect, bool lock) {
+	float area = (v1->point.x - v0->point.x) * (v2->point.y - v0->point.y) -
+		(v2->point.x - v0->point.x) * (v1->point.y - v0->point.y);
+	if (Math::isZero(area))
+		return;
+	// 统一顶点绕序,使三角形内部的边函数值为正
+	if (area < 0) {
+		swap(v1, v2);
+		area = -area;
+	}
+	const Vector3 & p0 = v0->point, & p1 = v1->point, & p2 = v2->point;
+
+	// 边函数 E(x, y) = a * x + b * y + c
+	const Vector3 * ep[4] = { &p0, &p1, &p2, &p0 };
+	float ea[3], eb[3], ec[3];
+	for (int i = 0; i < 3; i++) {
+		ea[i] = ep[i]->y - ep[i + 1]->y;
+		eb[i] = ep[i + 1]->x - ep[i]->x;
+		ec[i] = ep[i]->x * ep[i + 1]->y - ep[i]->y * ep[i + 1]->x;
+	}
+
+	// 属性的平面方程: v(x, y) = origin + ddx * x + ddy * y
+	float invArea = 1.0f / area;
+	TVertex e1 = *v1 - *v0, e2 = *v2 - *v0;
+	TVertex ddx = (e1 * (p2.y - p0.y) - e2 * (p1.y - p0.y)) * invArea;
+	TVertex ddy = (e2 * (p1.x - p0.x) - e1 * (p2.x - p0.x)) * invArea;
+	TVertex origin = *v0 - ddx * p0.x - ddy * p0.y;
+
+	// 包围盒(与裁剪矩形求交)
+	int minX = MAX(Math::floor(MIN(MIN(p0.x, p1.x), p2.x)), rect.x0);
+	int maxX = MIN(Math::floor(MAX(MAX(p0.x, p1.x), p2.x)), rect.x1);
+	int minY = MAX(Math::floor(MIN(MIN(p0.y, p1.y), p2.y)), rect.y0);
+	int maxY = MIN(Math::floor(MAX(MAX(p0.y, p1.y), p2.y)), rect.y1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	float triMaxRhw = MAX(MAX(v0->rhw, v1->rhw), v2->rhw);
+	long long blocksTested = 0, blocksCulled = 0;
+
+	Scanline scanline;
+	scanline.step = ddx;
+	scanline.stepY = ddy;
+	for (int by = minY - minY % BLOCK_SIZE; by <= maxY; by += BLOCK_SIZE) {
+		int y0 = MAX(by, minY), y1 = MIN(by + BLOCK_SIZE - 1, maxY);
+		for (int bx = minX - minX % BLOCK_SIZE; bx <= maxX; bx += BLOCK_SIZE) {
+			int x0 = MAX(bx, minX), x1 = MIN(bx + BLOCK_SIZE - 1, maxX);
+			// 在块的四个角(像素中心)上求边函数的最小/最大值
+			float cx0 = x0 + 0.5f, cx1 = x1 + 0.5f;
+			float cy0 = y0 + 0.5f, cy1 = y1 + 0.5f;
+			bool reject = false, accept = true;
+			for (int i = 0; i < 3; i++) {
+				float eMax = ea[i] * (ea[i] > 0 ? cx1 : cx0) + eb[i] * (eb[i] > 0 ? cy1 : cy0) + ec[i];
+				float eMin = ea[i] * (ea[i] > 0 ? cx0 : cx1) + eb[i] * (eb[i] > 0 ? cy0 : cy1) + ec[i];
+				if (eMax < 0) reject = true;
+				if (eMin < 0) accept = false;
+			}
+			if (reject)
+				continue;
+
+			// 块内片元的rhw上界: 平面方程在四个角上的最大值(不超过三个顶点的最大值)
+			int block = (by / BLOCK_SIZE) * blockCountX + bx / BLOCK_SIZE;
+			float blockMaxRhw = 0.f;
+			if (hiZEnabled) {
+				float r00 = origin.rhw + ddx.rhw * cx0 + ddy.rhw * cy0;
+				float rx = ddx.rhw * (cx1 - cx0), ry = ddy.rhw * (cy1 - cy0);
+				blockMaxRhw = MIN(r00 + MAX(rx, 0.f) + MAX(ry, 0.f), triMaxRhw);
+				blocksTested++;
+				if (hiZOccluded(block, blockMaxRhw, lock)) {
+					blocksCulled++;
+					continue;
+				}
+			}
+
+			TVertex vRow = origin + ddx * cx0 + ddy * cy0;
+			for (int y = y0; y <= y1; y++, vRow += ddy) {
+				scanline.y = y;
+				if (accept) {
+					// 整块都在三角形内,无需逐像素测试
+					scanline.x0 = x0;
+					scanline.x1 = x1;
+					scanline.v0 = vRow;
+				} else {
+					// 三角形是凸的,每行内被覆盖的像素是连续的一段
+					float cy = y + 0.5f;
+					float e[3];
+					for (int i = 0; i < 3; i++)
+						e[i] = ea[i] * cx0 + eb[i] * cy + ec[i];
+					scanline.x0 = x1 + 1;
+					scanline.x1 = x0 - 1;
+					for (int x = x0; x <= x1; x++) {
+						if (e[0] >= 0 && e[1] >= 0 && e[2] >= 0) {
+							if (scanline.x0 > x1) scanline.x0 = x;
+							scanline.x1 = x;
+						} else if (scanline.x0 <= x1) {
+							break;
+						}
+						e[0] += ea[0], e[1] += ea[1], e[2] += ea[2];
+					}
+					if (scanline.x0 > scanline.x1)
+						continue;
+					scanline.v0 = vRow + ddx * (float)(scanline.x0 - x0);
+				}
+				rasterizeScanline(scanline, mesh, lock);
+			}
+			if (hiZEnabled)
+				hiZMarkWritten(block, blockMaxRhw);
+		}
+	}
+
+	if (blocksTested) {
+		hiZCounters.blocksTested += blocksTested;
+		hiZCounters.blocksCulled += blocksCulled;
+	}
+}
+
+void Pipeline::rasterizeTriangleFixed(const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh, const RasterRect & rect, bool lock) {
+	const int one = 1 << SUBPIXEL_BITS;
+	// 顶点吸附到子像素网格, 之后的覆盖判断都是精确的整数运算
+	// (保护带保证坐标不超过int范围, 边函数的乘积用64位整数)
+	int X[3], Y[3];
+	const TVertex * v[3] = { v0, v1, v2 };
+	for (int i = 0; i < 3; i++) {
+		X[i] = Math::round(v[i]->point.x * one);
+		Y[i] = Math::round(v[i]->point.y * one);
+	}
+	long long area = (long long)(X[1] - X[0]) * (Y[2] - Y[0]) - (long long)(X[2] - X[0]) * (Y[1] - Y[0]);
+	if (area == 0)
+		return;
+	// 统一顶点绕序,使三角形内部的边函数值为正
+	if (area < 0) {
+		swap(v1, v2);
+		swap(X[1], X[2]);
+		swap(Y[1], Y[2]);
+		area = -area;
+	}
+
+	// 边函数 E(x, y) = a * x + b * y + c (x, y为子像素坐标)
+	// 左上规则: 像素中心恰好落在边上时只属于左边或上边, 其余的边加-1的偏置使E = 0的像素不被覆盖
+	long long ea[3], eb[3], ec[3];
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		ea[i] = Y[i] - Y[j];
+		eb[i] = X[j] - X[i];
+		ec[i] = (long long)X[i] * Y[j] - (long long)Y[i] * X[j];
+		bool topLeft = ea[i] > 0 || (ea[i] == 0 && eb[i] > 0);
+		if (!topLeft) ec[i] -= 1;
+	}
+
+	// 属性的平面方程: v(x, y) = origin + ddx * x + ddy * y, 使用吸附后的顶点坐标
+	const float scale = 1.0f / one;
+	float ox = X[0] * scale, oy = Y[0] * scale;
+	float dx1 = (X[1] - X[0]) * scale, dy1 = (Y[1] - Y[0]) * scale;
+	float dx2 = (X[2] - X[0]) * scale, dy2 = (Y[2] - Y[0]) * scale;
+	float invArea = (float)((double)one * one / area);
+	TVertex e1 = *v1 - *v0, e2 = *v2 - *v0;
+	TVertex ddx = (e1 * dy2 - e2 * dy1) * invArea;
+	TVertex ddy = (e2 * dx1 - e1 * dx2) * invArea;
+	TVertex origin = *v0 - ddx * ox - ddy * oy;
+
+	// 包围盒(与裁剪矩形求交)
+	int minX = MAX(MIN(MIN(X[0], X[1]), X[2]) >> SUBPIXEL_BITS, rect.x0);
+	int maxX = MIN(MAX(MAX(X[0], X[1]), X[2]) >> SUBPIXEL_BITS, rect.x1);
+	int minY = MAX(MIN(MIN(Y[0], Y[1]), Y[2]) >> SUBPIXEL_BITS, rect.y0);
+	int maxY = MIN(MAX(MAX(Y[0], Y[1]), Y[2]) >> SUBPIXEL_BITS, rect.y1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	float triMaxRhw = MAX(MAX(v0->rhw, v1->rhw), v2->rhw);
+	long long blocksTested = 0, blocksCulled = 0;
+
+	Scanline scanline;
+	scanline.step = ddx;
+	scanline.stepY = ddy;
+	for (int by = minY - minY % BLOCK_SIZE; by <= maxY; by += BLOCK_SIZE) {
+		int y0 = MAX(by, minY), y1 = MIN(by + BLOCK_SIZE - 1, maxY);
+		for (int bx = minX - minX % BLOCK_SIZE; bx <= maxX; bx += BLOCK_SIZE) {
+			int x0 = MAX(bx, minX), x1 = MIN(bx + BLOCK_SIZE - 1, maxX);
+			// 在块的四个角(像素中心)上求边函数的最小/最大值
+			long long cx0 = (long long)x0 * one + one / 2, cx1 = (long long)x1 * one + one / 2;
+			long long cy0 = (long long)y0 * one + one / 2, cy1 = (long long)y1 * one + one / 2;
+			bool reject = false, accept = true;
+			for (int i = 0; i < 3; i++) {
+				long long eMax = ea[i] * (ea[i] > 0 ? cx1 : cx0) + eb[i] * (eb[i] > 0 ? cy1 : cy0) + ec[i];
+				long long eMin = ea[i] * (ea[i] > 0 ? cx0 : cx1) + eb[i] * (eb[i] > 0 ? cy0 : cy1) + ec[i];
+				if (eMax < 0) reject = true;
+				if (eMin < 0) accept = false;
+			}
+			if (reject)
+				continue;
+
+			int block = (by / BLOCK_SIZE) * blockCountX + bx / BLOCK_SIZE;
+			float fx0 = x0 + 0.5f, fx1 = x1 + 0.5f;
+			float fy0 = y0 + 0.5f, fy1 = y1 + 0.5f;
+			float blockMaxRhw = 0.f;
+			if (hiZEnabled) {
+				float r00 = origin.rhw + ddx.rhw * fx0 + ddy.rhw * fy0;
+				float rx = ddx.rhw * (fx1 - fx0), ry = ddy.rhw * (fy1 - fy0);
+				blockMaxRhw = MIN(r00 + MAX(rx, 0.f) + MAX(ry, 0.f), triMaxRhw);
+				blocksTested++;
+				if (hiZOccluded(block, blockMaxRhw, lock)) {
+					blocksCulled++;
+					continue;
+				}
+			}
+
+			TVertex vRow = origin + ddx * fx0 + ddy * fy0;
+			for (int y = y0; y <= y1; y++, vRow += ddy) {
+				scanline.y = y;
+				if (accept) {
+					scanline.x0 = x0;
+					scanline.x1 = x1;
+					scanline.v0 = vRow;
+				} else {
+					long long cy = (long long)y * one + one / 2;
+					long long e[3];
+					for (int i = 0; i < 3; i++)
+						e[i] = ea[i] * cx0 + eb[i] * cy + ec[i];
+					scanline.x0 = x1 + 1;
+					scanline.x1 = x0 - 1;
+					for (int x = x0; x <= x1; x++) {
+						if ((e[0] | e[1] | e[2]) >= 0) {
+							if (scanline.x0 > x1) scanline.x0 = x;
+							scanline.x1 = x;
+						} else if (scanline.x0 <= x1) {
+							break;
+						}
+						e[0] += ea[0] * one, e[1] += ea[1] * one, e[2] += ea[2] * one;
+					}
+					if (scanline.x0 > scanline.x1)
+						continue;
+					scanline.v0 = vRow + ddx * (float)(scanline.x0 - x0);
+				}
+				rasterizeScanline(scanline, mesh, lock);
+			}
+			if (hiZEnabled)
+				hiZMarkWritten(block, blockMaxRhw);
+		}
+	}
+
+	if (blocksTested) {
+		hiZCounters.blocksTested += blocksTested;
+		hiZCounters.blocksCulled += blocksCulled;
+	}
+}
+
+void Pipeline::drawTriangle(const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh, const RasterRect & rect, bool lock, HiZStats & hiZCounts) {
+	if (hiZEnabled) {
+		hiZCounts.trianglesTested++;
+		if (hiZTriangleOccluded(v0, v1, v2, rect, lock)) {
+			hiZCounts.trianglesCulled++;
+			return;
+		}
+	}
+	if (rasterizer == RASTERIZER_HALFSPACE) {
+		// 逐块测试与更新层次Z
+		rasterizeTriangleHalfSpace(v0, v1, v2, mesh, rect, lock);
+	} else if (rasterizer == RASTERIZER_FIXED) {
+		rasterizeTriangleFixed(v0, v1, v2, mesh, rect, lock);
+	} else {
+		SplitedTriangle st;
+		{
+			STATS_SCOPE(threadStats(), Stats::STAGE_SETUP);
+			triangleSpilt(st, v0, v1, v2);
+		}
+		rasterizeTriangle(st, mesh, rect, lock);
+		if (hiZEnabled)
+			hiZMarkTriangle(v0, v1, v2, rect);
+	}
+}
+
+void Pipeline::hiZClear() {
+	for (int i = 0; i < blockCountX * blockCountY; i++) {
+		hiZ[i].minRhw.store(0.f, std::memory_order_relaxed);
+		hiZ[i].maxRhw.store(0.f, std::memory_order_relaxed);
+		hiZ[i].dirty.store(false, std::memory_order_relaxed);
+	}
+}
+
+void Pipeline::hiZRefresh(int block, bool lock) {
+	int x0 = block % blockCountX * BLOCK_SIZE, y0 = block / blockCountX * BLOCK_SIZE;
+	int x1 = MIN(x0 + BLOCK_SIZE, screenWidth), y1 = MIN(y0 + BLOCK_SIZE, screenHeight);
+	HiZBlock & b = hiZ[block];
+	// 先清除标记,刷新期间其他线程的写入会重新标记
+	b.dirty.store(false, std::memory_order_relaxed);
+	touchTile(y0 / TILE_SIZE * tileCountX + x0 / TILE_SIZE, TILE_CLEAR_DEPTH);
+	float minRhw = FLT_MAX, maxRhw = 0.f;
+	// 分块布局的分块不小于层次Z的块, 块内每行在内存中连续
+	// 按图元并行时其他线程可能正在写同一行, 与光栅化一样持有扫描线锁读取
+	for (int y = y0; y < y1; y++) {
+		if (lock) lockScanline(y);
+		const float * zbPtr = ZBuffer(x0, y);
+		for (int i = 0; i < x1 - x0; i++) {
+			minRhw = MIN(minRhw, zbPtr[i]);
+			maxRhw = MAX(maxRhw, zbPtr[i]);
+		}
+		if (lock) locks[y].unlock();
+	}
+	// ZBuffer中的值在一帧内只增不减,所以即使与其他线程的写入交错,
+	// 读到的最小值也不会超过块内当前的真实最小值,剔除依然是保守的
+	b.minRhw.store(minRhw, std::memory_order_relaxed);
+	b.maxRhw.store(maxRhw, std::memory_order_relaxed);
+}
+
+bool Pipeline::hiZOccluded(int block, float maxRhw, bool lock) {
+	const HiZBlock & b = hiZ[block];
+	if (maxRhw < b.minRhw.load(std::memory_order_relaxed))
+		return true;
+	// 片元比块内最近的像素还近时不可能被整块遮挡,无需刷新
+	if (b.dirty.load(std::memory_order_relaxed) && maxRhw < b.maxRhw.load(std::memory_order_relaxed)) {
+		hiZRefresh(block, lock);
+		return maxRhw < b.minRhw.load(std::memory_order_relaxed);
+	}
+	return false;
+}
+
+void Pipeline::hiZMarkWritten(int block, float maxRhw) {
+	HiZBlock & b = hiZ[block];
+	b.dirty.store(true, std::memory_order_relaxed);
+	float old = b.maxRhw.load(std::memory_order_relaxed);
+	while (maxRhw > old && !b.maxRhw.compare_exchange_weak(old, maxRhw, std::memory_order_relaxed))
+		;
+}
+
+bool Pipeline::hiZTriangleOccluded(const TVertex * v0, const TVertex * v1, const TVertex * v2, const RasterRect & rect, bool lock) {
+	// rhw在屏幕空间线性变化,三角形内的最大值在顶点上取得
+	float maxRhw = MAX(MAX(v0->rhw, v1->rhw), v2->rhw);
+	int x0 = MAX(Math::floor(MIN(MIN(v0->point.x, v1->point.x), v2->point.x)), rect.x0);
+	int x1 = MIN(Math::floor(MAX(MAX(v0->point.x, v1->point.x), v2->point.x)), rect.x1);
+	int y0 = MAX(Math::floor(MIN(MIN(v0->point.y, v1->point.y), v2->point.y)), rect.y0);
+	int y1 = MIN(Math::floor(MAX(MAX(v0->point.y, v1->point.y), v2->point.y)), rect.y1);
+	if (x0 > x1 || y0 > y1)
+		return true;
+	x0 /= BLOCK_SIZE, x1 /= BLOCK_SIZE, y0 /= BLOCK_SIZE, y1 /= BLOCK_SIZE;
+
+	bool occluded = true;
+	for (int by = y0; by <= y1 && occluded; by++)
+		for (int bx = x0; bx <= x1 && occluded; bx++)
+			occluded = hiZOccluded(by * blockCountX + bx, maxRhw, lock);
+	return occluded;
+}
+
+void Pipeline::hiZMarkTriangle(const TVertex * v0, const TVertex * v1, const TVertex * v2, const RasterRect & rect) {
+	float maxRhw = MAX(MAX(v0->rhw, v1->rhw), v2->rhw);
+	int x0 = MAX(Math::floor(MIN(MIN(v0->point.x, v1->point.x), v2->point.x)), rect.x0);
+	int x1 = MIN(Math::floor(MAX(MAX(v0->point.x, v1->point.x), v2->point.x)), rect.x1);
+	int y0 = MAX(Math::floor(MIN(MIN(v0->point.y, v1->point.y), v2->point.y)), rect.y0);
+	int y1 = MIN(Math::floor(MAX(MAX(v0->point.y, v1->point.y), v2->point.y)), rect.y1);
+	if (x0 > x1 || y0 > y1)
+		return;
+	x0 /= BLOCK_SIZE, x1 /= BLOCK_SIZE, y0 /= BLOCK_SIZE, y1 /= BLOCK_SIZE;
+	for (int by = y0; by <= y1; by++)
+		for (int bx = x0; bx <= x1; bx++)
+			hiZMarkWritten(by * blockCountX + bx, maxRhw);
+}
+
+void Pipeline::hiZAddCounts(const HiZStats & counts) {
+	if (counts.trianglesTested) {
+		hiZCounters.trianglesTested += counts.trianglesTested;
+		hiZCounters.trianglesCulled += counts.trianglesCulled;
+	}
+}
+
+void Pipeline::binTriangle(Frame & frame, const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh) {
+	float minX = MIN(MIN(v0->point.x, v1->point.x), v2->point.x);
+	float maxX = MAX(MAX(v0->point.x, v1->point.x), v2->point.x);
+	float minY = MIN(MIN(v0->point.y, v1->point.y), v2->point.y);
+	float maxY = MAX(MAX(v0->point.y, v1->point.y), v2->point.y);
+
+	int tx0 = Math::clamp(Math::floor(minX), 0, screenWidth - 1) / TILE_SIZE;
+	int tx1 = Math::clamp(Math::floor(maxX), 0, screenWidth - 1) / TILE_SIZE;
+	int ty0 = Math::clamp(Math::floor(minY), 0, screenHeight - 1) / TILE_SIZE;
+	int ty1 = Math::clamp(Math::floor(maxY), 0, screenHeight - 1) / TILE_SIZE;
+
+	int thread = JobSystem::threadIndex();
+	vector<BinnedTriangle> & triangles = frame.binnedTriangles[thread];
+	vector<vector<int>> & bins = frame.tileBins[thread];
+	int index = (int)triangles.size();
+	triangles.push_back(BinnedTriangle{ { *v0, *v1, *v2 }, &mesh });
+	for (int ty = ty0; ty <= ty1; ty++)
+		for (int tx = tx0; tx <= tx1; tx++)
+			bins[ty * tileCountX + tx].push_back(index);
+}
+
+void Pipeline::rasterizeTile(int tile) {
+	int tx = tile % tileCountX, ty = tile / tileCountX;
+	RasterRect rect;
+	rect.x0 = tx * TILE_SIZE;
+	rect.y0 = ty * TILE_SIZE;
+	rect.x1 = MIN(rect.x0 + TILE_SIZE, screenWidth) - 1;
+	rect.y1 = MIN(rect.y0 + TILE_SIZE, screenHeight) - 1;
+	STATS_SCOPE(threadStats(), Stats::STAGE_RASTER);
+	TRACE_SCOPE("tile", "tile", tile);
+
+	// 每个分块只由当前线程写入,无需加锁
+	const Frame & frame = *rasterFrame;
+	HiZStats hiZCounts = HiZStats();
+	for (size_t t = 0; t < frame.tileBins.size(); t++) {
+		const vector<int> & bin = frame.tileBins[t][tile];
+		for (size_t i = 0; i < bin.size(); i++) {
+			const BinnedTriangle & bt = frame.binnedTriangles[t][bin[i]];
+			drawTriangle(&bt.v[0], &bt.v[1], &bt.v[2], *bt.mesh, rect, false, hiZCounts);
 		}
 	}
+	hiZAddCounts(hiZCounts);
 }
 
 void Pipeline::triangleSpilt(SplitedTriangle & st, const TVertex * v0, const TVertex * v1, const TVertex * v2) {
@@ -286,15 +815,80 @@ void Pipeline::triangleSpilt(SplitedTriangle & st, const TVertex * v0, const TVe
 int Pipeline::checkCVV(const Vector4 & v) {
 	float w = v.w;
 	int check = 0;
-	if (v.z < 0.f) check |= 1;
-	if (v.z > w)   check |= 2;
-	if (v.x < -w)  check |= 4;
-	if (v.x > w)   check |= 8;
-	if (v.y < -w)  check |= 16;
-	if (v.y > w)   check |= 32;
+	if (v.z < 0.f) check |= CLIP_NEAR;
+	if (v.z > w)   check |= CLIP_FAR;
+	if (v.x < -w)  check |= CLIP_LEFT;
+	if (v.x > w)   check |= CLIP_RIGHT;
+	if (v.y < -w)  check |= CLIP_BOTTOM;
+	if (v.y > w)   check |= CLIP_TOP;
+	return check;
+}
+
+int Pipeline::checkGuardBand(const Vector4 & v) {
+	float gx = guardX * v.w, gy = guardY * v.w;
+	int check = 0;
+	if (v.x < -gx) check |= CLIP_LEFT;
+	if (v.x > gx)  check |= CLIP_RIGHT;
+	if (v.y < -gy) check |= CLIP_BOTTOM;
+	if (v.y > gy)  check |= CLIP_TOP;
 	return check;
 }
 
+int Pipeline::clipTriangle(ClipVertex * poly, int planes, TVertex * out) {
+	ClipVertex buffer[MAX_CLIP_VERTICES];
+	ClipVertex * src = poly, * dst = buffer;
+	int count = 3;
+
+	// Sutherland-Hodgman: 依次用每个裁剪面裁剪多边形, 顶点到裁剪面的有向距离d >= 0为在内侧.
+	// 先裁近平面, 之后所有顶点的w都大于0
+	for (int plane = CLIP_NEAR; plane <= CLIP_TOP && count >= 3; plane <<= 1) {
+		if (!(planes & plane))
+			continue;
+		float d[MAX_CLIP_VERTICES];
+		for (int i = 0; i < count; i++) {
+			const Vector4 & c = src[i].clip;
+			switch (plane) {
+			case CLIP_NEAR:   d[i] = c.z; break;
+			case CLIP_FAR:    d[i] = c.w - c.z; break;
+			case CLIP_LEFT:   d[i] = guardX * c.w + c.x; break;
+			case CLIP_RIGHT:  d[i] = guardX * c.w - c.x; break;
+			case CLIP_BOTTOM: d[i] = guardY * c.w + c.y; break;
+			default:          d[i] = guardY * c.w - c.y; break;
+			}
+		}
+
+		int n = 0;
+		for (int i = 0; i < count; i++) {
+			int j = (i + 1) % count;
+			if (d[i] >= 0)
+				dst[n++] = src[i];
+			// 边与裁剪面相交时在交点生成新顶点(属性在裁剪空间中线性插值)
+			if ((d[i] >= 0) != (d[j] >= 0)) {
+				float t = d[i] / (d[i] - d[j]);
+				const ClipVertex & a = src[i], & b = src[j];
+				ClipVertex & v = dst[n++];
+				v.clip = Vector4(a.clip.x + (b.clip.x - a.clip.x) * t, a.clip.y + (b.clip.y - a.clip.y) * t,
+					a.clip.z + (b.clip.z - a.clip.z) * t, a.clip.w + (b.clip.w - a.clip.w) * t);
+				v.color = Math::lerp(a.color, b.color, t);
+				v.texCoord = Math::lerp(a.texCoord, b.texCoord, t);
+				v.normal = Math::lerp(a.normal, b.normal, t);
+			}
+		}
+		count = n;
+		swap(src, dst);
+	}
+
+	for (int i = 0; i < count; i++) {
+		TVertex & v = out[i];
+		v.color = src[i].color;
+		v.texCoord = src[i].texCoord;
+		v.normal = src[i].normal;
+		transformHomogenize(src[i].clip, v.point);
+		v.init_rhw(src[i].clip.w);
+	}
+	return count;
+}
+
 void Pipeline::transformHomogenize(const Vector4 & src, Vector3 & dst) {
 	dst = (Vector3)src;
 	dst.x = (dst.x + 1.0f) * screenWidth * 0.5f;
@@ -383,64 +977,122 @@ void Pipeline::renderLine(const Line & line, const Matrix44 & transform) {
 	
 }
 
-void Pipeline::renderMesh(const shared_ptr<Mesh> mesh, const Matrix44 & transform, const Matrix44 & normalMatrix) {
-	vector<Vertex> & v = mesh->vertices;
-	currentTexture = mesh->texture;
-	currentShadeFunc = mesh->shadeFunc;
-
-#pragma omp parallel for schedule(dynamic)
-	for (int i = 0; (size_t)i < mesh->primitives.size(); i++) {
-		Vertex * vo[3];
-		Vector4 c0, c1, c2;
-		Vector3 p0, p1, p2;
-		Primitive & p = mesh->primitives[i];
-		vo[0] = &v[p.vertexIndex[0]];
-		vo[1] = &v[p.vertexIndex[1]];
-		vo[2] = &v[p.vertexIndex[2]];
+void Pipeline::transformVertices(MeshTask & task, size_t begin, size_t end) {
+	STATS_SCOPE(threadStats(*task.frame), Stats::STAGE_VERTEX);
+	TRACE_SCOPE("vertices", "mesh", task.index);
+	const bool fill = (renderState & (~WIREFRAME)) != 0;
+	vector<PostTransformVertex> & transformed = *task.transformed;
+
+	// 顶点处理:每个顶点只变换一次,共享顶点的图元直接取用结果
+	if (task.batched) {
+		const VertexBatch batch = {
+			&task.mesh->streams, &task.transform, fill ? &task.normalMatrix : nullptr, (float)screenWidth, (float)screenHeight, transformed.data()
+		};
+		vertexTransform(batch, begin, end);
+		return;
+	}
+	const vector<Vertex> & v = task.mesh->vertices;
+	for (size_t i = begin; i < end; i++) {
+		PostTransformVertex & t = transformed[i];
 		// 按照 Transform 变化
-		transform.apply(vo[0]->point, c0);
-		transform.apply(vo[1]->point, c1);
-		transform.apply(vo[2]->point, c2);
-
-		// 裁剪测试:可以完善为进一步精细裁剪
-		int cvv[3] = { checkCVV(c0), checkCVV(c1), checkCVV(c2) };
-		// 全部顶点都在屏幕外就不渲染
-		if (cvv[0] && cvv[1] && cvv[2]) continue;
-
+		task.transform.apply(v[i].point, t.clip);
+		t.cvv = checkCVV(t.clip);
 		// 归一化到屏幕空间
-		transformHomogenize(c0, p0);
-		transformHomogenize(c1, p1);
-		transformHomogenize(c2, p2);
-
-		if ((renderState & (~WIREFRAME)) && (!(cvv[0] || cvv[1] || cvv[2]))) {
-			// 背面剔除
-			if (cross(p1 - p0, p2 - p1).z <= 0)
-				continue;
-
-			TVertex v0(*vo[0]), v1(*vo[1]), v2(*vo[2]);
-			SplitedTriangle st;
-			v0.point = p0;
-			v1.point = p1;
-			v2.point = p2;
+		transformHomogenize(t.clip, t.screen);
+		if (fill) task.normalMatrix.applyDir(v[i].normal, t.normal);
+	}
+}
 
-			if (p.extraNormal.isZero()) {
-				normalMatrix.applyDir(vo[0]->normal, v0.normal);
-				normalMatrix.applyDir(vo[1]->normal, v1.normal);
-				normalMatrix.applyDir(vo[2]->normal, v2.normal);
+void Pipeline::assemblePrimitives(const MeshTask & task, int begin, int end) {
+	TRACE_SCOPE("primitives", "mesh", task.index);
+	const Mesh & mesh = *task.mesh;
+	const Matrix44 & normalMatrix = task.normalMatrix;
+	const vector<Vertex> & v = mesh.vertices;
+	const vector<PostTransformVertex> & transformed = *task.transformed;
+	const RasterRect screenRect = { 0, 0, screenWidth - 1, screenHeight - 1 };
+	const bool fill = (renderState & (~WIREFRAME)) != 0;
+	HiZStats hiZCounts = HiZStats();
+
+	// 图元装配
+	for (int i = begin; i < end; i++) {
+		STATS_ONLY(Stats::ThreadStats & ts = threadStats(*task.frame));
+		STATS_SCOPE(ts, Stats::STAGE_CLIP);
+		STATS_ADD(ts, Stats::TRIANGLES_SUBMITTED, 1);
+		const Primitive & p = mesh.primitives[i];
+		const Vertex * vo[3] = { &v[p.vertexIndex[0]], &v[p.vertexIndex[1]], &v[p.vertexIndex[2]] };
+		const PostTransformVertex * t[3] = {
+			&transformed[p.vertexIndex[0]], &transformed[p.vertexIndex[1]], &transformed[p.vertexIndex[2]]
+		};
+		const Vector3 & p0 = t[0]->screen, & p1 = t[1]->screen, & p2 = t[2]->screen;
+
+		// 裁剪测试: 全部顶点都在同一裁剪面外就不渲染
+		int cvv[3] = { t[0]->cvv, t[1]->cvv, t[2]->cvv };
+		if (cvv[0] & cvv[1] & cvv[2]) continue;
+
+		if (fill) {
+			TVertex polygon[MAX_CLIP_VERTICES];
+			int count = 3;
+			Vector3 faceNormal;
+			const bool flat = !p.extraNormal.isZero();
+			if (flat) normalMatrix.applyDir(p.extraNormal, faceNormal);
+
+			// 穿过近/远平面的三角形必须裁剪; x/y方向只裁剪超出保护带的部分, 其余由光栅化时的裁剪矩形处理
+			int outcode = cvv[0] | cvv[1] | cvv[2];
+			int planes = outcode & (CLIP_NEAR | CLIP_FAR);
+			if (outcode & CLIP_XY)
+				planes |= checkGuardBand(t[0]->clip) | checkGuardBand(t[1]->clip) | checkGuardBand(t[2]->clip);
+
+			if (!planes) {
+				// 背面剔除
+				STATS_SWITCH(ts, Stats::STAGE_CULL);
+				if (cross(p1 - p0, p2 - p1).z <= 0) {
+					STATS_ADD(ts, Stats::TRIANGLES_CULLED, 1);
+					continue;
+				}
+				STATS_SWITCH(ts, Stats::STAGE_VERTEX);
+
+				for (int k = 0; k < 3; k++) {
+					TVertex & tv = polygon[k];
+					tv = TVertex(*vo[k]);
+					tv.point = t[k]->screen;
+					tv.normal = flat ? faceNormal : t[k]->normal;
+					tv.init_rhw(t[k]->clip.w);
+				}
 			} else {
-				normalMatrix.applyDir(p.extraNormal, v0.normal);
-				v1.normal = v2.normal = v0.normal;
+				STATS_ADD(ts, Stats::TRIANGLES_CLIPPED, 1);
+				ClipVertex clip[MAX_CLIP_VERTICES];
+				for (int k = 0; k < 3; k++)
+					clip[k] = ClipVertex{ t[k]->clip, vo[k]->color, vo[k]->texCoord, flat ? faceNormal : t[k]->normal };
+				count = clipTriangle(clip, planes, polygon);
+
+				// 裁剪后的多边形是凸的,按其有向面积做背面剔除
+				STATS_SWITCH(ts, Stats::STAGE_CULL);
+				float area = 0.f;
+				for (int k = 0; k < count; k++) {
+					const Vector3 & a = polygon[k].point, & b = polygon[(k + 1) % count].point;
+					area += a.x * b.y - b.x * a.y;
+				}
+				if (count >= 3 && area <= 0) {
+					STATS_ADD(ts, Stats::TRIANGLES_CULLED, 1);
+					continue;
+				}
 			}
 
-			v0.init_rhw(c0.w);
-			v1.init_rhw(c1.w);
-			v2.init_rhw(c2.w);
-
-			triangleSpilt(st, &v0, &v1, &v2);
-			rasterizeTriangle(st);
+			// 多边形按扇形切分为三角形
+			for (int k = 1; k + 1 < count; k++) {
+				if (task.frame->binning) {
+					STATS_SWITCH(ts, Stats::STAGE_SETUP);
+					binTriangle(*task.frame, &polygon[0], &polygon[k], &polygon[k + 1], mesh);
+				} else {
+					STATS_SWITCH(ts, Stats::STAGE_RASTER);
+					drawTriangle(&polygon[0], &polygon[k], &polygon[k + 1], mesh, screenRect, true, hiZCounts);
+				}
+			}
 		}
 
-		if (renderState & WIREFRAME) {
+		// 线框不做裁剪,只跳过没有顶点在CVV内的三角形
+		if ((renderState & WIREFRAME) && !(cvv[0] && cvv[1] && cvv[2])) {
+			STATS_SWITCH(ts, Stats::STAGE_LINE);
 			if (smoothLine) {
 				rasterizeLine_antialiasing(p0.x, p0.y, p1.x, p1.y, vo[0]->color, vo[1]->color);
 				rasterizeLine_antialiasing(p1.x, p1.y, p2.x, p2.y, vo[1]->color, vo[2]->color);
@@ -453,25 +1105,624 @@ void Pipeline::renderMesh(const shared_ptr<Mesh> mesh, const Matrix44 & transfor
 			
 		}
 	}
+	hiZAddCounts(hiZCounts);
 }
 
-void Pipeline::render(const Scene & scene) {
-	// 清除buffer
-	if (clearState | CLEAR_COLOR)
-		renderBuffer.fill(clearColor.toRGBInt());
-	if (clearState | CLEAR_DEPTH)
-		ZBuffer.fill(0.f);
+void Pipeline::spawnMesh(MeshTask & task) {
+	const Mesh & mesh = *task.mesh;
+	// 有SoA顶点数据时按块批量变换,块大小按SIMD宽度对齐
+	task.batched = vertexTransform && mesh.hasStreams();
+	task.vertexCount = task.batched ? mesh.streams.paddedCount() : mesh.vertices.size();
+	if (task.transformed->size() < task.vertexCount) task.transformed->resize(task.vertexCount);
+
+	int chunkCount = (int)((task.vertexCount + VERTEX_CHUNK - 1) / VERTEX_CHUNK);
+	task.vertexJobs = chunkCount;
+	for (int c = 0; c < chunkCount; c++) {
+		jobs->spawn(task.frame->jobs, [this, &task, c]() {
+			transformVertices(task, c * VERTEX_CHUNK, MIN((c + 1) * VERTEX_CHUNK, task.vertexCount));
+			// 最后完成的顶点任务提交该Mesh的分箱, 或直接结束几何阶段(图元装配在光栅化阶段进行)
+			if (--task.vertexJobs == 0) {
+				if (task.frame->binning)
+					spawnPrimitives(task, &Pipeline::finishGeometry);
+				else
+					finishGeometry(*task.frame);
+			}
+		});
+	}
+	if (chunkCount == 0) {
+		if (task.frame->binning)
+			spawnPrimitives(task, &Pipeline::finishGeometry);
+		else
+			finishGeometry(*task.frame);
+	}
+}
+
+void Pipeline::spawnPrimitives(MeshTask & task, void (Pipeline::*onDone)(Frame &)) {
+	int count = (int)task.mesh->primitives.size();
+	int chunkCount = (count + PRIMITIVE_CHUNK - 1) / PRIMITIVE_CHUNK;
+	if (chunkCount == 0) {
+		(this->*onDone)(*task.frame);
+		return;
+	}
+	task.primitiveJobs = chunkCount;
+	for (int c = 0; c < chunkCount; c++) {
+		jobs->spawn(task.frame->jobs, [this, &task, c, count, onDone]() {
+			assemblePrimitives(task, c * PRIMITIVE_CHUNK, MIN((c + 1) * PRIMITIVE_CHUNK, count));
+			if (--task.primitiveJobs == 0)
+				(this->*onDone)(*task.frame);
+		});
+	}
+}
+
+void Pipeline::finishGeometry(Frame & frame) {
+	if (--frame.geometryPending == 0)
+		releaseRaster(frame);
+}
+
+void Pipeline::releaseRaster(Frame & frame) {
+	if (--frame.rasterDependencies == 0)
+		beginRaster(frame);
+}
+
+void Pipeline::beginRaster(Frame & frame) {
+	// 前一帧的光栅化阶段已经完成, 从这里开始本帧独占颜色缓冲区、深度缓冲区与层次Z缓冲
+	rasterFrame = &frame;
+	colorBuffer = tiledColor ? tiledColor.get() : frame.target;
+
+	// 清除buffer: 快速清除只标记分块, 否则整体填充
+	{
+		STATS_SCOPE(threadStats(), Stats::STAGE_CLEAR);
+		TRACE_SCOPE("clear");
+		// 不清除颜色时保留待清除分块的清除值
+		if (clearState & CLEAR_COLOR)
+			clearValue = clearColor.toRGBInt();
+		int tileCount = tileCountX * tileCountY;
+		if (fastClear) {
+			unsigned char flags = (clearState & CLEAR_COLOR ? TILE_CLEAR_COLOR : 0) | (clearState & CLEAR_DEPTH ? TILE_CLEAR_DEPTH : 0);
+			for (int i = 0; i < tileCount; i++)
+				tileClear[i].fetch_or(flags, std::memory_order_relaxed);
+		} else {
+			if (clearState & CLEAR_COLOR)
+				colorBuffer->fill(clearValue);
+			if (clearState & CLEAR_DEPTH)
+				ZBuffer.fill(0.f);
+			// 之前延迟的清除已被整体填充代替
+			unsigned char filled = (clearState & CLEAR_COLOR ? TILE_CLEAR_COLOR : 0) | (clearState & CLEAR_DEPTH ? TILE_CLEAR_DEPTH : 0);
+			for (int i = 0; i < tileCount; i++)
+				tileClear[i].fetch_and((unsigned char)~filled, std::memory_order_relaxed);
+		}
+		if (clearState & CLEAR_DEPTH)
+			hiZClear();
+	}
+	hiZCounters.trianglesTested = 0;
+	hiZCounters.trianglesCulled = 0;
+	hiZCounters.blocksTested = 0;
+	hiZCounters.blocksCulled = 0;
+
+	if (frame.rayTracing) {
+		spawnTrace(frame);
+		return;
+	}
+	if (frame.binning) {
+		spawnTiles(frame);
+		return;
+	}
+	frame.rasterPending = (int)frame.scene.meshes.size() + 1;
+	for (size_t i = 0; i < frame.scene.meshes.size(); i++)
+		spawnPrimitives(*frame.meshTasks[i], &Pipeline::finishAssembly);
+	finishAssembly(frame);
+}
 
-	Matrix44 projectionViewTransform = scene.view * scene.projection;
+void Pipeline::finishAssembly(Frame & frame) {
+	if (--frame.rasterPending > 0)
+		return;
+	// 分箱模式下在所有Mesh分箱完成后按分块光栅化
+	if (frame.binning)
+		spawnTiles(frame);
+	else
+		spawnLines(frame);
+}
 
-	// 渲染Mesh
-	for (size_t i = 0; i < scene.meshes.size(); i++) {
-		renderMesh(scene.meshes[i], scene.modelMatrixs[i] * projectionViewTransform, scene.modelMatrixs[i] * scene.view);
+void Pipeline::spawnTiles(Frame & frame) {
+	int tileCount = tileCountX * tileCountY;
+	frame.rasterPending = tileCount;
+	for (int tile = 0; tile < tileCount; tile++) {
+		jobs->spawn(frame.jobs, [this, &frame, tile]() {
+			rasterizeTile(tile);
+			if (--frame.rasterPending == 0)
+				spawnLines(frame);
+		});
 	}
+}
 
-	// 渲染线条
-#pragma omp parallel for schedule(dynamic)
-	for (int i = 0; (size_t)i < scene.lines.size(); i++) {
-		renderLine(scene.lines[i], projectionViewTransform);
+void Pipeline::spawnTrace(Frame & frame) {
+	int tileCount = tileCountX * tileCountY;
+	frame.rasterPending = tileCount;
+	for (int tile = 0; tile < tileCount; tile++) {
+		jobs->spawn(frame.jobs, [this, &frame, tile]() {
+			if (frame.pathTracing)
+				pathTile(frame, tile);
+			else
+				traceTile(frame, tile);
+			if (--frame.rasterPending == 0)
+				spawnLines(frame);
+		});
 	}
 }
+
+void Pipeline::traceTile(Frame & frame, int tile) {
+	TRACE_SCOPE("trace", "tile", tile);
+	STATS_SCOPE(threadStats(), Stats::STAGE_TRACE);
+	// 分块内每个像素都会写入, 待清除的颜色不需要再填充
+	unsigned pending = claimTile(tile, TILE_CLEAR_COLOR);
+	int x0 = tile % tileCountX * TILE_SIZE, y0 = tile / tileCountX * TILE_SIZE;
+	int x1 = MIN(x0 + TILE_SIZE, screenWidth), y1 = MIN(y0 + TILE_SIZE, screenHeight);
+	const RayCamera & camera = frame.camera;
+	// 穿过像素中心, 从近平面到远平面, 与光栅化的裁剪范围一致
+	auto primaryRay = [&camera](int x, int y) {
+		float sx = x + .5f, sy = y + .5f;
+		Ray ray;
+		ray.origin = camera.near0 + camera.nearDx * sx + camera.nearDy * sy;
+		ray.dir = camera.far0 + camera.farDx * sx + camera.farDy * sy - ray.origin;
+		ray.tMin = 0.f;
+		ray.tMax = 1.f;
+		return ray;
+	};
+	RGBColor c;
+	if (!packetIntersect) {
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < x1; x++)
+				*(*colorBuffer)(x, y) = traceRay(frame, primaryRay(x, y), rayDepth, c) ? c.toRGBInt() : clearValue;
+	} else {
+		// 相邻的4x2个像素的主光线方向相近, 成组遍历BVH; 着色与反射仍逐条进行
+		const int PACKET_W = 4, PACKET_H = RayPacket::SIZE / PACKET_W;
+		RayPacket packet;
+		Ray rays[RayPacket::SIZE];
+		RayHit hits[RayPacket::SIZE];
+		for (int py = y0; py < y1; py += PACKET_H) {
+			for (int px = x0; px < x1; px += PACKET_W) {
+				int count = 0;
+				for (int i = 0; i < RayPacket::SIZE; i++) {
+					int x = px + i % PACKET_W, y = py + i / PACKET_W;
+					if (x < x1 && y < y1) {
+						rays[i] = primaryRay(x, y);
+						packet.set(i, rays[i]);
+						count++;
+					} else {
+						packet.disable(i);
+					}
+				}
+				STATS_ADD(threadStats(), Stats::RAYS, count);
+				packetIntersect(frame.bvh, packet, hits);
+				for (int i = 0; i < RayPacket::SIZE; i++) {
+					int x = px + i % PACKET_W, y = py + i / PACKET_W;
+					if (x < x1 && y < y1)
+						*(*colorBuffer)(x, y) = hits[i].triangle >= 0 && shadeHit(frame, rays[i], hits[i], rayDepth, c) ? c.toRGBInt() : clearValue;
+				}
+			}
+		}
+	}
+	if (pending)
+		releaseTile(tile, pending);
+}
+
+bool Pipeline::traceRay(const Frame & frame, const Ray & ray, int depth, RGBColor & out) {
+	STATS_ADD(threadStats(), Stats::RAYS, 1);
+	RayHit hit;
+	return frame.bvh.intersect(ray, hit) && shadeHit(frame, ray, hit, depth, out);
+}
+
+bool Pipeline::shadeHit(const Frame & frame, const Ray & ray, const RayHit & hit, int depth, RGBColor & out) {
+	const BVH::Triangle & tri = frame.bvh.triangle(hit.triangle);
+	const Mesh & mesh = *frame.scene.meshes[tri.mesh];
+	const Primitive & p = mesh.primitives[tri.primitive];
+	const Vertex & a = mesh.vertices[p.vertexIndex[0]], & b = mesh.vertices[p.vertexIndex[1]], & c = mesh.vertices[p.vertexIndex[2]];
+
+	// 按重心坐标插值顶点属性(世界空间中的重心坐标即透视校正后的插值)
+	float w = 1.f - hit.u - hit.v;
+	Vector3 position = ray.origin + ray.dir * hit.t;
+	RGBColor color = a.color * w + b.color * hit.u + c.color * hit.v;
+	TexCoord texCoord = a.texCoord * w + b.texCoord * hit.u + c.texCoord * hit.v;
+	Vector3 normal = hitNormal(frame, hit);
+
+	int rs = mesh.texture ? renderState : renderState & (~TEXTURE);
+	rs = mesh.shader ? rs : rs & (~SHADING);
+	if (rs & SHADING) {
+		// 着色器的输入与光栅化相同: 屏幕空间的位置(x, y归一化到[0, 1)), 观察空间的法线
+		ShadeSpan span;
+		int pixel = 0;
+		float z = 0.f;
+		Vector4 clip;
+		frame.transform.apply(position, clip);
+		TVertex zero(Vector3(), RGBColor(), TexCoord(), Vector3(), 0.f);
+		span.fbPtr = &pixel;
+		span.zbPtr = &z;
+		span.count = 1;
+		span.v0 = TVertex(Vector3(), color, texCoord, frame.scene.view.applyDir(normal), 1.f);
+		transformHomogenize(clip, span.v0.point);
+		span.step = zero;
+		span.stepY = zero;
+		span.invW = 1.f / screenWidth;
+		span.invH = 1.f / screenHeight;
+		span.texture = mesh.texture.get();
+		mesh.shader.shadeSpan(span);
+		// 着色器丢弃的片元不写入深度, 按未命中处理
+		if (z == 0.f)
+			return false;
+		out.setRGBInt(pixel);
+	} else if (rs & TEXTURE) {
+		out.setRGBInt(mesh.texture->readsSource() ? mesh.texture->get(texCoord) : mesh.texture->sample(texCoord, 0.f));
+		if (rs & COLOR) out *= color;
+	} else {
+		out = color;
+	}
+
+	if (depth > 0 && mesh.reflectivity > 0.f) {
+		// 镜面反射: 法线朝向入射光线的一侧, 反射光线从交点出发(背面剔除使其不会再命中同一个三角形)
+		Vector3 n = normal.NormalizedVector(), d = ray.dir;
+		d.normalize();
+		if (n * d > 0) n = -n;
+		Ray reflected;
+		reflected.origin = position;
+		reflected.dir = reflect(d, n);
+		reflected.tMin = 1e-4f;
+		reflected.tMax = FLT_MAX;
+		RGBColor r = clearColor;
+		traceRay(frame, reflected, depth - 1, r);
+		out = out * (1.f - mesh.reflectivity) + r * mesh.reflectivity;
+	}
+	return true;
+}
+
+Vector3 Pipeline::hitNormal(const Frame & frame, const RayHit & hit) const {
+	const BVH::Triangle & tri = frame.bvh.triangle(hit.triangle);
+	const Mesh & mesh = *frame.scene.meshes[tri.mesh];
+	const Primitive & p = mesh.primitives[tri.primitive];
+	if (!p.extraNormal.isZero())
+		return frame.scene.modelMatrixs[tri.mesh].applyDir(p.extraNormal);
+	const Vertex & a = mesh.vertices[p.vertexIndex[0]], & b = mesh.vertices[p.vertexIndex[1]], & c = mesh.vertices[p.vertexIndex[2]];
+	float w = 1.f - hit.u - hit.v;
+	return frame.scene.modelMatrixs[tri.mesh].applyDir(a.normal * w + b.normal * hit.u + c.normal * hit.v);
+}
+
+void Pipeline::continueAccumulation(Frame & frame) {
+	Accumulation & acc = accumulation;
+	const Scene & scene = frame.scene;
+	if (!acc.buffer)
+		acc.buffer.reset(new ColorBuffer(screenWidth, screenHeight));
+	// 矩阵按位比较, 任何变化都重新开始
+	auto same = [](const Matrix44 & a, const Matrix44 & b) { return !memcmp(&a.x, &b.x, sizeof(a.x)); };
+	bool keep = acc.samples > 0 && acc.renderState == renderState && acc.clearValue == clearColor.toRGBInt() &&
+		same(acc.view, scene.view) && same(acc.projection, scene.projection) &&
+		acc.models.size() == scene.modelMatrixs.size() && acc.meshes.size() == scene.meshes.size();
+	auto state = [](const Mesh & mesh) {
+		return Accumulation::MeshState{ &mesh, mesh.texture ? mesh.texture->getVersion() : 0u, mesh.shader, mesh.reflectivity };
+	};
+	for (size_t i = 0; keep && i < scene.meshes.size(); i++)
+		keep = acc.meshes[i] == state(*scene.meshes[i]) && same(acc.models[i], scene.modelMatrixs[i]);
+	if (!keep) {
+		acc.samples = 0;
+		acc.view = scene.view;
+		acc.projection = scene.projection;
+		acc.models = scene.modelMatrixs;
+		acc.meshes.clear();
+		for (size_t i = 0; i < scene.meshes.size(); i++)
+			acc.meshes.push_back(state(*scene.meshes[i]));
+		acc.renderState = renderState;
+		acc.clearValue = clearColor.toRGBInt();
+	}
+	frame.pathSample = acc.samples;
+	acc.samples += pathSamples;
+}
+
+void Pipeline::pathTile(Frame & frame, int tile) {
+	TRACE_SCOPE("trace", "path", tile);
+	STATS_SCOPE(threadStats(), Stats::STAGE_TRACE);
+	unsigned pending = claimTile(tile, TILE_CLEAR_COLOR);
+	int x0 = tile % tileCountX * TILE_SIZE, y0 = tile / tileCountX * TILE_SIZE;
+	int x1 = MIN(x0 + TILE_SIZE, screenWidth), y1 = MIN(y0 + TILE_SIZE, screenHeight);
+	const RayCamera & camera = frame.camera;
+	ColorBuffer & sums = *accumulation.buffer;
+	float scale = 1.f / (frame.pathSample + pathSamples);
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			RGBColor sum = frame.pathSample ? *sums(x, y) : RGBColor();
+			for (int i = 0; i < pathSamples; i++) {
+				// 像素内随机位置的主光线
+				PathRandom random(pathSeed, (unsigned)(y * screenWidth + x), (unsigned)(frame.pathSample + i));
+				float sx = x + random.next(), sy = y + random.next();
+				Ray ray;
+				ray.origin = camera.near0 + camera.nearDx * sx + camera.nearDy * sy;
+				ray.dir = camera.far0 + camera.farDx * sx + camera.farDy * sy - ray.origin;
+				ray.tMin = 0.f;
+				ray.tMax = 1.f;
+				sum += tracePath(frame, ray, random);
+			}
+			*sums(x, y) = sum;
+			*(*colorBuffer)(x, y) = (sum * scale).toRGBInt();
+		}
+	}
+	if (pending)
+		releaseTile(tile, pending);
+}
+
+RGBColor Pipeline::tracePath(const Frame & frame, Ray ray, PathRandom & random) {
+	RGBColor throughput(1.f, 1.f, 1.f);
+	for (int bounce = 0; bounce <= rayDepth + 1; bounce++) {
+		STATS_ADD(threadStats(), Stats::RAYS, 1);
+		RayHit hit;
+		RGBColor albedo;
+		// 着色器丢弃的片元按未命中处理. 主光线未命中时为背景(清除颜色), 次级光线未命中时得到环境光
+		if (!frame.bvh.intersect(ray, hit) || !shadeHit(frame, ray, hit, 0, albedo))
+			return throughput * (bounce ? skyColor : clearColor);
+
+		const Mesh & mesh = *frame.scene.meshes[frame.bvh.triangle(hit.triangle).mesh];
+		Vector3 n = hitNormal(frame, hit), d = ray.dir;
+		n.normalize();
+		d.normalize();
+		if (n * d > 0) n = -n;
+		ray.origin = ray.origin + ray.dir * hit.t;
+		ray.tMin = 1e-4f;
+		ray.tMax = FLT_MAX;
+		if (mesh.reflectivity > 0.f && random.next() < mesh.reflectivity) {
+			// 按反射率的概率镜面反射, 否则漫反射, 两者的权重都为1
+			ray.dir = reflect(d, n);
+		} else {
+			// 按余弦分布采样法线一侧的半球(pdf与Lambert的余弦项相消, 只乘以反照率)
+			throughput *= albedo;
+			float sign = n.z >= 0.f ? 1.f : -1.f;
+			float a = -1.f / (sign + n.z), b = n.x * n.y * a;
+			Vector3 tangent(1.f + sign * n.x * n.x * a, sign * b, -sign * n.x), bitangent(b, sign + n.y * n.y * a, -n.y);
+			float r = std::sqrt(random.next()), phi = 2.f * Math::PI * random.next();
+			ray.dir = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(MAX(0.f, 1.f - r * r));
+		}
+	}
+	// 超过最大弹射次数的路径没有到达光源
+	return RGBColor();
+}
+
+void Pipeline::spawnLines(Frame & frame) {
+	const vector<Line> & lines = frame.scene.lines;
+	int chunkCount = ((int)lines.size() + LINE_CHUNK - 1) / LINE_CHUNK;
+	if (chunkCount == 0) {
+		resolveFrame(frame);
+		return;
+	}
+	frame.linesPending = chunkCount;
+	jobs->parallelFor(frame.jobs, (int)lines.size(), LINE_CHUNK, [this, &frame, &lines](int begin, int end) {
+		{
+			STATS_SCOPE(threadStats(), Stats::STAGE_LINE);
+			TRACE_SCOPE("lines");
+			for (int i = begin; i < end; i++)
+				renderLine(lines[i], frame.transform);
+		}
+		if (--frame.linesPending == 0)
+			resolveFrame(frame);
+	});
+}
+
+void Pipeline::resolveFrame(Frame & frame) {
+	if (!fastClear && !tiledColor) {
+		finishFrame(frame);
+		return;
+	}
+	// 按分块行提交, 每个任务把一行中从未写入颜色的分块填充为清除颜色, 分块布局时再把其余分块复制到该帧的目标
+	frame.rasterPending = tileCountY;
+	jobs->parallelFor(frame.jobs, tileCountY, 1, [this, &frame](int begin, int end) {
+		{
+			STATS_SCOPE(threadStats(), Stats::STAGE_CLEAR);
+			TRACE_SCOPE("resolve");
+			IntBuffer & target = *frame.target;
+			vector<bool> claimed(tileCountX);
+			for (int ty = begin; ty < end; ty++) {
+				int row = ty * tileCountX;
+				int y0 = ty * TILE_SIZE, y1 = MIN(y0 + TILE_SIZE, screenHeight);
+				for (int tx = 0; tx < tileCountX; tx++)
+					claimed[tx] = claimTile(row + tx, TILE_CLEAR_COLOR) != 0;
+				// 相邻的分块合并后逐行连续填充或复制, 比逐个分块处理(每行只有64个像素)访存更连续
+				for (int tx = 0; tx < tileCountX; ) {
+					int runEnd = tx + 1;
+					while (runEnd < tileCountX && claimed[runEnd] == claimed[tx]) runEnd++;
+					int x0 = tx * TILE_SIZE, x1 = MIN(runEnd * TILE_SIZE, screenWidth);
+					if (claimed[tx])
+						target.fill(x0, y0, x1, y1, clearValue);
+					else if (tiledColor)
+						tiledColor->copyTo(target, x0, y0, x1, y1);
+					tx = runEnd;
+				}
+				// 分块布局时清除颜色直接写入了目标, 分块缓冲区中这些分块仍待清除
+				for (int tx = 0; tx < tileCountX; tx++)
+					if (claimed[tx]) releaseTile(row + tx, tiledColor ? 0 : TILE_CLEAR_COLOR);
+			}
+		}
+		if (--frame.rasterPending == 0)
+			finishFrame(frame);
+	});
+}
+
+unsigned Pipeline::claimTile(int tile, unsigned flags) {
+	std::atomic<unsigned char> & state = tileClear[tile];
+	unsigned char current = state.load(std::memory_order_acquire);
+	for (;;) {
+		if (!(current & flags))
+			return 0;
+		// 其他线程正在写入时等待其完成
+		if (current & TILE_CLEAR_BUSY) {
+			std::this_thread::yield();
+			current = state.load(std::memory_order_acquire);
+			continue;
+		}
+		if (state.compare_exchange_weak(current, (unsigned char)(current | TILE_CLEAR_BUSY), std::memory_order_acquire))
+			return current & flags;
+	}
+}
+
+void Pipeline::releaseTile(int tile, unsigned cleared) {
+	// 持有标识期间其他线程不会修改状态
+	tileClear[tile].fetch_and((unsigned char)~(cleared | TILE_CLEAR_BUSY), std::memory_order_release);
+}
+
+void Pipeline::clearTile(int tile, unsigned flags) {
+	unsigned pending = claimTile(tile, flags);
+	if (!pending)
+		return;
+	int x0 = tile % tileCountX * TILE_SIZE, y0 = tile / tileCountX * TILE_SIZE;
+	int x1 = MIN(x0 + TILE_SIZE, screenWidth), y1 = MIN(y0 + TILE_SIZE, screenHeight);
+	if (pending & TILE_CLEAR_COLOR)
+		colorBuffer->fill(x0, y0, x1, y1, clearValue);
+	if (pending & TILE_CLEAR_DEPTH)
+		ZBuffer.fill(x0, y0, x1, y1, 0.f);
+	releaseTile(tile, pending);
+}
+
+void Pipeline::finishFrame(Frame & frame) {
+	frame.hiZStats.trianglesTested = hiZCounters.trianglesTested;
+	frame.hiZStats.trianglesCulled = hiZCounters.trianglesCulled;
+	frame.hiZStats.blocksTested = hiZCounters.blocksTested;
+	frame.hiZStats.blocksCulled = hiZCounters.blocksCulled;
+	STATS_ONLY(frame.stats.frameTime = std::chrono::duration<double>(Stats::Clock::now() - frame.start).count());
+
+	// 允许下一帧开始光栅化
+	Frame * next;
+	{
+		std::lock_guard<std::mutex> guard(frameMutex);
+		frame.rasterDone = true;
+		next = frame.next;
+		frame.next = nullptr;
+	}
+	if (next) releaseRaster(*next);
+	jobs->release(frame.jobs);
+}
+
+void Pipeline::submit(const Scene & scene, int slot) {
+	Frame & frame = frames[slot];
+	if (frame.serial) jobs->wait(frame.jobs);
+	if (slot == 1 && !backBuffer)
+		backBuffer.reset(new IntBuffer(screenWidth, screenHeight, renderBuffer.getOptions()));
+
+	frame.serial = ++frameSerial;
+	frame.target = slot ? backBuffer.get() : &renderBuffer;
+	frame.rayTracing = rayTracing || pathTracing;
+	frame.pathTracing = pathTracing;
+	frame.binning = !frame.rayTracing && parallelMode == PARALLEL_TILE && !(renderState & WIREFRAME);
+	STATS_ONLY(frame.start = Stats::Clock::now());
+	STATS_ONLY(frame.stats.reset((size_t)jobs->getThreadCount()));
+	frame.scene = scene;
+	frame.transform = scene.view * scene.projection;
+
+	// 分箱模式下先清空上一次的分箱数据
+	if (frame.binning) {
+		size_t threadNum = (size_t)jobs->getThreadCount();
+		frame.binnedTriangles.resize(threadNum);
+		frame.tileBins.resize(threadNum);
+		for (size_t t = 0; t < threadNum; t++) {
+			frame.binnedTriangles[t].clear();
+			frame.tileBins[t].resize(tileCountX * tileCountY);
+			for (size_t i = 0; i < frame.tileBins[t].size(); i++)
+				frame.tileBins[t][i].clear();
+		}
+	}
+
+	// 光栅化阶段在本帧的几何阶段与前一帧(另一个位置上未完成的帧)的光栅化阶段都完成后开始
+	jobs->retain(frame.jobs);
+	frame.rasterDependencies = 2;
+	{
+		std::lock_guard<std::mutex> guard(frameMutex);
+		frame.rasterDone = false;
+		Frame & previous = frames[slot ^ 1];
+		if (previous.rasterDone)
+			frame.rasterDependencies--;
+		else
+			previous.next = &frame;
+	}
+
+	if (frame.pathTracing)
+		continueAccumulation(frame);
+
+	// 光线追踪时几何阶段只有构建本帧的BVH
+	if (frame.rayTracing) {
+		// 屏幕坐标 -> NDC -> 世界空间, 近/远平面分别为NDC中的z = 0与z = 1
+		Matrix44 inverse = frame.transform.inverse();
+		float sx = 2.f / screenWidth, sy = -2.f / screenHeight;
+		RayCamera & camera = frame.camera;
+		camera.near0 = inverse.apply(Vector3(-1.f, 1.f, 0.f));
+		camera.nearDx = inverse.apply(Vector3(-1.f + sx, 1.f, 0.f)) - camera.near0;
+		camera.nearDy = inverse.apply(Vector3(-1.f, 1.f + sy, 0.f)) - camera.near0;
+		camera.far0 = inverse.apply(Vector3(-1.f, 1.f, 1.f));
+		camera.farDx = inverse.apply(Vector3(-1.f + sx, 1.f, 1.f)) - camera.far0;
+		camera.farDy = inverse.apply(Vector3(-1.f, 1.f + sy, 1.f)) - camera.far0;
+		frame.geometryPending = 2;
+		frame.bvh.build(frame.scene, *jobs, frame.jobs, [this, &frame]() {
+			finishGeometry(frame);
+		});
+		finishGeometry(frame);
+		return;
+	}
+
+	// 所有Mesh的顶点变换、图元装配、分块光栅化与线条组成一个任务图, 各阶段在前一阶段完成后由最后一个任务提交,
+	// 不同Mesh之间没有同步点
+	size_t meshCount = scene.meshes.size();
+	if (frame.transformed.size() < meshCount) frame.transformed.resize(meshCount);
+	frame.meshTasks.resize(meshCount);
+	frame.geometryPending = (int)meshCount + 1;
+	for (size_t i = 0; i < meshCount; i++) {
+		if (!frame.meshTasks[i]) frame.meshTasks[i].reset(new MeshTask());
+		MeshTask & task = *frame.meshTasks[i];
+		task.frame = &frame;
+		task.mesh = frame.scene.meshes[i];
+		task.transform = frame.scene.modelMatrixs[i] * frame.transform;
+		task.normalMatrix = frame.scene.modelMatrixs[i] * frame.scene.view;
+		task.index = (int)i;
+		task.transformed = &frame.transformed[i];
+		spawnMesh(task);
+	}
+	// 多出的一个计数保证所有Mesh提交完之前不会进入下一阶段
+	finishGeometry(frame);
+}
+
+bool Pipeline::Fence::ready() const {
+	return expired() || pipeline->frames[slot].jobs.done();
+}
+
+bool Pipeline::Fence::expired() const {
+	return pipeline->frames[slot].serial != serial;
+}
+
+const IntBuffer * Pipeline::Fence::wait() {
+	// 提交新的一帧前已等待该位置上的帧完成, 其颜色缓冲区已属于新的帧
+	if (expired())
+		return nullptr;
+	Frame & frame = pipeline->frames[slot];
+	{
+		TRACE_SCOPE("wait");
+		pipeline->jobs->wait(frame.jobs);
+	}
+	pipeline->hiZStats = frame.hiZStats;
+	STATS_ONLY(pipeline->frameStats = frame.stats);
+	return frame.target;
+}
+
+void Pipeline::finish() {
+	// 先等较早提交的一帧
+	int first = frames[0].serial < frames[1].serial ? 0 : 1;
+	for (int k = 0; k < 2; k++) {
+		Frame & frame = frames[first ^ k];
+		if (frame.serial && !frame.jobs.done())
+			Fence(this, first ^ k, frame.serial).wait();
+	}
+}
+
+void Pipeline::render(const Scene & scene) {
+	TRACE_SCOPE("render");
+	finish();
+	submit(scene, 0);
+	Fence(this, 0, frameSerial).wait();
+}
+
+Pipeline::Fence Pipeline::renderAsync(const Scene & scene) {
+	TRACE_SCOPE("submit");
+	// 与最近提交的一帧交替使用两个位置
+	int slot = frameSerial && frames[0].serial == frameSerial ? 1 : 0;
+	submit(scene, slot);
+	return Fence(this, slot, frameSerial);
+}
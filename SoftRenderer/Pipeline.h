@@ -7,8 +7,15 @@
 #include "FrameBuffer.h"
 #include "Primitives.h"
 #include "Scene.h"
+#include "RasterSIMD.h"
+#include "VertexSIMD.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "JobSystem.h"
+#include "RaySIMD.h"
 
-#include <omp.h>
+#include <atomic>
+#include <mutex>
 
 class Pipeline {
 public:
@@ -29,27 +36,262 @@ public:
 		CLEAR_COLOR_DEPTH = CLEAR_COLOR | CLEAR_DEPTH
 	};
 
+	// 并行模式(指示三角形光栅化的并行方式)
+	enum ParallelMode {
+		PARALLEL_PRIMITIVE = 0,     // 按图元并行,扫描线加锁
+		PARALLEL_TILE = 1           // 先分箱到屏幕分块,再按分块并行(无锁)
+	};
+
+	// 三角形光栅化算法
+	enum RasterizerType {
+		RASTERIZER_SCANLINE = 0,    // 切割为平顶/平底三角形后逐扫描线插值
+		RASTERIZER_HALFSPACE = 1,   // 边函数(half-space)按8x8块遍历包围盒
+		RASTERIZER_FIXED = 2        // 定点数边函数(8位子像素精度, 左上填充规则, 共享边上的像素只着色一次)
+	};
+
+	// 层次Z缓冲的剔除统计(每帧清零)
+	struct HiZStats {
+		long long trianglesTested;  // 参与整体测试的三角形数(分箱模式下按分块计)
+		long long trianglesCulled;  // 整体被遮挡而未光栅化的三角形数
+		long long blocksTested;     // half-space光栅化时参与测试的8x8块数
+		long long blocksCulled;     // 整块被遮挡而跳过的8x8块数
+	};
+
 private:
+	static const int TILE_SIZE = 64;    // 分箱模式下屏幕分块的边长(像素)
+	static const int BLOCK_SIZE = 8;    // half-space光栅化时块的边长(像素)
+	static const int SUBPIXEL_BITS = 8; // 定点数光栅化的子像素精度(位)
+	static const size_t VERTEX_CHUNK = 256; // 顶点变换时每个任务的顶点数
+	static const int PRIMITIVE_CHUNK = 64;  // 图元装配时每个任务的图元数
+	static const int LINE_CHUNK = 64;       // 渲染线条时每个任务的线条数
+	static const int GUARD_BAND = 2048; // 保护带: 屏幕四周额外的像素数, 顶点落在其中时不做x/y裁剪
+	static const int MAX_CLIP_VERTICES = 9; // 三角形经6个裁剪面裁剪后最多的顶点数
+
+	// 裁剪面标识位(与checkCVV的返回值对应)
+	enum ClipPlane {
+		CLIP_NEAR = 1,              // z < 0
+		CLIP_FAR = 2,               // z > w
+		CLIP_LEFT = 4,              // x < -w
+		CLIP_RIGHT = 8,             // x > w
+		CLIP_BOTTOM = 16,           // y < -w
+		CLIP_TOP = 32,              // y > w
+		CLIP_XY = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP
+	};
+
+	// 快速清除时分块的待清除标识位
+	enum TileClearFlag {
+		TILE_CLEAR_COLOR = 1,       // 颜色缓冲区尚未写入清除颜色
+		TILE_CLEAR_DEPTH = 2,       // 深度缓冲区尚未写入0
+		TILE_CLEAR_BUSY = 4         // 某个线程正在写入清除值
+	};
+
+	// 光栅化的裁剪矩形(闭区间)
+	struct RasterRect {
+		int x0, y0, x1, y1;
+	};
+
+	// 层次Z缓冲中的一个8x8块
+	// minRhw始终不大于块内ZBuffer的最小值(用于保守剔除), maxRhw为块内最大值的估计(用于决定是否值得刷新)
+	// 按图元并行时多个线程会同时读写同一块, 各字段都是原子量(只需relaxed顺序, 剔除本身是保守的)
+	struct HiZBlock {
+		std::atomic<float> minRhw;
+		std::atomic<float> maxRhw;
+		std::atomic<bool> dirty;    // 刷新后块内是否又写入过像素
+	};
+
+	// 齐次裁剪空间中的顶点(裁剪时按线性插值生成新顶点)
+	struct ClipVertex {
+		Vector4 clip;
+		RGBColor color;
+		TexCoord texCoord;
+		Vector3 normal;
+	};
+
+	struct Frame;
+
+	// 一帧中一个Mesh的渲染任务
+	struct MeshTask {
+		Frame * frame;
+		shared_ptr<Mesh> mesh;
+		Matrix44 transform;
+		Matrix44 normalMatrix;
+		int index;
+		bool batched;                       // 是否使用SoA数据批量变换
+		size_t vertexCount;
+		vector<PostTransformVertex> * transformed;
+		std::atomic<int> vertexJobs;        // 未完成的顶点变换任务数
+		std::atomic<int> primitiveJobs;     // 未完成的图元装配任务数
+	};
+
+	// 层次Z剔除统计的计数器(多个任务同时累加)
+	struct HiZCounters {
+		std::atomic<long long> trianglesTested, trianglesCulled, blocksTested, blocksCulled;
+	};
+
+	// 光线追踪时由像素位置求主光线: 近/远平面上对应的点都是屏幕坐标的线性函数
+	struct RayCamera {
+		Vector3 near0, nearDx, nearDy;      // 屏幕(0, 0)处在近平面上的点, 及x/y每增加1像素的增量
+		Vector3 far0, farDx, farDy;         // 远平面上的对应量
+	};
+
+	// 分箱后等待光栅化的三角形
+	struct BinnedTriangle {
+		TVertex v[3];
+		const Mesh * mesh;
+	};
+
+	// 一帧的渲染状态. 帧分为几何阶段(顶点变换, 分箱模式下还有图元装配与分箱)和光栅化阶段(清除, 光栅化, 线条),
+	// 几何阶段只写本帧的数据, 可以与前一帧的光栅化同时进行; 光栅化阶段按提交顺序依次执行.
+	// 两份交替使用, 因此最多同时有两帧在处理中
+	struct Frame {
+		Scene scene;                        // 场景的副本(Mesh本身是共享的, 帧完成前不能修改)
+		Matrix44 transform;                 // 投影视图变换
+		IntBuffer * target;                 // 颜色缓冲区
+		unsigned serial;                    // 提交序号, 0表示未使用
+		bool binning;                       // 是否在几何阶段装配图元并分箱(分箱模式且没有线框, 线框在装配时直接绘制)
+		bool rayTracing;                    // 是否光线追踪(几何阶段构建BVH, 光栅化阶段按分块追踪)
+		bool pathTracing;                   // 是否以路径追踪累积样本(光线追踪的一种)
+		int pathSample;                     // 路径追踪时本帧第一个样本的序号(0时重新开始累积)
+		JobSystem::Group jobs;              // 本帧的所有任务
+
+		vector<std::unique_ptr<MeshTask>> meshTasks;    // 每个Mesh的任务
+		vector<vector<PostTransformVertex>> transformed;    // 每个Mesh的变换后顶点, 图元装配时按索引取用
+		vector<vector<BinnedTriangle>> binnedTriangles;  // 每个线程分箱出的三角形
+		vector<vector<vector<int>>> tileBins;            // 每个线程每个分块内的三角形索引
+		BVH bvh;                            // 光线追踪时本帧场景的BVH
+		RayCamera camera;                   // 光线追踪时的主光线
+
+		std::atomic<int> geometryPending;   // 未完成几何阶段的Mesh数(多一个计数防止提交完成前进入下一阶段)
+		std::atomic<int> rasterDependencies;    // 开始光栅化前还需等待的条件数(本帧的几何阶段, 前一帧的光栅化阶段)
+		std::atomic<int> rasterPending;     // 未完成的分块任务(分箱模式)或图元装配任务(按图元并行)数
+		std::atomic<int> linesPending;      // 未完成的线条任务数
+		bool rasterDone;                    // 光栅化阶段已完成(由frameMutex保护)
+		Frame * next;                       // 等待本帧光栅化阶段完成的下一帧(由frameMutex保护)
+
+		HiZStats hiZStats;                  // 本帧的剔除统计
+		Stats::FrameStats stats;            // 本帧的分阶段统计
+		Stats::Clock::time_point start;     // 提交的时刻
+
+		Frame() : target(nullptr), serial(0), binning(false), rayTracing(false), pathTracing(false), pathSample(0), rasterDone(true), next(nullptr) {}
+	};
+
+	// 渐进式路径追踪已累积的内容. 提交时与场景比较, 摄像机/模型矩阵、Mesh或渲染设置变化时重新开始
+	struct Accumulation {
+		// 影响着色结果的Mesh状态(原地修改的纹理、着色器也会使累积重新开始)
+		struct MeshState {
+			const Mesh * mesh;
+			unsigned texture;           // 纹理的Texture::getVersion(), 没有纹理时为0
+			Shader shader;
+			float reflectivity;
+
+			bool operator==(const MeshState & other) const {
+				return mesh == other.mesh && texture == other.texture && shader == other.shader && reflectivity == other.reflectivity;
+			}
+		};
+
+		std::unique_ptr<ColorBuffer> buffer;    // 每个像素的样本之和
+		int samples;                        // 已提交的每像素样本数, 0为重新开始
+		Matrix44 view, projection;
+		vector<Matrix44> models;
+		vector<MeshState> meshes;
+		int renderState;
+		int clearValue;
+
+		Accumulation() : samples(0), renderState(0), clearValue(0) {}
+	};
+
 	////          缓冲区Buffer          ////
-	IntBuffer & renderBuffer;   // 渲染缓冲区
+	IntBuffer & renderBuffer;   // 渲染缓冲区(同步渲染的目标)
+	std::unique_ptr<IntBuffer> backBuffer;  // 异步渲染时与renderBuffer交替使用的颜色缓冲区
+	std::unique_ptr<IntBuffer> tiledColor;  // 分块布局时光栅化的颜色缓冲区, 每帧结束时复制到该帧的目标
+	int bufferTiling;           // 颜色/深度缓冲区分块布局的分块边长, 0为线性布局
+	IntBuffer * colorBuffer;    // 当前光栅化的帧的颜色缓冲区
+	Accumulation accumulation;  // 路径追踪的累积缓冲区(第一次路径追踪时分配)
 	FloatBuffer ZBuffer;        // Z Buffer
-	omp_lock_t * locks;         // 多线程锁
+	std::unique_ptr<std::mutex[]> locks;    // 扫描线锁
 
 	const int screenWidth;
 	const int screenHeight;
+	const int tileCountX;       // 横向分块数
+	const int tileCountY;       // 纵向分块数
+	const int blockCountX;      // 层次Z缓冲横向块数
+	const int blockCountY;      // 层次Z缓冲纵向块数
+	const float guardX;         // 保护带在裁剪空间的横向范围(x在[-guardX * w, guardX * w]内不裁剪)
+	const float guardY;         // 保护带在裁剪空间的纵向范围
+
+	////          快速清除          ////
+
+	// 每个分块(与分箱的分块相同)的待清除标识. 清除时只设置标识, 分块在第一次被读写时才写入清除值,
+	// 光栅化阶段结束时再把从未写入的分块填为清除颜色(深度可以一直延迟到下次写入)
+	std::unique_ptr<std::atomic<unsigned char>[]> tileClear;
+	bool fastClear;             // 是否开启快速清除(关闭时每帧整体填充)
+	int clearValue;             // 正在光栅化的帧的清除颜色
+
+	////          层次Z缓冲          ////
+
+	std::unique_ptr<HiZBlock[]> hiZ;    // 每个8x8块的深度范围(blockCountX * blockCountY个)
+	bool hiZEnabled;            // 是否开启层次Z剔除
+	HiZStats hiZStats;          // 最近完成的一帧的剔除统计
+	HiZCounters hiZCounters;    // 正在光栅化的帧的剔除计数
+
+	Stats::FrameStats frameStats;   // 最近完成的一帧的分阶段统计(SOFTRENDERER_STATS为0时不记录)
+
+	////          任务调度          ////
+
+	std::unique_ptr<JobSystem> jobs;            // 工作线程池
+	Frame frames[2];                            // 交替使用的两帧
+	unsigned frameSerial;                       // 最近提交的帧的序号
+	Frame * rasterFrame;                        // 正在光栅化的帧
+	std::mutex frameMutex;                      // 保护Frame::rasterDone与Frame::next
 
 	////          当前渲染设置          ////
 
 	RGBColor clearColor;        // 清除颜色
 	RenderState renderState;    // 当前的渲染状态
 	ClearState clearState;      // 当前的清除状态
+	ParallelMode parallelMode;  // 当前的并行模式
+	RasterizerType rasterizer;  // 当前的三角形光栅化算法
+	SpanFillFunc spanFill;      // 非着色模式下的SIMD扫描线填充(为空时使用标量路径)
+	VertexTransformFunc vertexTransform;    // 有SoA顶点数据的Mesh的批量顶点变换(为空时使用标量路径)
+	PacketIntersectFunc packetIntersect;    // 光线追踪时主光线按4x2像素成组求交(为空时逐条求交)
 
 	bool smoothLine;            // 是否开启线条抗锯齿
+	bool rayTracing;            // 是否以光线追踪代替光栅化
+	int rayDepth;               // 光线追踪的最大反射次数
+	bool pathTracing;           // 是否以渐进式路径追踪代替光栅化
+	int pathSamples;            // 路径追踪每帧每像素的样本数
+	unsigned pathSeed;          // 路径追踪随机数的种子
+	RGBColor skyColor;          // 路径追踪时次级光线未命中(环境光)的颜色
 
-	////       当前渲染的状态变量       ////
+	// 当前线程的统计
+	Stats::ThreadStats & threadStats() { return rasterFrame->stats.threads[JobSystem::threadIndex()]; }
+	// 当前线程在某一帧中的统计(几何阶段使用)
+	Stats::ThreadStats & threadStats(Frame & frame) { return frame.stats.threads[JobSystem::threadIndex()]; }
+	// 加扫描线锁(开启统计时记录等待)
+	void lockScanline(int y);
 
-	shared_ptr<IntBuffer> currentTexture;   // 当前Mesh使用的纹理
-	ShadeFunc currentShadeFunc;             // 当前Mesh使用的着色函数
+	// 快速清除: 取得分块的写入标识, 返回flags中尚未写入清除值的部分(为0时没有取得标识)
+	unsigned claimTile(int tile, unsigned flags);
+	// 快速清除: 标记cleared已写入并释放标识
+	void releaseTile(int tile, unsigned cleared);
+	// 快速清除: 写入分块中flags指定的、尚未写入的清除值
+	void clearTile(int tile, unsigned flags);
+	// 快速清除: 读写像素前确保所在分块已写入清除值
+	void touchTile(int tile, unsigned flags = TILE_CLEAR_COLOR | TILE_CLEAR_DEPTH) {
+		if (tileClear[tile].load(std::memory_order_acquire) & flags) clearTile(tile, flags);
+	}
+	void touchPixel(int x, int y) { touchTile(y / TILE_SIZE * tileCountX + x / TILE_SIZE); }
+	// 快速清除: 读写扫描线y上[x0, x1]前确保经过的分块已写入清除值
+	void touchSpan(int y, int x0, int x1) {
+		int row = y / TILE_SIZE * tileCountX;
+		for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++) touchTile(row + tx);
+	}
+	// 读取像素颜色(线条抗锯齿混合时使用)
+	int readPixel(int x, int y) {
+		assert(x >= 0 && x < screenWidth && y >= 0 && y < screenHeight);
+		touchPixel(x, y);
+		return colorBuffer->get((size_t)x, (size_t)y);
+	}
 
 	// 画像素点(会检查越界)
 	void drawPixel(int x, int y, const RGBColor & color);
@@ -57,15 +299,49 @@ private:
 	void rasterizeLine(float x0, float y0, float x1, float y1, RGBColor c0, RGBColor c1);
 	// 光栅化反走样直线(Xiaolin Wu's line algorithm)
 	void rasterizeLine_antialiasing(float x0, float y0, float x1, float y1, RGBColor c0, RGBColor c1);
-	// 光栅化扫描线
-	void rasterizeScanline(Scanline & scanline);
+	// 光栅化扫描线(lock指示是否需要加行锁)
+	void rasterizeScanline(Scanline & scanline, const Mesh & mesh, bool lock);
 	// 切割三角形(任意三角形切为平顶三角形和平底三角形)
 	void triangleSpilt(SplitedTriangle & st, const TVertex * v0, const TVertex * v1, const TVertex * v2);
 	// 根据y值将平底（顶）三角形转变为扫描线数据
-	void rasterizeTriangle(const SplitedTriangle & st);
+	void rasterizeTriangle(const SplitedTriangle & st, const Mesh & mesh, const RasterRect & rect, bool lock);
+	// 将扫描线裁剪到矩形的横向范围内
+	void clipScanline(Scanline & scanline, const RasterRect & rect);
+	// 使用边函数光栅化三角形(按块遍历包围盒,整块剔除/接受,属性由平面方程求值)
+	void rasterizeTriangleHalfSpace(const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh, const RasterRect & rect, bool lock);
+	// 使用定点数边函数光栅化三角形(顶点吸附到子像素网格, 按左上规则判定边上的像素)
+	void rasterizeTriangleFixed(const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh, const RasterRect & rect, bool lock);
+	// 按当前的光栅化算法绘制三角形
+	// hiZCounts为调用线程自己的三角形剔除计数, 由调用者在一批三角形结束后一次性累加
+	void drawTriangle(const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh, const RasterRect & rect, bool lock, HiZStats & hiZCounts);
+
+	// 层次Z: 重置所有块(清除深度缓冲时调用)
+	void hiZClear();
+	// 层次Z: 从ZBuffer重新计算块的深度范围(lock为true时逐行加扫描线锁读取)
+	void hiZRefresh(int block, bool lock);
+	// 层次Z: 判断rhw不超过maxRhw的片元在块内是否一定被遮挡
+	bool hiZOccluded(int block, float maxRhw, bool lock);
+	// 层次Z: 记录块内写入了rhw不超过maxRhw的片元
+	void hiZMarkWritten(int block, float maxRhw);
+	// 层次Z: 判断三角形在裁剪矩形内是否整体被遮挡
+	bool hiZTriangleOccluded(const TVertex * v0, const TVertex * v1, const TVertex * v2, const RasterRect & rect, bool lock);
+	// 层次Z: 将三角形包围盒覆盖的块标记为已写入
+	void hiZMarkTriangle(const TVertex * v0, const TVertex * v1, const TVertex * v2, const RasterRect & rect);
+	// 层次Z: 将一个线程的局部计数累加到本帧的剔除计数
+	void hiZAddCounts(const HiZStats & counts);
+
+	// 将三角形分箱到其包围盒覆盖的屏幕分块
+	void binTriangle(Frame & frame, const TVertex * v0, const TVertex * v1, const TVertex * v2, const Mesh & mesh);
+	// 光栅化一个分块内所有分箱的三角形(每个分块只由一个线程处理)
+	void rasterizeTile(int tile);
 
 	// 判断点是否在CVV里面,返回标识位置的码,用于视锥裁剪
 	int checkCVV(const Vector4 & v);
+	// 判断点是否在保护带内,返回超出的x/y裁剪面标识位
+	int checkGuardBand(const Vector4 & v);
+	// 在齐次空间中用planes指定的裁剪面裁剪三角形poly(容量为MAX_CLIP_VERTICES),
+	// 结果转换到屏幕空间写入out, 返回多边形的顶点数(少于3表示被完全裁掉)
+	int clipTriangle(ClipVertex * poly, int planes, TVertex * out);
 	// 坐标归一化,并转换到屏幕空间
 	void transformHomogenize(const Vector4 & src, Vector3 & dst);
 	// 直线剪裁(Liang–Barsky algorithm)
@@ -73,20 +349,137 @@ private:
 
 	// 渲染一条直线
 	void renderLine(const Line & line, const Matrix44 & transform);
-	// 渲染一个mesh
-	void renderMesh(const shared_ptr<Mesh> mesh, const Matrix44 & transform, const Matrix44 & normalMatrix);
+	// 变换Mesh的[begin, end)号顶点(批量变换时按填充后的顶点数计)
+	void transformVertices(MeshTask & task, size_t begin, size_t end);
+	// 裁剪、剔除Mesh的[begin, end)号图元, 并光栅化或分箱
+	void assemblePrimitives(const MeshTask & task, int begin, int end);
+
+	// 任务图: 提交Mesh的顶点变换任务, 最后一个完成的任务提交下一步
+	void spawnMesh(MeshTask & task);
+	// 任务图: 提交Mesh的图元装配任务, onDone在全部完成后调用
+	void spawnPrimitives(MeshTask & task, void (Pipeline::*onDone)(Frame &));
+	// 任务图: 一个Mesh的几何阶段完成, 所有Mesh完成后等待前一帧的光栅化阶段
+	void finishGeometry(Frame & frame);
+	// 任务图: 开始光栅化的一个条件满足, 全部满足后开始光栅化阶段
+	void releaseRaster(Frame & frame);
+	// 任务图: 清除缓冲区, 提交分块光栅化(已分箱时)或各Mesh的图元装配任务
+	void beginRaster(Frame & frame);
+	// 任务图: 光栅化阶段中一个Mesh的图元装配完成, 全部完成后提交分块光栅化(分箱模式)或线条任务
+	void finishAssembly(Frame & frame);
+	// 任务图: 提交分块光栅化任务, 全部完成后提交线条任务
+	void spawnTiles(Frame & frame);
+	// 任务图: 光线追踪模式下代替光栅化, 提交分块追踪任务, 全部完成后提交线条任务
+	void spawnTrace(Frame & frame);
+	// 光线追踪一个分块内的所有像素
+	void traceTile(Frame & frame, int tile);
+	// 追踪一条光线, 命中时返回true并求出颜色(depth为剩余的反射次数)
+	bool traceRay(const Frame & frame, const Ray & ray, int depth, RGBColor & out);
+	// 求出光线与场景的交点处的颜色(及反射), 着色器丢弃时返回false
+	bool shadeHit(const Frame & frame, const Ray & ray, const RayHit & hit, int depth, RGBColor & out);
+	// 路径追踪时判断能否继续累积(否则重新开始), 确定本帧的样本序号
+	void continueAccumulation(Frame & frame);
+	// 交点处插值的法线(世界空间, 未单位化)
+	Vector3 hitNormal(const Frame & frame, const RayHit & hit) const;
+	// 路径追踪一个分块: 每个像素加入pathSamples个样本, 输出累积的平均值
+	void pathTile(Frame & frame, int tile);
+	// 追踪一条路径, 返回其带回的颜色
+	RGBColor tracePath(const Frame & frame, Ray ray, PathRandom & random);
+	// 任务图: 所有三角形光栅化完成后渲染线条(线条不做深度测试, 必须画在三角形之后)
+	void spawnLines(Frame & frame);
+	// 任务图: 线条完成后把从未写入的分块填为清除颜色
+	void resolveFrame(Frame & frame);
+	// 任务图: 光栅化阶段完成, 允许下一帧开始光栅化
+	void finishFrame(Frame & frame);
+	// 提交一帧到frames[slot], 该位置上的帧必须已经完成
+	void submit(const Scene & scene, int slot);
 
 public:
+	// 深度缓冲区与异步渲染的另一个颜色缓冲区使用与renderBuffer相同的内存选项(分配器, 行距补齐)
 	Pipeline(IntBuffer & renderBuffer);
 	~Pipeline();
 
+	// 异步渲染的一帧. wait执行任务直到该帧完成, 返回其颜色缓冲区;
+	// 返回的缓冲区在再提交两帧之前保持不变. 之后该帧的位置被新提交的帧占用, Fence失效:
+	// ready返回true(该帧必然已完成), wait不再等待并返回空
+	class Fence {
+		Pipeline * pipeline;
+		int slot;
+		unsigned serial;
+		friend class Pipeline;
+		Fence(Pipeline * pipeline, int slot, unsigned serial) : pipeline(pipeline), slot(slot), serial(serial) {}
+	public:
+		Fence() : pipeline(nullptr), slot(0), serial(0) {}
+		explicit operator bool() const { return pipeline != nullptr; }
+		// 该帧是否已经完成(不等待)
+		bool ready() const;
+		// 该帧的位置是否已被之后提交的帧占用
+		bool expired() const;
+		const IntBuffer * wait();
+	};
+
+	// 以下设置在进行中的帧完成后才生效(会先等待)
+
 	// 设置渲染状态
-	void setRenderState(RenderState state) { this->renderState = state; }
+	void setRenderState(RenderState state) { finish(); this->renderState = state; }
 	// 设置清除颜色
-	void setClearColor(RGBColor clearColor) { this->clearColor = clearColor; }
+	void setClearColor(RGBColor clearColor) { finish(); this->clearColor = clearColor; }
+	// 设置并行模式
+	void setParallelMode(ParallelMode mode) { finish(); this->parallelMode = mode; }
+	// 设置三角形光栅化算法
+	void setRasterizer(RasterizerType type) { finish(); this->rasterizer = type; }
+	// 设置扫描线填充、顶点变换与光线包求交允许使用的最高指令集(实际使用的指令集由CPUID决定, SCALAR为关闭SIMD)
+	void setSIMD(Simd::Level maxLevel) {
+		finish();
+		this->spanFill = RasterSIMD::select(maxLevel);
+		this->vertexTransform = VertexSIMD::select(maxLevel);
+		this->packetIntersect = RaySIMD::select(maxLevel);
+	}
+	// 设置是否开启层次Z剔除
+	void setHiZ(bool enabled) { finish(); this->hiZEnabled = enabled; }
+	// 设置是否开启快速清除(按分块延迟写入清除值)
+	void setFastClear(bool enabled) { finish(); this->fastClear = enabled; }
+	// 设置颜色/深度缓冲区的分块布局: 8, 16, 32或64像素的正方形分块在内存中连续存放, 0为线性布局.
+	// 分块布局时光栅化到内部的颜色缓冲区, 每帧结束时按分块行并行地复制(还原为线性布局)到渲染缓冲区
+	void setBufferTiling(int tileSize);
+	int getBufferTiling() const { return bufferTiling; }
+	// 设置是否以光线追踪代替光栅化: 每帧对场景构建BVH, 按分块并行追踪主光线与镜面反射(Mesh::reflectivity).
+	// 着色与光栅化相同(颜色, 纹理, 着色器按渲染状态选择, 线框按颜色着色), 线条仍在追踪后光栅化
+	void setRayTracing(bool enabled) { finish(); this->rayTracing = enabled; }
+	bool getRayTracing() const { return rayTracing; }
+	// 设置光线追踪的最大反射次数(0为只追踪主光线; 路径追踪时为主光线之后的最大弹射次数减1)
+	void setRayDepth(int depth) { finish(); this->rayDepth = MAX(depth, 0); accumulation.samples = 0; }
+	// 设置是否渐进式路径追踪: 与光线追踪一样每帧构建BVH, 每次渲染向浮点累积缓冲区的每个像素加入setPathSamples个样本并输出平均值.
+	// 表面按渲染状态的颜色(着色器模式下为着色器的输出)漫反射, 按Mesh::reflectivity的概率镜面反射, 光照来自环境光(setSkyColor).
+	// 场景的摄像机/模型矩阵、Mesh(及其纹理、过滤方式、着色器、反射率)、渲染状态与清除颜色都不变时继续累积, 否则重新开始.
+	// 每个样本的随机数只由种子、像素位置和样本序号决定, 同一种子的结果与线程数和帧流水线无关
+	void setPathTracing(bool enabled) { finish(); this->pathTracing = enabled; accumulation.samples = 0; }
+	bool getPathTracing() const { return pathTracing; }
+	// 设置路径追踪每帧每像素的样本数
+	void setPathSamples(int samples) { finish(); this->pathSamples = MAX(samples, 1); accumulation.samples = 0; }
+	// 设置路径追踪随机数的种子
+	void setPathSeed(unsigned seed) { finish(); this->pathSeed = seed; accumulation.samples = 0; }
+	// 设置路径追踪的环境光颜色
+	void setSkyColor(RGBColor color) { finish(); this->skyColor = color; accumulation.samples = 0; }
+	// 已提交的帧累积的每像素样本数(最近一帧完成后图像中的样本数)
+	int getAccumulatedSamples() const { return accumulation.samples; }
+	// 获取最近等待完成的一帧的层次Z剔除统计
+	const HiZStats & getHiZStats() const { return hiZStats; }
+	// 设置工作线程数(包括调用render的线程), 0为硬件线程数
+	void setThreadCount(int count) { finish(); jobs->setThreadCount(count > 0 ? count : JobSystem::hardwareThreads()); }
+	int getThreadCount() const { return jobs->getThreadCount(); }
+	// 设置是否把工作线程(包括调用render的线程)绑定到固定的CPU
+	void setThreadAffinity(bool pinned) { finish(); jobs->setAffinity(pinned); }
+	// 获取最近等待完成的一帧的分阶段耗时与计数(按线程, 需要以SOFTRENDERER_STATS=1编译)
+	const Stats::FrameStats & getStats() const { return frameStats; }
 	
-	// 渲染一帧
+	// 渲染一帧到renderBuffer, 返回时已完成
 	void render(const Scene & scene);
+	// 异步渲染一帧: 提交后立即返回, 该帧的几何处理可以与前一帧的光栅化同时进行.
+	// 两帧交替渲染到renderBuffer和内部的另一个缓冲区, 结果通过返回的Fence取得.
+	// 已有两帧在处理中时先等待较早的一帧完成
+	Fence renderAsync(const Scene & scene);
+	// 等待所有进行中的帧完成
+	void finish();
 };
 
 #endif
\ No newline at end of file
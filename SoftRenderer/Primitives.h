@@ -6,6 +6,7 @@
 #include "Vector.h"
 #include "Color.h"
 #include "FrameBuffer.h"
+#include "Texture.h"
 
 typedef Vector2 TexCoord;
 
@@ -30,17 +31,9 @@ struct Primitive {
 // 着色函数
 typedef function<
 	bool(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal,
-		const shared_ptr<IntBuffer> & texture, const TexCoord & texCoord)
+		const Sampler & texture, const TexCoord & texCoord)
 > ShadeFunc;
 
-// 三角Mesh
-struct Mesh {
-	vector<Vertex> vertices;
-	vector<Primitive> primitives;
-	shared_ptr<IntBuffer> texture;
-	ShadeFunc shadeFunc;
-};
-
 // 带透视矫正的插值顶点
 struct TVertex {
 	Vector3 point;
@@ -114,9 +107,156 @@ struct TVertex {
 	
 };
 
+// 着色时的一段扫描线
+struct ShadeSpan {
+	int * fbPtr;                // 扫描线起点处的颜色缓冲区
+	float * zbPtr;              // 扫描线起点处的深度缓冲区
+	int count;                  // 像素个数
+	TVertex v0, step;           // 起点的插值顶点与每个像素的插值步进
+	TVertex stepY;              // 每行的插值步进(与step一起求纹理的细节层次)
+	float invW, invH;           // 屏幕宽高的倒数(用于把像素位置归一化到[0, 1))
+	const Texture * texture;    // Mesh使用的纹理(可以为空)
+};
+
+// 由透视校正后的纹理坐标uv(w为1/rhw)及插值顶点(已乘rhw)在屏幕空间x/y方向的步进求细节层次
+inline float textureLod(const Texture & texture, const TexCoord & uv, float w, const TVertex & ddx, const TVertex & ddy) {
+	// d(u) = (d(u * rhw) - u * d(rhw)) / rhw
+	return texture.lod(
+		(ddx.texCoord.x - uv.x * ddx.rhw) * w, (ddx.texCoord.y - uv.y * ddx.rhw) * w,
+		(ddy.texCoord.x - uv.x * ddy.rhw) * w, (ddy.texCoord.y - uv.y * ddy.rhw) * w);
+}
+
+// 对一段扫描线逐像素进行深度测试和着色, shader在实例化时可被内联
+// 纹理使用mipmap过滤时逐像素求细节层次
+template <class T>
+inline void shadeSpanLoop(const ShadeSpan & span, const T & shader) {
+	TVertex vi = span.v0, v;
+	RGBColor c;
+	Vector3 pos;
+	Sampler sampler = { span.texture, 0.f };
+	const bool mipmap = span.texture && span.texture->getFilter() != Texture::POINT;
+	for (int i = 0; i < span.count; i++, vi += span.step) {
+		float rhw = vi.rhw;
+		if (rhw >= span.zbPtr[i]) {  // 使用Z-buffer判断深度是否满足
+			float w = 1.0f / rhw;
+			v = vi * w;
+			pos = vi.point, pos.x *= span.invW, pos.y *= span.invH;
+			if (mipmap) sampler.lod = textureLod(*span.texture, v.texCoord, w, span.step, span.stepY);
+			if (shader(c, pos, v.color, v.normal.NormalizedVector(), sampler, v.texCoord)) {
+				span.fbPtr[i] = c.toRGBInt();
+				span.zbPtr[i] = rhw;
+			}
+		}
+	}
+}
+
+// 着色程序(以扫描线为单位调用,每段扫描线只有一次虚函数调用)
+class ShaderProgram {
+public:
+	virtual ~ShaderProgram() {}
+	virtual void shadeSpan(const ShadeSpan & span) const = 0;
+};
+
+// 静态着色器程序: T需提供
+// bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal,
+//                 const Sampler & texture, const TexCoord & texCoord) const
+// 扫描线循环按T特化, T的着色代码直接内联进循环
+template <class T>
+class StaticShaderProgram : public ShaderProgram {
+	T shader;
+public:
+	StaticShaderProgram(const T & shader) : shader(shader) {}
+	void shadeSpan(const ShadeSpan & span) const override {
+		shadeSpanLoop(span, shader);
+	}
+};
+
+// ShadeFunc适配器,用于临时编写的lambda等着色函数(逐像素间接调用)
+class FunctionShaderProgram : public ShaderProgram {
+	ShadeFunc func;
+public:
+	FunctionShaderProgram(const ShadeFunc & func) : func(func) {}
+	void shadeSpan(const ShadeSpan & span) const override {
+		shadeSpanLoop(span, func);
+	}
+};
+
+// 着色器: 可由静态着色器类型或者ShadeFunc(及可转换为ShadeFunc的lambda)构造
+class Shader {
+	shared_ptr<const ShaderProgram> program;
+
+	template <class T>
+	static shared_ptr<const ShaderProgram> makeProgram(const T & shader, std::true_type) {
+		return make_shared<FunctionShaderProgram>(ShadeFunc(shader));
+	}
+	template <class T>
+	static shared_ptr<const ShaderProgram> makeProgram(const T & shader, std::false_type) {
+		return make_shared<StaticShaderProgram<T>>(shader);
+	}
+
+public:
+	Shader() {}
+	Shader(std::nullptr_t) {}
+	Shader(const ShadeFunc & func) {
+		if (func) program = make_shared<FunctionShaderProgram>(func);
+	}
+	template <class T>
+	Shader(const T & shader) : program(makeProgram(shader, std::is_convertible<T, ShadeFunc>())) {}
+	// 直接使用自定义的着色程序(需要自行处理整段扫描线, 例如统计覆盖次数的调试程序)
+	explicit Shader(const shared_ptr<const ShaderProgram> & program) : program(program) {}
+
+	explicit operator bool() const { return (bool)program; }
+	bool operator==(const Shader & other) const { return program == other.program; }
+	bool operator!=(const Shader & other) const { return program != other.program; }
+	void shadeSpan(const ShadeSpan & span) const { program->shadeSpan(span); }
+};
+
+// 三角Mesh
+// 顶点位置与法线的SoA布局,用于批量SIMD顶点变换
+// 数组长度按BATCH_ALIGN对齐,对齐多出的顶点填0
+struct VertexStreams {
+	static const size_t BATCH_ALIGN = 8;
+
+	vector<float> x, y, z;
+	vector<float> nx, ny, nz;
+	size_t count = 0;           // 实际顶点数
+
+	size_t paddedCount() const { return x.size(); }
+
+	void build(const vector<Vertex> & vertices) {
+		count = vertices.size();
+		size_t padded = (count + BATCH_ALIGN - 1) / BATCH_ALIGN * BATCH_ALIGN;
+		for (vector<float> * s : { &x, &y, &z, &nx, &ny, &nz })
+			s->assign(padded, 0.f);
+		for (size_t i = 0; i < count; i++) {
+			x[i] = vertices[i].point.x;
+			y[i] = vertices[i].point.y;
+			z[i] = vertices[i].point.z;
+			nx[i] = vertices[i].normal.x;
+			ny[i] = vertices[i].normal.y;
+			nz[i] = vertices[i].normal.z;
+		}
+	}
+};
+
+struct Mesh {
+	vector<Vertex> vertices;
+	vector<Primitive> primitives;
+	shared_ptr<Texture> texture;
+	Shader shader;
+	float reflectivity = 0.f;   // 光线追踪时镜面反射所占的比例(0为不反射, 光栅化时不使用)
+	// 可选的SoA顶点数据,存在且与vertices数量一致时使用批量SIMD变换
+	// 适合顶点不再改变的静态Mesh, 修改vertices后需要重新调用buildStreams
+	VertexStreams streams;
+
+	void buildStreams() { streams.build(vertices); }
+	bool hasStreams() const { return streams.count == vertices.size() && streams.count > 0; }
+};
+
 // 单根扫描线(横向)
 struct Scanline {
 	TVertex v0, step;
+	TVertex stepY;              // 三角形的属性每行的步进(用于求纹理的细节层次)
 	int x0, x1, y;
 };
 
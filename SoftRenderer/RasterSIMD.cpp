@@ -0,0 +1,194 @@
+#include "RasterSIMD.h"
+
+// 纹理坐标转换为纹素下标,与 FrameBuffer::get(float, float) 的取模行为一致
+static inline int texelCoord(float t, int size) {
+	return (int)((size_t)(Math::fract(t) * size) % size);
+}
+
+// 标量处理单个像素,用于SSE2路径处理不足一组的剩余像素
+static inline void fillPixel(const SpanFill & s, int i) {
+	const TVertex & v0 = *s.v0, & st = *s.step;
+	float k = (float)(s.first + i);
+	float rhw = v0.rhw + st.rhw * k;
+	if (rhw < s.zbPtr[i])
+		return;
+
+	float w = 1.0f / rhw;
+	RGBColor c((v0.color.r + st.color.r * k) * w, (v0.color.g + st.color.g * k) * w, (v0.color.b + st.color.b * k) * w);
+	int rgb;
+	if (s.texels) {
+		int tx = texelCoord((v0.texCoord.x + st.texCoord.x * k) * w, s.texWidth);
+		int ty = texelCoord((v0.texCoord.y + st.texCoord.y * k) * w, s.texHeight);
+		int texel = s.texels[ty * s.texWidth + tx];
+		if (s.color) {
+			RGBColor t;
+			t.setRGBInt(texel);
+			rgb = (t *= c).toRGBInt();
+		} else {
+			rgb = texel & 0xFFFFFF;
+		}
+	} else {
+		rgb = c.toRGBInt();
+	}
+	s.fbPtr[i] = rgb;
+	s.zbPtr[i] = rhw;
+}
+
+////          SSE2          ////
+
+// [0,1)小数部分乘以尺寸后转为下标,越界(fract舍入为1.0或非法值)时回绕到0
+static inline __m128i texelCoord_SSE2(__m128 t, __m128 size, __m128i isize) {
+	__m128 fl = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+	fl = _mm_sub_ps(fl, _mm_and_ps(_mm_cmpgt_ps(fl, t), _mm_set1_ps(1.0f)));
+	__m128i i = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(t, fl), size));
+	__m128i valid = _mm_andnot_si128(_mm_cmplt_epi32(i, _mm_setzero_si128()), _mm_cmplt_epi32(i, isize));
+	return _mm_and_si128(i, valid);
+}
+
+// 与 RGBColor::toRGBInt 相同的量化与打包
+static inline __m128i packColor_SSE2(__m128 r, __m128 g, __m128 b) {
+	const __m128 c255 = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+	__m128i ir = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(r, c255), half), zero), c255));
+	__m128i ig = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(g, c255), half), zero), c255));
+	__m128i ib = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(b, c255), half), zero), c255));
+	return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(ir, 16), _mm_slli_epi32(ig, 8)), ib);
+}
+
+static inline __m128 channel_SSE2(__m128i texel, int shift) {
+	__m128i c = _mm_and_si128(_mm_srli_epi32(texel, shift), _mm_set1_epi32(0xFF));
+	return _mm_div_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(255.0f));
+}
+
+void RasterSIMD::fillSpan_SSE2(const SpanFill & s) {
+	const TVertex & v0 = *s.v0, & st = *s.step;
+	const __m128 lane = _mm_set_ps(3, 2, 1, 0);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 texW = _mm_set1_ps((float)s.texWidth), texH = _mm_set1_ps((float)s.texHeight);
+	const __m128i itexW = _mm_set1_epi32(s.texWidth), itexH = _mm_set1_epi32(s.texHeight);
+
+	int i = 0;
+	for (; i + 4 <= s.count; i += 4) {
+		__m128 k = _mm_add_ps(_mm_set1_ps((float)(s.first + i)), lane);
+		__m128 rhw = _mm_add_ps(_mm_set1_ps(v0.rhw), _mm_mul_ps(_mm_set1_ps(st.rhw), k));
+		__m128 zb = _mm_loadu_ps(s.zbPtr + i);
+		__m128 mask = _mm_cmpge_ps(rhw, zb);
+		int bits = _mm_movemask_ps(mask);
+		if (bits == 0)
+			continue;
+
+		// 透视除法
+		__m128 w = _mm_div_ps(one, rhw);
+		__m128 r = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(v0.color.r), _mm_mul_ps(_mm_set1_ps(st.color.r), k)), w);
+		__m128 g = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(v0.color.g), _mm_mul_ps(_mm_set1_ps(st.color.g), k)), w);
+		__m128 b = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(v0.color.b), _mm_mul_ps(_mm_set1_ps(st.color.b), k)), w);
+
+		__m128i rgb;
+		if (s.texels) {
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(v0.texCoord.x), _mm_mul_ps(_mm_set1_ps(st.texCoord.x), k)), w);
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(v0.texCoord.y), _mm_mul_ps(_mm_set1_ps(st.texCoord.y), k)), w);
+			alignas(16) int tx[4], ty[4], texel[4];
+			_mm_store_si128((__m128i *)tx, texelCoord_SSE2(u, texW, itexW));
+			_mm_store_si128((__m128i *)ty, texelCoord_SSE2(v, texH, itexH));
+			// SSE2没有gather,只读取通过深度测试的像素
+			for (int j = 0; j < 4; j++)
+				texel[j] = (bits >> j & 1) ? s.texels[ty[j] * s.texWidth + tx[j]] : 0;
+			rgb = _mm_load_si128((const __m128i *)texel);
+			if (s.color)
+				rgb = packColor_SSE2(_mm_mul_ps(channel_SSE2(rgb, 16), r), _mm_mul_ps(channel_SSE2(rgb, 8), g), _mm_mul_ps(channel_SSE2(rgb, 0), b));
+			else
+				rgb = _mm_and_si128(rgb, _mm_set1_epi32(0xFFFFFF));
+		} else {
+			rgb = packColor_SSE2(r, g, b);
+		}
+
+		// 按深度测试的结果写入
+		__m128i m = _mm_castps_si128(mask);
+		__m128i old = _mm_loadu_si128((const __m128i *)(s.fbPtr + i));
+		_mm_storeu_si128((__m128i *)(s.fbPtr + i), _mm_or_si128(_mm_and_si128(m, rgb), _mm_andnot_si128(m, old)));
+		_mm_storeu_ps(s.zbPtr + i, _mm_or_ps(_mm_and_ps(mask, rhw), _mm_andnot_ps(mask, zb)));
+	}
+	for (; i < s.count; i++)
+		fillPixel(s, i);
+}
+
+////          AVX2          ////
+
+SIMD_TARGET_AVX2
+static inline __m256i texelCoord_AVX2(__m256 t, __m256 size, __m256i isize) {
+	__m256 f = _mm256_sub_ps(t, _mm256_floor_ps(t));
+	__m256i i = _mm256_cvttps_epi32(_mm256_mul_ps(f, size));
+	__m256i valid = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), i), _mm256_cmpgt_epi32(isize, i));
+	return _mm256_and_si256(i, valid);
+}
+
+SIMD_TARGET_AVX2
+static inline __m256i packColor_AVX2(__m256 r, __m256 g, __m256 b) {
+	const __m256 c255 = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f), zero = _mm256_setzero_ps();
+	__m256i ir = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(r, c255), half), zero), c255));
+	__m256i ig = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(g, c255), half), zero), c255));
+	__m256i ib = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(b, c255), half), zero), c255));
+	return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(ir, 16), _mm256_slli_epi32(ig, 8)), ib);
+}
+
+SIMD_TARGET_AVX2
+static inline __m256 channel_AVX2(__m256i texel, int shift) {
+	__m256i c = _mm256_and_si256(_mm256_srli_epi32(texel, shift), _mm256_set1_epi32(0xFF));
+	return _mm256_div_ps(_mm256_cvtepi32_ps(c), _mm256_set1_ps(255.0f));
+}
+
+SIMD_TARGET_AVX2
+void RasterSIMD::fillSpan_AVX2(const SpanFill & s) {
+	const TVertex & v0 = *s.v0, & st = *s.step;
+	const __m256i ilane = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	const __m256 lane = _mm256_cvtepi32_ps(ilane);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 texW = _mm256_set1_ps((float)s.texWidth), texH = _mm256_set1_ps((float)s.texHeight);
+	const __m256i itexW = _mm256_set1_epi32(s.texWidth), itexH = _mm256_set1_epi32(s.texHeight);
+
+	// 剩余不足8个像素时用掩码读写,避免在AVX代码中调用标量函数产生SSE/AVX切换开销
+	for (int i = 0; i < s.count; i += 8) {
+		__m256i live = _mm256_cmpgt_epi32(_mm256_set1_epi32(s.count - i), ilane);
+		__m256 k = _mm256_add_ps(_mm256_set1_ps((float)(s.first + i)), lane);
+		__m256 rhw = _mm256_add_ps(_mm256_set1_ps(v0.rhw), _mm256_mul_ps(_mm256_set1_ps(st.rhw), k));
+		__m256 zb = _mm256_maskload_ps(s.zbPtr + i, live);
+		__m256 mask = _mm256_and_ps(_mm256_cmp_ps(rhw, zb, _CMP_GE_OQ), _mm256_castsi256_ps(live));
+		if (_mm256_movemask_ps(mask) == 0)
+			continue;
+
+		// 透视除法
+		__m256 w = _mm256_div_ps(one, rhw);
+		__m256 r = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(v0.color.r), _mm256_mul_ps(_mm256_set1_ps(st.color.r), k)), w);
+		__m256 g = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(v0.color.g), _mm256_mul_ps(_mm256_set1_ps(st.color.g), k)), w);
+		__m256 b = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(v0.color.b), _mm256_mul_ps(_mm256_set1_ps(st.color.b), k)), w);
+
+		__m256i m = _mm256_castps_si256(mask);
+		__m256i rgb;
+		if (s.texels) {
+			__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(v0.texCoord.x), _mm256_mul_ps(_mm256_set1_ps(st.texCoord.x), k)), w);
+			__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(v0.texCoord.y), _mm256_mul_ps(_mm256_set1_ps(st.texCoord.y), k)), w);
+			__m256i tx = texelCoord_AVX2(u, texW, itexW);
+			__m256i ty = texelCoord_AVX2(v, texH, itexH);
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(ty, itexW), tx);
+			// 只读取通过深度测试的像素
+			rgb = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), s.texels, index, m, 4);
+			if (s.color)
+				rgb = packColor_AVX2(_mm256_mul_ps(channel_AVX2(rgb, 16), r), _mm256_mul_ps(channel_AVX2(rgb, 8), g), _mm256_mul_ps(channel_AVX2(rgb, 0), b));
+			else
+				rgb = _mm256_and_si256(rgb, _mm256_set1_epi32(0xFFFFFF));
+		} else {
+			rgb = packColor_AVX2(r, g, b);
+		}
+
+		// 按深度测试的结果写入
+		_mm256_maskstore_epi32(s.fbPtr + i, m, rgb);
+		_mm256_maskstore_ps(s.zbPtr + i, m, rhw);
+	}
+}
+
+SpanFillFunc RasterSIMD::select(Simd::Level maxLevel) {
+	switch (MIN(Simd::level(), maxLevel)) {
+	case Simd::AVX2: return fillSpan_AVX2;
+	case Simd::SSE2: return fillSpan_SSE2;
+	default: return nullptr;
+	}
+}
\ No newline at end of file
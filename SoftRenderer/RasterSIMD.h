@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef _RASTERSIMD_H_
+#define _RASTERSIMD_H_
+
+#include "Primitives.h"
+#include "Simd.h"
+
+// 非着色模式(颜色/纹理)下批量填充一段扫描线所需的数据
+struct SpanFill {
+	int * fbPtr;                // 扫描线起点处的颜色缓冲区
+	float * zbPtr;              // 扫描线起点处的深度缓冲区
+	int count;                  // 像素个数
+	const TVertex * v0;         // 起点的插值顶点
+	int first;                  // 第一个像素相对v0的步数(扫描线被切成多段时后续段不为0)
+	const TVertex * step;       // 每个像素的插值步进
+	const int * texels;         // 纹理数据(没有纹理时为空)
+	int texWidth, texHeight;    // 纹理尺寸
+	bool color;                 // 是否使用顶点颜色
+};
+
+typedef void(*SpanFillFunc)(const SpanFill & span);
+
+namespace RasterSIMD {
+	// 每次处理4个像素(SSE2)
+	void fillSpan_SSE2(const SpanFill & span);
+	// 每次处理8个像素(AVX2)
+	void fillSpan_AVX2(const SpanFill & span);
+
+	// 根据CPUID选择不超过maxLevel的最快实现,返回空时使用标量路径
+	SpanFillFunc select(Simd::Level maxLevel = Simd::AVX2);
+}
+
+#endif
\ No newline at end of file
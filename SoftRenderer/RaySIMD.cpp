@@ -0,0 +1,307 @@
+#include "RaySIMD.h"
+
+#include <cfloat>
+
+// 光线包的遍历: 一组光线从根节点一起向下, 只要有一条光线与子节点相交就进入该子节点, 叶子中每个三角形同时与包围盒测试通过的光线求交.
+// 求交的运算与 BVH::intersect 逐位相同, 只有访问节点的顺序不同
+
+////          SSE2          ////
+
+namespace {
+	// 4条光线, 方向的倒数用于与包围盒求交
+	struct Rays_SSE2 {
+		__m128 ox, oy, oz;
+		__m128 dx, dy, dz;
+		__m128 ix, iy, iz;
+		__m128 tMin;
+	};
+
+	inline __m128 select_SSE2(__m128 mask, __m128 a, __m128 b) {
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline float minLane_SSE2(__m128 v) {
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	// 与 BVH::intersect 相同: -0转为+0后求倒数
+	inline __m128 inverse_SSE2(__m128 d) {
+		return _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(d, _mm_setzero_ps()));
+	}
+
+	// 包围盒与各光线求交, 返回相交的光线的掩码, near为进入的距离
+	inline __m128 intersectBox_SSE2(const BVH::Node & node, const Rays_SSE2 & r, __m128 tMax, __m128 & near) {
+		__m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[0]), r.ox), r.ix), tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[0]), r.ox), r.ix);
+		__m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[1]), r.oy), r.iy), ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[1]), r.oy), r.iy);
+		__m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[2]), r.oz), r.iz), tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[2]), r.oz), r.iz);
+		// 参数顺序与 BVH::intersect 相同, 忽略光线在面所在平面上时的NaN
+		near = _mm_max_ps(_mm_min_ps(tx1, tx0), _mm_max_ps(_mm_min_ps(ty1, ty0), _mm_max_ps(_mm_min_ps(tz1, tz0), r.tMin)));
+		__m128 far = _mm_min_ps(_mm_max_ps(tx0, tx1), _mm_min_ps(_mm_max_ps(ty0, ty1), _mm_min_ps(_mm_max_ps(tz0, tz1), tMax)));
+		return _mm_cmple_ps(near, far);
+	}
+
+	// Moller-Trumbore: 一个三角形与active中的光线, 更近的交点写入tMax, u, v, triangle
+	inline void intersectTriangle_SSE2(const BVH::Triangle & tri, int index, const Rays_SSE2 & r, __m128 active,
+		__m128 & tMax, __m128 & u, __m128 & v, __m128 & triangle) {
+		const __m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y), e1z = _mm_set1_ps(tri.e1.z);
+		const __m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y), e2z = _mm_set1_ps(tri.e2.z);
+		__m128 px = _mm_sub_ps(_mm_mul_ps(r.dy, e2z), _mm_mul_ps(r.dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(r.dz, e2x), _mm_mul_ps(r.dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(r.dx, e2y), _mm_mul_ps(r.dy, e2x));
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		__m128 valid = _mm_and_ps(active, _mm_cmpgt_ps(det, _mm_set1_ps(1e-9f)));
+		if (!_mm_movemask_ps(valid))
+			return;
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+		__m128 sx = _mm_sub_ps(r.ox, _mm_set1_ps(tri.p0.x)), sy = _mm_sub_ps(r.oy, _mm_set1_ps(tri.p0.y)), sz = _mm_sub_ps(r.oz, _mm_set1_ps(tri.p0.z));
+		__m128 hu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(hu, _mm_setzero_ps()), _mm_cmple_ps(hu, _mm_set1_ps(1.f))));
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		__m128 hv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r.dx, qx), _mm_mul_ps(r.dy, qy)), _mm_mul_ps(r.dz, qz)), invDet);
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(hv, _mm_setzero_ps()), _mm_cmple_ps(_mm_add_ps(hu, hv), _mm_set1_ps(1.f))));
+		__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, r.tMin), _mm_cmplt_ps(t, tMax)));
+		if (!_mm_movemask_ps(valid))
+			return;
+		tMax = select_SSE2(valid, t, tMax);
+		u = select_SSE2(valid, hu, u);
+		v = select_SSE2(valid, hv, v);
+		triangle = select_SSE2(valid, _mm_castsi128_ps(_mm_set1_epi32(index)), triangle);
+	}
+
+	// 遍历packet中从base开始的4条光线
+	void traverse_SSE2(const BVH & bvh, const RayPacket & packet, int base, RayHit * hits) {
+		const __m128 infinity = _mm_set1_ps(FLT_MAX);
+		Rays_SSE2 r;
+		r.ox = _mm_loadu_ps(packet.ox + base);
+		r.oy = _mm_loadu_ps(packet.oy + base);
+		r.oz = _mm_loadu_ps(packet.oz + base);
+		r.dx = _mm_loadu_ps(packet.dx + base);
+		r.dy = _mm_loadu_ps(packet.dy + base);
+		r.dz = _mm_loadu_ps(packet.dz + base);
+		r.ix = inverse_SSE2(r.dx);
+		r.iy = inverse_SSE2(r.dy);
+		r.iz = inverse_SSE2(r.dz);
+		r.tMin = _mm_loadu_ps(packet.tMin + base);
+		__m128 tMax = _mm_loadu_ps(packet.tMax + base);
+		__m128 u = _mm_setzero_ps(), v = _mm_setzero_ps(), triangle = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		// BVH构建时保证叶子不超过第MAX_DEPTH - 1层, 栈中最多为每个祖先保存一个子节点, 不会溢出
+		int stack[BVH::MAX_DEPTH];
+		int top = 0;
+		const BVH::Node * node = &bvh.node(0);
+		__m128 near, nearRight, active;
+		// tMin > tMax的光线在包围盒测试中总是不相交
+		if (bvh.triangleCount() && _mm_movemask_ps(active = intersectBox_SSE2(*node, r, tMax, near))) {
+			for (;;) {
+				if (node->count) {
+					for (int i = node->first, end = node->first + node->count; i < end; i++)
+						intersectTriangle_SSE2(bvh.triangle(i), i, r, active, tMax, u, v, triangle);
+				} else {
+					const BVH::Node * left = &bvh.node(node->first), * right = left + 1;
+					__m128 hitLeft = intersectBox_SSE2(*left, r, tMax, near);
+					__m128 hitRight = intersectBox_SSE2(*right, r, tMax, nearRight);
+					int ml = _mm_movemask_ps(hitLeft), mr = _mm_movemask_ps(hitRight);
+					if (ml && mr) {
+						// 两个子节点都有光线进入时, 先进入所有光线中进入距离最近的一个
+						if (minLane_SSE2(select_SSE2(hitLeft, near, infinity)) > minLane_SSE2(select_SSE2(hitRight, nearRight, infinity))) {
+							std::swap(left, right);
+							std::swap(hitLeft, hitRight);
+						}
+						assert(top < BVH::MAX_DEPTH);
+						stack[top++] = (int)(right - &bvh.node(0));
+						node = left;
+						active = hitLeft;
+						continue;
+					}
+					if (ml | mr) {
+						node = ml ? left : right;
+						active = ml ? hitLeft : hitRight;
+						continue;
+					}
+				}
+				// 出栈时跳过所有光线都已有更近交点的节点
+				bool found = false;
+				while (top > 0) {
+					node = &bvh.node(stack[--top]);
+					if (_mm_movemask_ps(active = intersectBox_SSE2(*node, r, tMax, near))) {
+						found = true;
+						break;
+					}
+				}
+				if (!found)
+					break;
+			}
+		}
+
+		float ts[4], us[4], vs[4];
+		int triangles[4];
+		_mm_storeu_ps(ts, tMax);
+		_mm_storeu_ps(us, u);
+		_mm_storeu_ps(vs, v);
+		_mm_storeu_si128((__m128i *)triangles, _mm_castps_si128(triangle));
+		for (int i = 0; i < 4; i++)
+			hits[base + i] = RayHit{ ts[i], us[i], vs[i], triangles[i] };
+	}
+}
+
+void RaySIMD::intersect_SSE2(const BVH & bvh, const RayPacket & packet, RayHit * hits) {
+	for (int base = 0; base < RayPacket::SIZE; base += 4)
+		traverse_SSE2(bvh, packet, base, hits);
+}
+
+////          AVX2          ////
+
+// 不使用FMA: 融合乘加的舍入与 BVH::intersect 不同
+#ifdef _MSC_VER
+#define RAY_TARGET_AVX2
+#else
+#define RAY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+	struct Rays_AVX2 {
+		__m256 ox, oy, oz;
+		__m256 dx, dy, dz;
+		__m256 ix, iy, iz;
+		__m256 tMin;
+	};
+
+	RAY_TARGET_AVX2
+	inline float minLane_AVX2(__m256 v) {
+		__m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+		m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(m);
+	}
+
+	RAY_TARGET_AVX2
+	inline __m256 inverse_AVX2(__m256 d) {
+		return _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(d, _mm256_setzero_ps()));
+	}
+
+	RAY_TARGET_AVX2
+	inline __m256 intersectBox_AVX2(const BVH::Node & node, const Rays_AVX2 & r, __m256 tMax, __m256 & near) {
+		__m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min[0]), r.ox), r.ix), tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max[0]), r.ox), r.ix);
+		__m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min[1]), r.oy), r.iy), ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max[1]), r.oy), r.iy);
+		__m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min[2]), r.oz), r.iz), tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max[2]), r.oz), r.iz);
+		near = _mm256_max_ps(_mm256_min_ps(tx1, tx0), _mm256_max_ps(_mm256_min_ps(ty1, ty0), _mm256_max_ps(_mm256_min_ps(tz1, tz0), r.tMin)));
+		__m256 far = _mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_min_ps(_mm256_max_ps(ty0, ty1), _mm256_min_ps(_mm256_max_ps(tz0, tz1), tMax)));
+		return _mm256_cmp_ps(near, far, _CMP_LE_OQ);
+	}
+
+	RAY_TARGET_AVX2
+	inline void intersectTriangle_AVX2(const BVH::Triangle & tri, int index, const Rays_AVX2 & r, __m256 active,
+		__m256 & tMax, __m256 & u, __m256 & v, __m256 & triangle) {
+		const __m256 e1x = _mm256_set1_ps(tri.e1.x), e1y = _mm256_set1_ps(tri.e1.y), e1z = _mm256_set1_ps(tri.e1.z);
+		const __m256 e2x = _mm256_set1_ps(tri.e2.x), e2y = _mm256_set1_ps(tri.e2.y), e2z = _mm256_set1_ps(tri.e2.z);
+		__m256 px = _mm256_sub_ps(_mm256_mul_ps(r.dy, e2z), _mm256_mul_ps(r.dz, e2y));
+		__m256 py = _mm256_sub_ps(_mm256_mul_ps(r.dz, e2x), _mm256_mul_ps(r.dx, e2z));
+		__m256 pz = _mm256_sub_ps(_mm256_mul_ps(r.dx, e2y), _mm256_mul_ps(r.dy, e2x));
+		__m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+		__m256 valid = _mm256_and_ps(active, _mm256_cmp_ps(det, _mm256_set1_ps(1e-9f), _CMP_GT_OQ));
+		if (!_mm256_movemask_ps(valid))
+			return;
+		__m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.f), det);
+		__m256 sx = _mm256_sub_ps(r.ox, _mm256_set1_ps(tri.p0.x)), sy = _mm256_sub_ps(r.oy, _mm256_set1_ps(tri.p0.y)), sz = _mm256_sub_ps(r.oz, _mm256_set1_ps(tri.p0.z));
+		__m256 hu = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), invDet);
+		valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(hu, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(hu, _mm256_set1_ps(1.f), _CMP_LE_OQ)));
+		__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+		__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+		__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+		__m256 hv = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r.dx, qx), _mm256_mul_ps(r.dy, qy)), _mm256_mul_ps(r.dz, qz)), invDet);
+		valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(hv, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(hu, hv), _mm256_set1_ps(1.f), _CMP_LE_OQ)));
+		__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+		valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, r.tMin, _CMP_GT_OQ), _mm256_cmp_ps(t, tMax, _CMP_LT_OQ)));
+		if (!_mm256_movemask_ps(valid))
+			return;
+		tMax = _mm256_blendv_ps(tMax, t, valid);
+		u = _mm256_blendv_ps(u, hu, valid);
+		v = _mm256_blendv_ps(v, hv, valid);
+		triangle = _mm256_blendv_ps(triangle, _mm256_castsi256_ps(_mm256_set1_epi32(index)), valid);
+	}
+}
+
+RAY_TARGET_AVX2
+void RaySIMD::intersect_AVX2(const BVH & bvh, const RayPacket & packet, RayHit * hits) {
+	const __m256 infinity = _mm256_set1_ps(FLT_MAX);
+	Rays_AVX2 r;
+	r.ox = _mm256_loadu_ps(packet.ox);
+	r.oy = _mm256_loadu_ps(packet.oy);
+	r.oz = _mm256_loadu_ps(packet.oz);
+	r.dx = _mm256_loadu_ps(packet.dx);
+	r.dy = _mm256_loadu_ps(packet.dy);
+	r.dz = _mm256_loadu_ps(packet.dz);
+	r.ix = inverse_AVX2(r.dx);
+	r.iy = inverse_AVX2(r.dy);
+	r.iz = inverse_AVX2(r.dz);
+	r.tMin = _mm256_loadu_ps(packet.tMin);
+	__m256 tMax = _mm256_loadu_ps(packet.tMax);
+	__m256 u = _mm256_setzero_ps(), v = _mm256_setzero_ps(), triangle = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+	// 与SSE2版本相同, 栈的深度由BVH构建时的深度限制保证
+	int stack[BVH::MAX_DEPTH];
+	int top = 0;
+	const BVH::Node * node = &bvh.node(0);
+	__m256 near, nearRight, active;
+	if (bvh.triangleCount() && _mm256_movemask_ps(active = intersectBox_AVX2(*node, r, tMax, near))) {
+		for (;;) {
+			if (node->count) {
+				for (int i = node->first, end = node->first + node->count; i < end; i++)
+					intersectTriangle_AVX2(bvh.triangle(i), i, r, active, tMax, u, v, triangle);
+			} else {
+				const BVH::Node * left = &bvh.node(node->first), * right = left + 1;
+				__m256 hitLeft = intersectBox_AVX2(*left, r, tMax, near);
+				__m256 hitRight = intersectBox_AVX2(*right, r, tMax, nearRight);
+				int ml = _mm256_movemask_ps(hitLeft), mr = _mm256_movemask_ps(hitRight);
+				if (ml && mr) {
+					if (minLane_AVX2(_mm256_blendv_ps(infinity, near, hitLeft)) > minLane_AVX2(_mm256_blendv_ps(infinity, nearRight, hitRight))) {
+						std::swap(left, right);
+						std::swap(hitLeft, hitRight);
+					}
+					assert(top < BVH::MAX_DEPTH);
+					stack[top++] = (int)(right - &bvh.node(0));
+					node = left;
+					active = hitLeft;
+					continue;
+				}
+				if (ml | mr) {
+					node = ml ? left : right;
+					active = ml ? hitLeft : hitRight;
+					continue;
+				}
+			}
+			bool found = false;
+			while (top > 0) {
+				node = &bvh.node(stack[--top]);
+				if (_mm256_movemask_ps(active = intersectBox_AVX2(*node, r, tMax, near))) {
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+				break;
+		}
+	}
+
+	float ts[8], us[8], vs[8];
+	int triangles[8];
+	_mm256_storeu_ps(ts, tMax);
+	_mm256_storeu_ps(us, u);
+	_mm256_storeu_ps(vs, v);
+	_mm256_storeu_si256((__m256i *)triangles, _mm256_castps_si256(triangle));
+	for (int i = 0; i < 8; i++)
+		hits[i] = RayHit{ ts[i], us[i], vs[i], triangles[i] };
+}
+
+PacketIntersectFunc RaySIMD::select(Simd::Level maxLevel) {
+	switch (MIN(Simd::level(), maxLevel)) {
+	case Simd::AVX2: return intersect_AVX2;
+	case Simd::SSE2: return intersect_SSE2;
+	default: return nullptr;
+	}
+}
\ No newline at end of file
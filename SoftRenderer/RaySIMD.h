@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef _RAYSIMD_H_
+#define _RAYSIMD_H_
+
+#include "RayTracer.h"
+#include "Simd.h"
+
+// 一组光线(按分量存放), 共用一次BVH遍历, 适合方向相近的光线(如相邻像素的主光线)
+struct RayPacket {
+	static const int SIZE = 8;
+	float ox[SIZE], oy[SIZE], oz[SIZE];
+	float dx[SIZE], dy[SIZE], dz[SIZE];
+	float tMin[SIZE], tMax[SIZE];   // tMin > tMax的光线不参与求交
+
+	void set(int i, const Ray & ray) {
+		ox[i] = ray.origin.x; oy[i] = ray.origin.y; oz[i] = ray.origin.z;
+		dx[i] = ray.dir.x; dy[i] = ray.dir.y; dz[i] = ray.dir.z;
+		tMin[i] = ray.tMin; tMax[i] = ray.tMax;
+	}
+	// 第i条光线不参与求交(光线数不足SIZE时填充)
+	void disable(int i) {
+		ox[i] = oy[i] = oz[i] = 0.f;
+		dx[i] = dy[i] = dz[i] = 1.f;
+		tMin[i] = 1.f; tMax[i] = 0.f;
+	}
+};
+
+// 求一组光线各自的最近交点, 结果与逐条调用BVH::intersect相同(距离相等的交点可能是另一个三角形)
+typedef void(*PacketIntersectFunc)(const BVH & bvh, const RayPacket & packet, RayHit * hits);
+
+namespace RaySIMD {
+	// 每4条光线一起遍历(SSE2), 一组光线分两次遍历
+	void intersect_SSE2(const BVH & bvh, const RayPacket & packet, RayHit * hits);
+	// 8条光线一起遍历(AVX2)
+	void intersect_AVX2(const BVH & bvh, const RayPacket & packet, RayHit * hits);
+
+	// 根据CPUID选择不超过maxLevel的最快实现,返回空时逐条光线求交
+	PacketIntersectFunc select(Simd::Level maxLevel = Simd::AVX2);
+}
+
+#endif
\ No newline at end of file
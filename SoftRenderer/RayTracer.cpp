@@ -0,0 +1,362 @@
+#include "RayTracer.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+	inline float surfaceArea(__m128 min, __m128 max) {
+		float d[4];
+		_mm_storeu_ps(d, _mm_sub_ps(max, min));
+		return 2.f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+	}
+
+	// 三角形中心(的2倍): 去掉min中w分量存放的序号, 避免按浮点数运算
+	inline __m128 center(const BVH::Reference & r) {
+		static const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		return _mm_add_ps(_mm_and_ps(r.min, xyz), r.max);
+	}
+
+	inline void grow(BVH::Bounds & bounds, const BVH::Reference & r, __m128 c) {
+		bounds.min = _mm_min_ps(bounds.min, r.min);
+		bounds.max = _mm_max_ps(bounds.max, r.max);
+		bounds.cmin = _mm_min_ps(bounds.cmin, c);
+		bounds.cmax = _mm_max_ps(bounds.cmax, c);
+	}
+
+	inline BVH::Bounds emptyBounds() {
+		__m128 lo = _mm_set1_ps(FLT_MAX), hi = _mm_set1_ps(-FLT_MAX);
+		return BVH::Bounds{ lo, hi, lo, hi };
+	}
+
+	inline float lane(__m128 v, int i) {
+		float f[4];
+		_mm_storeu_ps(f, v);
+		return f[i];
+	}
+
+	// 方向分量的倒数: -0转为+0, 为0的分量总是得到+无穷(包围盒求交时按此处理NaN)
+	inline float inverse(float d) {
+		return 1.f / (d + 0.f);
+	}
+
+	// 光线与包围盒求交, 返回进入的距离, 不相交或在(tMin, tMax)之外时返回FLT_MAX.
+	// 光线在某个面所在的平面上时该轴得到0 * 无穷 = NaN, MIN/MAX的比较为假时取第二个参数, 按下面的顺序NaN总被忽略(该轴不限制范围)
+	inline float intersectBox(const BVH::Node & node, const Vector3 & origin, const Vector3 & invDir, float tMin, float tMax) {
+		float tx0 = (node.min[0] - origin.x) * invDir.x, tx1 = (node.max[0] - origin.x) * invDir.x;
+		float ty0 = (node.min[1] - origin.y) * invDir.y, ty1 = (node.max[1] - origin.y) * invDir.y;
+		float tz0 = (node.min[2] - origin.z) * invDir.z, tz1 = (node.max[2] - origin.z) * invDir.z;
+		float t0 = MAX(MIN(tx1, tx0), MAX(MIN(ty1, ty0), MAX(MIN(tz1, tz0), tMin)));
+		float t1 = MIN(MAX(tx0, tx1), MIN(MAX(ty0, ty1), MIN(MAX(tz0, tz1), tMax)));
+		return t0 <= t1 ? t0 : FLT_MAX;
+	}
+}
+
+void BVH::build(const Scene & scene, JobSystem & jobs, JobSystem::Group & group, const function<void()> & done) {
+	this->jobs = &jobs;
+	this->group = &group;
+	onBuilt = done;
+
+	// 每个Mesh的三角形在unordered中的起点
+	int meshCount = (int)scene.meshes.size();
+	meshFirst.resize(meshCount);
+	int count = 0;
+	for (int i = 0; i < meshCount; i++) {
+		meshFirst[i] = count;
+		count += (int)scene.meshes[i]->primitives.size();
+	}
+	unordered.resize(count);
+	references.resize(count);
+	// 每次划分产生两个节点, n个三角形最多2n - 1个节点
+	nodes.resize(MAX(2 * count - 1, 1));
+	nodeCount = 1;
+
+	if (count == 0) {
+		nodes[0] = Node{ { 0, 0, 0 }, 0, { 0, 0, 0 }, 0 };
+		triangles.clear();
+		finishBuild();
+		return;
+	}
+
+	// 各Mesh的三角形并行变换到世界空间, 全部完成后从根节点开始构建
+	pending = meshCount;
+	jobs.parallelFor(group, meshCount, 1, [this, &scene, count](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			prepareMesh(scene, i, meshFirst[i]);
+		if (--pending == 0) {
+			pending = 1;
+			TRACE_SCOPE("bvh_build");
+			buildNode(0, 0, count, computeBounds(0, count), 0);
+			finishTask();
+		}
+	});
+}
+
+void BVH::prepareMesh(const Scene & scene, int mesh, int first) {
+	TRACE_SCOPE("bvh_prepare", "mesh", mesh);
+	const Mesh & m = *scene.meshes[mesh];
+	const Matrix44 & model = scene.modelMatrixs[mesh];
+	vector<Vector3> points(m.vertices.size());
+	for (size_t i = 0; i < points.size(); i++)
+		model.apply(m.vertices[i].point, points[i]);
+	for (size_t i = 0; i < m.primitives.size(); i++) {
+		const Primitive & p = m.primitives[i];
+		const Vector3 & p0 = points[p.vertexIndex[0]], & p1 = points[p.vertexIndex[1]], & p2 = points[p.vertexIndex[2]];
+		int index = first + (int)i;
+		unordered[index] = Triangle{ p0, p1 - p0, p2 - p0, mesh, (int)i };
+		__m128 a = _mm_setr_ps(p0.x, p0.y, p0.z, 0.f);
+		__m128 b = _mm_setr_ps(p1.x, p1.y, p1.z, 0.f);
+		__m128 c = _mm_setr_ps(p2.x, p2.y, p2.z, 0.f);
+		Reference & r = references[index];
+		r.min = _mm_min_ps(_mm_min_ps(a, b), c);
+		r.max = _mm_max_ps(_mm_max_ps(a, b), c);
+		r.min = _mm_or_ps(r.min, _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, index)));
+	}
+}
+
+BVH::Bounds BVH::computeBounds(int begin, int end) const {
+	Bounds bounds = emptyBounds();
+	for (int i = begin; i < end; i++)
+		grow(bounds, references[i], center(references[i]));
+	return bounds;
+}
+
+void BVH::buildNode(int index, int begin, int end, const Bounds & bounds, int depth) {
+	Node & node = nodes[index];
+	int count = end - begin;
+	float min[4], max[4];
+	_mm_storeu_ps(min, bounds.min);
+	_mm_storeu_ps(max, bounds.max);
+	node.min[0] = min[0], node.min[1] = min[1], node.min[2] = min[2];
+	node.max[0] = max[0], node.max[1] = max[1], node.max[2] = max[2];
+	node.first = begin;
+	node.count = count;
+	if (count == 1)
+		return;
+
+	// SAH划分极不均匀(如三角形的位置按指数分布)时树会很深. 剩余的层数只够按中位数平分时
+	// (平分count个三角形还需要ceil(log2(count))层), 在中心范围最大的轴上按中位数划分, 叶子不超过第MAX_DEPTH - 1层
+	int halvings = 0;
+	while ((1 << halvings) < count)
+		halvings++;
+	int middle;
+	Bounds childBounds[2];
+	if (depth + halvings >= MAX_DEPTH - 1) {
+		if (count <= MAX_LEAF_SIZE)
+			return;
+		float extent[4];
+		_mm_storeu_ps(extent, _mm_sub_ps(bounds.cmax, bounds.cmin));
+		int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+		middle = begin + count / 2;
+		std::nth_element(&references[begin], &references[middle], &references[0] + end, [axis](const Reference & a, const Reference & b) {
+			return lane(center(a), axis) < lane(center(b), axis);
+		});
+		childBounds[0] = computeBounds(begin, middle);
+		childBounds[1] = computeBounds(middle, end);
+		buildChildren(node, begin, middle, end, childBounds, depth);
+		return;
+	}
+
+	// 一次遍历同时在三个轴上按中心分箱, 每个分箱记录三角形数与包围盒.
+	// 分箱数随三角形数减少(下层的节点很多, 每个节点的固定开销占主要部分)
+	int bins = MIN(BIN_COUNT, MAX(count, 4));
+	__m128 lo = bounds.cmin;
+	__m128 extent = _mm_sub_ps(bounds.cmax, bounds.cmin);
+	// 范围为0的轴上scale为0, 所有三角形都落在第0个分箱
+	__m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps((float)bins), extent), _mm_cmpgt_ps(extent, _mm_setzero_ps()));
+	const __m128 lastBin = _mm_set1_ps((float)(bins - 1));
+	int binCount[3][BIN_COUNT] = {};
+	__m128 binMin[3][BIN_COUNT], binMax[3][BIN_COUNT];
+	for (int axis = 0; axis < 3; axis++)
+		for (int b = 0; b < bins; b++)
+			binMin[axis][b] = _mm_set1_ps(FLT_MAX), binMax[axis][b] = _mm_set1_ps(-FLT_MAX);
+	for (int i = begin; i < end; i++) {
+		const Reference & r = references[i];
+		int bin[4];
+		_mm_storeu_si128((__m128i *)bin, _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_sub_ps(center(r), lo), scale), lastBin)));
+		for (int axis = 0; axis < 3; axis++) {
+			int b = bin[axis];
+			binCount[axis][b]++;
+			binMin[axis][b] = _mm_min_ps(binMin[axis][b], r.min);
+			binMax[axis][b] = _mm_max_ps(binMax[axis][b], r.max);
+		}
+	}
+
+	// 求代价(左右包围盒的表面积 * 三角形数之和)最小的划分
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++) {
+		if (lane(scale, axis) == 0.f)
+			continue;
+		// 从右向左累积右侧的代价, 再从左向右求划分在第b - 1个与第b个分箱之间的总代价
+		float rightCost[BIN_COUNT];
+		__m128 accMin = _mm_set1_ps(FLT_MAX), accMax = _mm_set1_ps(-FLT_MAX);
+		int n = 0;
+		for (int b = bins - 1; b > 0; b--) {
+			n += binCount[axis][b];
+			accMin = _mm_min_ps(accMin, binMin[axis][b]);
+			accMax = _mm_max_ps(accMax, binMax[axis][b]);
+			rightCost[b] = n ? n * surfaceArea(accMin, accMax) : 0.f;
+		}
+		accMin = _mm_set1_ps(FLT_MAX), accMax = _mm_set1_ps(-FLT_MAX);
+		n = 0;
+		for (int b = 1; b < bins; b++) {
+			n += binCount[axis][b - 1];
+			accMin = _mm_min_ps(accMin, binMin[axis][b - 1]);
+			accMax = _mm_max_ps(accMax, binMax[axis][b - 1]);
+			if (n == 0 || n == count)
+				continue;
+			float cost = n * surfaceArea(accMin, accMax) + rightCost[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	if (bestAxis < 0) {
+		// 所有中心重合, 无法按位置划分
+		if (count <= MAX_LEAF_SIZE)
+			return;
+		middle = begin + count / 2;
+		childBounds[0] = computeBounds(begin, middle);
+		childBounds[1] = computeBounds(middle, end);
+	} else {
+		// 不划分的代价: 与count个三角形求交; 划分的代价: 多遍历一层(按与一次三角形求交相当计) + 按面积比例的子节点代价
+		float leafCost = (float)count;
+		float splitCost = 1.f + bestCost / surfaceArea(bounds.min, bounds.max);
+		if (count <= MAX_LEAF_SIZE && splitCost >= leafCost)
+			return;
+		// 原地划分(与分箱时相同地求分箱号), 同时求两侧的包围盒
+		float axisLo = lane(lo, bestAxis), axisScale = lane(scale, bestAxis);
+		childBounds[0] = childBounds[1] = emptyBounds();
+		int i = begin, j = end - 1;
+		while (i <= j) {
+			Reference & r = references[i];
+			__m128 c = center(r);
+			int b = _mm_cvtt_ss2si(_mm_min_ss(_mm_mul_ss(_mm_sub_ss(_mm_set_ss(lane(c, bestAxis)), _mm_set_ss(axisLo)), _mm_set_ss(axisScale)), lastBin));
+			int side = b < bestSplit ? 0 : 1;
+			grow(childBounds[side], r, c);
+			if (side == 0)
+				i++;
+			else
+				std::swap(r, references[j--]);
+		}
+		middle = i;
+	}
+	buildChildren(node, begin, middle, end, childBounds, depth);
+}
+
+void BVH::buildChildren(Node & node, int begin, int middle, int end, const Bounds * childBounds, int depth) {
+	int left = nodeCount.fetch_add(2, std::memory_order_relaxed);
+	node.first = left;
+	node.count = 0;
+	int ranges[2][2] = { { begin, middle }, { middle, end } };
+	for (int k = 0; k < 2; k++) {
+		int b = ranges[k][0], e = ranges[k][1], child = left + k;
+		if (e - b > PARALLEL_THRESHOLD) {
+			pending.fetch_add(1, std::memory_order_relaxed);
+			Bounds cb = childBounds[k];
+			jobs->spawn(*group, [this, child, b, e, cb, depth]() {
+				TRACE_SCOPE("bvh_build");
+				buildNode(child, b, e, cb, depth + 1);
+				finishTask();
+			});
+		} else {
+			buildNode(child, b, e, childBounds[k], depth + 1);
+		}
+	}
+}
+
+void BVH::finishTask() {
+	if (--pending > 0)
+		return;
+	// 所有子树完成后按叶子顺序重排三角形, 遍历叶子时连续访问
+	nodes.resize(nodeCount);
+	int count = (int)references.size();
+	triangles.resize(count);
+	pending = (count + REORDER_CHUNK - 1) / REORDER_CHUNK;
+	jobs->parallelFor(*group, count, REORDER_CHUNK, [this](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			triangles[i] = unordered[_mm_cvtsi128_si32(_mm_shuffle_epi32(_mm_castps_si128(references[i].min), 3))];
+		if (--pending == 0)
+			finishBuild();
+	});
+}
+
+void BVH::finishBuild() {
+	// 保留构建数据的容量, 下次构建时不再分配
+	function<void()> done;
+	done.swap(onBuilt);
+	done();
+}
+
+bool BVH::intersect(const Ray & ray, RayHit & hit) const {
+	const float EPSILON = 1e-9f;
+	Vector3 invDir(inverse(ray.dir.x), inverse(ray.dir.y), inverse(ray.dir.z));
+	float tMax = ray.tMax;
+	hit.triangle = -1;
+	if (triangles.empty())
+		return false;
+
+	int stack[MAX_DEPTH];
+	int top = 0;
+	const Node * node = &nodes[0];
+	if (intersectBox(*node, ray.origin, invDir, ray.tMin, tMax) == FLT_MAX)
+		return false;
+	for (;;) {
+		if (node->count) {
+			for (int i = node->first, end = node->first + node->count; i < end; i++) {
+				// Moller-Trumbore: 行列式不为正时光线从背面射入或与三角形平行
+				const Triangle & tri = triangles[i];
+				Vector3 p = cross(ray.dir, tri.e2);
+				float det = tri.e1 * p;
+				if (det <= EPSILON)
+					continue;
+				float invDet = 1.f / det;
+				Vector3 s = ray.origin - tri.p0;
+				float u = (s * p) * invDet;
+				if (u < 0.f || u > 1.f)
+					continue;
+				Vector3 q = cross(s, tri.e1);
+				float v = (ray.dir * q) * invDet;
+				if (v < 0.f || u + v > 1.f)
+					continue;
+				float t = (tri.e2 * q) * invDet;
+				if (t > ray.tMin && t < tMax) {
+					tMax = t;
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.triangle = i;
+				}
+			}
+		} else {
+			// 先进入较近的子节点, 较远的入栈
+			const Node * left = &nodes[node->first], * right = left + 1;
+			float tl = intersectBox(*left, ray.origin, invDir, ray.tMin, tMax);
+			float tr = intersectBox(*right, ray.origin, invDir, ray.tMin, tMax);
+			if (tl > tr) {
+				std::swap(tl, tr);
+				std::swap(left, right);
+			}
+			if (tl != FLT_MAX) {
+				if (tr != FLT_MAX) {
+					assert(top < MAX_DEPTH);
+					stack[top++] = (int)(right - &nodes[0]);
+				}
+				node = left;
+				continue;
+			}
+		}
+		// 出栈时跳过已经比当前交点更远的节点
+		for (;;) {
+			if (top == 0)
+				return hit.triangle >= 0;
+			node = &nodes[stack[--top]];
+			if (intersectBox(*node, ray.origin, invDir, ray.tMin, tMax) != FLT_MAX)
+				break;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#ifndef _RAYTRACER_H_
+#define _RAYTRACER_H_
+
+#include "Scene.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <emmintrin.h>
+
+// 光线: 交点为origin + t * dir, t在(tMin, tMax)内有效(dir不要求是单位向量)
+struct Ray {
+	Vector3 origin, dir;
+	float tMin, tMax;
+};
+
+// 光线与场景的最近交点
+struct RayHit {
+	float t;
+	float u, v;                 // 重心坐标: 交点 = (1 - u - v) * p0 + u * p1 + v * p2
+	int triangle;               // BVH中三角形的序号, -1为未命中
+};
+
+// 路径追踪的随机数(PCG): 每个样本由种子、像素与样本序号散列出独立的初始状态, 结果与线程数和执行顺序无关
+class PathRandom {
+	unsigned state;
+
+	static unsigned hash(unsigned x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+public:
+	PathRandom(unsigned seed, unsigned pixel, unsigned sample) : state(hash(hash(hash(seed) + pixel) + sample)) {}
+
+	// [0, 1)内均匀分布
+	float next() {
+		state = state * 747796405u + 2891336453u;
+		unsigned word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+		return (((word >> 22) ^ word) >> 8) * (1.f / (1 << 24));
+	}
+};
+
+// 场景中所有三角形(按modelMatrixs变换到世界空间)的层次包围盒(BVH), 按分箱的表面积启发式(binned SAH)划分.
+// 构建在任务系统上进行: 各Mesh的三角形并行变换, 三角形足够多的子树作为单独的任务并行构建
+class BVH {
+public:
+	// 世界空间中的三角形(按叶子的顺序存放)
+	struct Triangle {
+		Vector3 p0, e1, e2;     // 顶点0与两条边p1 - p0, p2 - p0
+		int mesh;               // 所在Mesh在场景中的序号
+		int primitive;          // 在Mesh中的图元序号
+	};
+
+	// 节点(32字节): 内部节点的两个子节点相邻存放, first为左子节点; 叶子的first为第一个三角形
+	struct Node {
+		float min[3];
+		int first;
+		float max[3];
+		int count;              // 叶子的三角形数, 0为内部节点
+	};
+
+	// 构建时三角形的包围盒(SSE2按4个分量同时计算, 只使用x, y, z)与序号, 划分时整体交换, 各层都按顺序访问
+	struct Reference {
+		__m128 min;             // w分量按位存放三角形在场景顺序中的序号
+		__m128 max;             // w分量为0
+	};
+
+	// 构建时一组三角形的包围盒, 及其中心(这里用min + max, 即中心的2倍)的包围盒
+	struct Bounds {
+		__m128 min, max;
+		__m128 cmin, cmax;
+	};
+
+	static const int MAX_DEPTH = 64;            // 树的最大深度(根为第0层, 叶子不超过第MAX_DEPTH - 1层), 即遍历栈的深度
+
+private:
+	static const int BIN_COUNT = 16;            // 每个轴上最多的分箱数
+	static const int MAX_LEAF_SIZE = 8;         // 叶子最多的三角形数(超过时即使不划分的代价更低也继续划分)
+	static const int PARALLEL_THRESHOLD = 4096; // 三角形数超过此值的子树作为单独的任务构建
+	static const int REORDER_CHUNK = 4096;      // 按叶子顺序重排三角形时每个任务的三角形数
+
+	vector<Node> nodes;
+	vector<Triangle> triangles;
+
+	// 构建中使用
+	vector<int> meshFirst;          // 每个Mesh的第一个三角形在场景顺序中的序号
+	vector<Triangle> unordered;     // 按场景顺序存放的三角形
+	vector<Reference> references;   // 构建时按划分原地重排, 完成后即为叶子顺序
+	std::atomic<int> nodeCount;
+	std::atomic<int> pending;       // 未完成的构建任务数
+	JobSystem * jobs;
+	JobSystem::Group * group;
+	function<void()> onBuilt;
+
+	// 变换第mesh个Mesh的三角形, 写入unordered[first...]
+	void prepareMesh(const Scene & scene, int mesh, int first);
+	// 求references[begin, end)的包围盒
+	Bounds computeBounds(int begin, int end) const;
+	// 构建第depth层的节点index, 包含references[begin, end)中的三角形, bounds为它们的包围盒
+	void buildNode(int index, int begin, int end, const Bounds & bounds, int depth);
+	// 把节点划分为references[begin, middle)与[middle, end)两个子节点并构建(较大的子树作为单独的任务)
+	void buildChildren(Node & node, int begin, int middle, int end, const Bounds * childBounds, int depth);
+	// 一个构建任务完成, 全部完成后按叶子顺序重排三角形
+	void finishTask();
+	// 重排完成后释放构建数据并通知
+	void finishBuild();
+
+public:
+	BVH() : nodeCount(0), pending(0), jobs(nullptr), group(nullptr) {}
+
+	// 为场景构建BVH: 任务提交到group中, 全部完成后调用done(在某个工作线程上).
+	// 构建完成前不能修改场景中的Mesh, 也不能再次构建或求交
+	void build(const Scene & scene, JobSystem & jobs, JobSystem::Group & group, const function<void()> & done);
+
+	// 求最近的交点, 命中时返回true并填写hit(背面朝向光线的三角形被剔除, 与光栅化的背面剔除一致)
+	bool intersect(const Ray & ray, RayHit & hit) const;
+
+	const Node & node(int index) const { return nodes[index]; }
+	const Triangle & triangle(int index) const { return triangles[index]; }
+	size_t triangleCount() const { return triangles.size(); }
+	size_t nodeSize() const { return nodes.size(); }
+};
+
+#endif
\ No newline at end of file
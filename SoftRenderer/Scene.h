@@ -7,6 +7,7 @@
 
 class Scene {
 	friend class Pipeline;
+	friend class BVH;
 private:
 	vector<Line> lines;
 	vector<shared_ptr<Mesh>> meshes;
@@ -21,8 +22,8 @@ public:
 	Scene() {}
 	~Scene() {}
 
-	void setViewMatrix(Matrix44 view) { this->view = view; }
-	void setProjectionMatrix(Matrix44 projection) { this->projection = projection; }
+	void setViewMatrix(const Matrix44 & view) { this->view = view; }
+	void setProjectionMatrix(const Matrix44 & projection) { this->projection = projection; }
 	void setPerspective(float fov, float aspect, float zNear, float zFar) { projection.setPerspective(fov, aspect, zNear, zFar); }
 
 	void translate(float x, float y, float z) { currentModel.translate(x, y, z); }
@@ -38,6 +39,15 @@ public:
 		view.setIdentity();
 		projection.setIdentity();
 	}
+
+	// 场景中的三角形总数
+	size_t triangleCount() const {
+		size_t count = 0;
+		for (size_t i = 0; i < meshes.size(); i++) count += meshes[i]->primitives.size();
+		return count;
+	}
+	size_t lineCount() const { return lines.size(); }
+
 	void addLine(Line line) { lines.push_back(line); }
 	void addMesh(shared_ptr<Mesh> mesh) {
 		meshes.push_back(mesh);
@@ -6,12 +6,91 @@
 #include "Primitives.h"
 
 namespace FragmentShader {
-	ShadeFunc depth(float zNear = 0.0f, float zFar = 1.0f);
-	ShadeFunc normal();
-	ShadeFunc lambert_direction_light(Vector3 lightDir, RGBColor lightColor = Colors::White);
-	ShadeFunc phong_direction_light(Vector3 lightDir, RGBColor ambient, RGBColor diffuse, RGBColor specular, float specularPower);
-	ShadeFunc blinn_phong_direction_light(Vector3 lightDir, RGBColor ambient, RGBColor diffuse, RGBColor specular, float specularPower);
-	ShadeFunc blinn_phong_direction_light_color_textured(Vector3 lightDir, RGBColor ambient, RGBColor diffuse, RGBColor specular, float specularPower);
+	// 静态着色器类型,可直接用于构造Shader,着色代码会内联进扫描线循环
+
+	struct Depth {
+		float zNear, zLength;
+		inline bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) const {
+			float f = (pos.z - zNear) / zLength;
+			out = Colors::White * f;
+			return true;
+		}
+	};
+
+	struct Normal {
+		inline bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) const {
+			out = RGBColor(normal.x, normal.y, -normal.z);
+			return true;
+		}
+	};
+
+	struct LambertDirectionLight {
+		Vector3 lightDir;
+		RGBColor lightColor;
+		inline bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) const {
+			out = lightColor * Math::clamp(normal * lightDir);
+			return true;
+		}
+	};
+
+	struct PhongDirectionLight {
+		Vector3 lightDir;
+		RGBColor ambient, diffuse, specular;
+		float specularPower;
+		inline bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) const {
+			Vector3 v(pos);
+			v.x = 1.0f - 2 * v.x;
+			v.y = 2 * v.y - 1.0f;
+			v.z = -v.z;
+			v.normalize();
+			float diff = normal * lightDir;
+			Vector3 reflectionVec = 2 * diff * normal - lightDir;
+			reflectionVec.normalize();
+			float spec = pow(MAX(0, reflectionVec * v), specularPower);
+
+			out = ambient + diffuse * diff + specular * spec;
+			return true;
+		}
+	};
+
+	struct BlinnPhongDirectionLight {
+		Vector3 lightDir;
+		RGBColor ambient, diffuse, specular;
+		float specularPower;
+		inline bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) const {
+			Vector3 v(pos);
+			v.x = 1.0f - 2 * v.x;
+			v.y = 2 * v.y - 1.0f;
+			v.z = -v.z;
+			v.normalize();
+			float diff = normal * lightDir;
+			Vector3 halfVec = lightDir + v;
+			halfVec.normalize();
+			float spec = pow(MAX(0, halfVec * normal), specularPower);
+
+			out = ambient + diffuse * diff + specular * spec;
+			return true;
+		}
+	};
+
+	struct BlinnPhongDirectionLightColorTextured {
+		BlinnPhongDirectionLight light;
+		inline bool operator()(RGBColor & out, const Vector3 & pos, const RGBColor & color, const Vector3 & normal, const Sampler & texture, const TexCoord & texCoord) const {
+			RGBColor lighting;
+			light(lighting, pos, color, normal, texture, texCoord);
+			out.setRGBInt(texture.get(texCoord));
+			out *= color;
+			out *= lighting;
+			return true;
+		}
+	};
+
+	Shader depth(float zNear = 0.0f, float zFar = 1.0f);
+	Shader normal();
+	Shader lambert_direction_light(Vector3 lightDir, RGBColor lightColor = Colors::White);
+	Shader phong_direction_light(Vector3 lightDir, RGBColor ambient, RGBColor diffuse, RGBColor specular, float specularPower);
+	Shader blinn_phong_direction_light(Vector3 lightDir, RGBColor ambient, RGBColor diffuse, RGBColor specular, float specularPower);
+	Shader blinn_phong_direction_light_color_textured(Vector3 lightDir, RGBColor ambient, RGBColor diffuse, RGBColor specular, float specularPower);
 }
 
 #endif
\ No newline at end of file
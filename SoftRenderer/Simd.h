@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 标记需要AVX2指令集编译的函数(MSVC无需额外开关即可使用AVX2 intrinsics)
+// 不开启FMA: 编译器会把分开的乘、加合并为融合乘加, 舍入与SSE2/标量路径不同
+#ifdef _MSC_VER
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Simd {
+	// 运行时可用的指令集等级
+	enum Level {
+		SCALAR = 0,
+		SSE2 = 1,
+		AVX2 = 2
+	};
+
+	// 通过CPUID检测当前CPU(及操作系统)支持的最高指令集等级
+	inline Level detect() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return SSE2;
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx) return SSE2;
+		// 操作系统需要保存YMM寄存器状态
+		if ((_xgetbv(0) & 6) != 6) return SSE2;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) ? AVX2 : SSE2;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? AVX2 : SSE2;
+#endif
+	}
+
+	// 缓存的检测结果
+	inline Level level() {
+		static const Level lv = detect();
+		return lv;
+	}
+}
+
+#endif
\ No newline at end of file
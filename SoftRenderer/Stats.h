@@ -0,0 +1,141 @@
+#pragma once
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "Define.h"
+
+#include <chrono>
+
+// 流水线统计的编译开关: 定义SOFTRENDERER_STATS为1时记录各阶段耗时与计数,
+// 为0(默认)时所有统计宏展开为空,不产生任何开销
+#ifndef SOFTRENDERER_STATS
+#define SOFTRENDERER_STATS 0
+#endif
+
+namespace Stats {
+	const bool enabled = SOFTRENDERER_STATS != 0;
+
+	// 流水线阶段(各阶段的时间互不包含)
+	enum Stage {
+		STAGE_CLEAR = 0,        // 清除缓冲区
+		STAGE_VERTEX,           // 顶点变换(含齐次除法,法线变换)
+		STAGE_CLIP,             // CVV裁剪测试
+		STAGE_CULL,             // 背面剔除
+		STAGE_SETUP,            // 三角形切割/分箱
+		STAGE_RASTER,           // 扫描线光栅化与深度测试/填充
+		STAGE_SHADING,          // 片元着色
+		STAGE_LINE,             // 直线光栅化
+		STAGE_LOCK,             // 等待扫描线锁
+		STAGE_TRACE,            // 光线追踪(求交与着色)
+		STAGE_COUNT
+	};
+
+	// 计数器
+	enum Counter {
+		TRIANGLES_SUBMITTED = 0,    // 提交的三角形
+		TRIANGLES_CLIPPED,          // 穿过近/远平面或保护带而需要裁剪的三角形
+		TRIANGLES_CULLED,           // 背面剔除的三角形
+		SCANLINES,                  // 光栅化的扫描线
+		FRAGMENTS_TESTED,           // 进行深度测试的片元
+		FRAGMENTS_PASSED,           // 通过深度测试的片元
+		SHADER_INVOCATIONS,         // 着色器调用次数
+		LOCK_WAITS,                 // 扫描线锁被占用而需要等待的次数
+		RAYS,                       // 光线追踪的光线数(主光线与反射光线)
+		COUNTER_COUNT
+	};
+
+	inline const char * stageName(int stage) {
+		static const char * const names[STAGE_COUNT] = {
+			"clear", "vertex", "clip", "cull", "setup", "raster", "shading", "line", "lock", "trace"
+		};
+		return names[stage];
+	}
+
+	inline const char * counterName(int counter) {
+		static const char * const names[COUNTER_COUNT] = {
+			"triangles_submitted", "triangles_clipped", "triangles_culled", "scanlines",
+			"fragments_tested", "fragments_passed", "shader_invocations", "lock_waits", "rays"
+		};
+		return names[counter];
+	}
+
+	typedef std::chrono::steady_clock Clock;
+
+	// 单个线程在一帧内的统计
+	struct ThreadStats {
+		double stageTime[STAGE_COUNT];      // 各阶段耗时(秒)
+		long long counters[COUNTER_COUNT];
+
+		int currentStage;                   // 正在计时的阶段(-1为不计时)
+		Clock::time_point stageStart;       // 当前阶段开始计时的时刻
+
+		char padding[64];                   // 避免相邻线程的统计位于同一缓存行
+
+		ThreadStats() { reset(); }
+		void reset() {
+			for (int i = 0; i < STAGE_COUNT; i++) stageTime[i] = 0;
+			for (int i = 0; i < COUNTER_COUNT; i++) counters[i] = 0;
+			currentStage = -1;
+		}
+		// 结束当前阶段的计时,切换到新的阶段
+		void switchStage(int stage) {
+			Clock::time_point now = Clock::now();
+			if (currentStage >= 0)
+				stageTime[currentStage] += std::chrono::duration<double>(now - stageStart).count();
+			currentStage = stage;
+			stageStart = now;
+		}
+	};
+
+	// 一帧的统计
+	struct FrameStats {
+		vector<ThreadStats> threads;        // 按工作线程编号索引
+		double frameTime = 0;               // render()的总耗时(秒)
+
+		void reset(size_t threadNum) {
+			threads.resize(threadNum);
+			for (size_t i = 0; i < threads.size(); i++) threads[i].reset();
+			frameTime = 0;
+		}
+		// 所有线程的合计
+		ThreadStats total() const {
+			ThreadStats sum;
+			for (size_t t = 0; t < threads.size(); t++) {
+				for (int i = 0; i < STAGE_COUNT; i++) sum.stageTime[i] += threads[t].stageTime[i];
+				for (int i = 0; i < COUNTER_COUNT; i++) sum.counters[i] += threads[t].counters[i];
+			}
+			return sum;
+		}
+	};
+
+	// 在作用域内把时间计入某个阶段,退出时恢复外层的阶段(嵌套的阶段不会重复计时)
+	class StageScope {
+		ThreadStats & stats;
+		int previous;
+	public:
+		StageScope(ThreadStats & stats, int stage) : stats(stats), previous(stats.currentStage) { stats.switchStage(stage); }
+		~StageScope() { stats.switchStage(previous); }
+	};
+}
+
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+
+#if SOFTRENDERER_STATS
+// 作用域内的时间计入stage
+#define STATS_SCOPE(threadStats, stage) Stats::StageScope STATS_CONCAT(statsScope, __LINE__)((threadStats), (stage))
+// 在当前作用域内切换到另一个阶段
+#define STATS_SWITCH(threadStats, stage) (threadStats).switchStage(stage)
+// 计数器增加n
+#define STATS_ADD(threadStats, counter, n) ((threadStats).counters[counter] += (n))
+// 只在开启统计时编译的代码
+#define STATS_ONLY(code) code
+#else
+#define STATS_SCOPE(threadStats, stage)
+#define STATS_SWITCH(threadStats, stage)
+#define STATS_ADD(threadStats, counter, n)
+#define STATS_ONLY(code)
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,374 @@
+// 使用标准C的fopen
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Texture.h"
+
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+	// 两个纹素按t / 256混合(t在[0, 256]内), R与B通道在同一次乘法中计算
+	inline unsigned lerpTexel(unsigned a, unsigned b, unsigned t) {
+		unsigned rb = (((a & 0xff00ff) * (256 - t) + (b & 0xff00ff) * t) >> 8) & 0xff00ff;
+		unsigned g = (((a & 0x00ff00) * (256 - t) + (b & 0x00ff00) * t) >> 8) & 0x00ff00;
+		return rb | g;
+	}
+
+	// 重复寻址: 把坐标映射到[0, size)
+	inline int wrap(int x, int size) {
+		x %= size;
+		return x < 0 ? x + size : x;
+	}
+
+	// 把x的低16位分散到偶数位上
+	inline unsigned spreadBits(unsigned x) {
+		x &= 0xffff;
+		x = (x | (x << 8)) & 0x00ff00ff;
+		x = (x | (x << 4)) & 0x0f0f0f0f;
+		x = (x | (x << 2)) & 0x33333333;
+		x = (x | (x << 1)) & 0x55555555;
+		return x;
+	}
+
+	std::atomic<unsigned> nextLevelId(1);
+	std::atomic<unsigned> nextVersion(1);
+
+	////          BC1压缩          ////
+
+	inline int to565(int c) {
+		int r = (c >> 16) & 0xff, g = (c >> 8) & 0xff, b = c & 0xff;
+		return (((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255);
+	}
+	inline int from565(int c) {
+		int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		return (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+	}
+	// a * wa + b * wb 后除以wa + wb, 逐通道计算
+	inline int mixTexel(int a, int b, int wa, int wb) {
+		int n = wa + wb, c = 0;
+		for (int shift = 0; shift <= 16; shift += 8)
+			c |= ((((a >> shift) & 0xff) * wa + ((b >> shift) & 0xff) * wb + n / 2) / n) << shift;
+		return c;
+	}
+	inline int distance2(int a, int b) {
+		int d = 0;
+		for (int shift = 0; shift <= 16; shift += 8) {
+			int t = ((a >> shift) & 0xff) - ((b >> shift) & 0xff);
+			d += t * t;
+		}
+		return d;
+	}
+
+	// 由两个端点求块的4色调色板(端点0大于端点1时为4色模式, 否则第3色为两者平均, 第4色为黑色)
+	void paletteBC1(int c0, int c1, int palette[4]) {
+		palette[0] = from565(c0);
+		palette[1] = from565(c1);
+		if (c0 > c1) {
+			palette[2] = mixTexel(palette[0], palette[1], 2, 1);
+			palette[3] = mixTexel(palette[0], palette[1], 1, 2);
+		} else {
+			palette[2] = mixTexel(palette[0], palette[1], 1, 1);
+			palette[3] = 0;
+		}
+	}
+
+	// 压缩一个4x4块: 端点取沿颜色包围盒对角线投影最远的两个纹素, 每个纹素取调色板中最近的颜色.
+	// out[0]的低16位为端点0, 高16位为端点1; out[1]的第2i, 2i + 1位为第i个纹素的索引
+	void encodeBC1(const int texels[16], int out[2]) {
+		int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+			for (int k = 0; k < 3; k++) {
+				int v = (texels[i] >> (16 - 8 * k)) & 0xff;
+				lo[k] = MIN(lo[k], v);
+				hi[k] = MAX(hi[k], v);
+			}
+		int axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+		int minI = 0, maxI = 0, minP = INT_MAX, maxP = INT_MIN;
+		for (int i = 0; i < 16; i++) {
+			int p = 0;
+			for (int k = 0; k < 3; k++)
+				p += ((texels[i] >> (16 - 8 * k)) & 0xff) * axis[k];
+			if (p < minP) minP = p, minI = i;
+			if (p > maxP) maxP = p, maxI = i;
+		}
+		int c0 = to565(texels[maxI]), c1 = to565(texels[minI]);
+		if (c0 < c1) swap(c0, c1);
+		out[0] = c0 | (c1 << 16);
+		out[1] = 0;
+		if (c0 == c1) return;
+		int palette[4];
+		paletteBC1(c0, c1, palette);
+		unsigned indices = 0;
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestD = INT_MAX;
+			for (int j = 0; j < 4; j++) {
+				int d = distance2(texels[i], palette[j]);
+				if (d < bestD) bestD = d, best = j;
+			}
+			indices |= best << (2 * i);
+		}
+		out[1] = (int)indices;
+	}
+
+	void decodeBC1(const int block[2], int texels[16]) {
+		int palette[4];
+		paletteBC1(block[0] & 0xffff, (block[0] >> 16) & 0xffff, palette);
+		unsigned indices = (unsigned)block[1];
+		for (int i = 0; i < 16; i++)
+			texels[i] = palette[(indices >> (2 * i)) & 3];
+	}
+
+	// 每个线程最近解码的64个块
+	struct DecodedBlock {
+		unsigned level = 0;         // Level::id, 0为空
+		int x = 0, y = 0;           // 块坐标
+		int texels[16];
+	};
+	thread_local DecodedBlock decodeCache[64];
+}
+
+size_t Texture::initOffsets(Level & level, int w, int h, Layout layout) const {
+	level.width = w;
+	level.height = h;
+	level.id = nextLevelId++;
+	level.xOffset.resize(w);
+	level.yOffset.resize(h);
+	const int t = TILE_SIZE;
+	switch (layout) {
+	case TILED: {
+		// 每行的块数补齐为奇数, 避免纵向相邻的块落在缓存的同一组里
+		int tilesX = ((w + t - 1) / t) | 1, tilesY = (h + t - 1) / t;
+		for (int x = 0; x < w; x++) level.xOffset[x] = (x / t) * t * t + x % t;
+		for (int y = 0; y < h; y++) level.yOffset[y] = (y / t) * tilesX * t * t + (y % t) * t;
+		return (size_t)tilesX * tilesY * t * t;
+	}
+	case MORTON: {
+		// 较短边的k位与较长边的低k位交错, 较长边的其余位接在后面
+		int pw = Math::nextPowerOfTwo(w), ph = Math::nextPowerOfTwo(h);
+		int k = Math::log2(MIN(pw, ph));
+		unsigned mask = (1u << k) - 1;
+		for (int x = 0; x < w; x++) level.xOffset[x] = spreadBits(x & mask) | ((x >> k) << (2 * k));
+		for (int y = 0; y < h; y++) level.yOffset[y] = (spreadBits(y & mask) << 1) | ((y >> k) << (2 * k));
+		return (size_t)pw * ph;
+	}
+	case BC1: {
+		// 偏移指向纹素所在的块, 与分块布局一样每行的块数补齐为奇数
+		int blocksX = ((w + t - 1) / t) | 1, blocksY = (h + t - 1) / t;
+		for (int x = 0; x < w; x++) level.xOffset[x] = (x / t) * 2;
+		for (int y = 0; y < h; y++) level.yOffset[y] = (y / t) * blocksX * 2;
+		return (size_t)blocksX * blocksY * 2;
+	}
+	default:
+		for (int x = 0; x < w; x++) level.xOffset[x] = x;
+		for (int y = 0; y < h; y++) level.yOffset[y] = y * w;
+		return (size_t)w * h;
+	}
+}
+
+Texture::Texture(size_t width, size_t height) : IntBuffer(width, height), filter(POINT), layout(LINEAR), version(nextVersion++) {
+	levels.emplace_back(new Level());
+	initLevel(*levels.back(), *this);
+}
+
+void Texture::initLevel(Level & level, const IntBuffer & image) {
+	int w = (int)image.getWidth(), h = (int)image.getHeight();
+	if (&image == this && sharesSource()) {
+		// 第0级直接使用原图, 按线性布局寻址
+		initOffsets(level, w, h, LINEAR);
+		vector<int>().swap(level.storage);
+		level.texels = image();
+		return;
+	}
+	size_t size = initOffsets(level, w, h, layout);
+	level.storage.assign(size, 0);
+	if (layout == BC1) {
+		// 块超出边界的部分重复最后一行(列)
+		int block[16];
+		for (int by = 0; by < h; by += TILE_SIZE)
+			for (int bx = 0; bx < w; bx += TILE_SIZE) {
+				for (int j = 0; j < TILE_SIZE; j++)
+					for (int i = 0; i < TILE_SIZE; i++)
+						block[j * TILE_SIZE + i] = *image(MIN(bx + i, w - 1), MIN(by + j, h - 1));
+				encodeBC1(block, &level.storage[level.offset(bx, by)]);
+			}
+	} else {
+		for (int y = 0; y < h; y++) {
+			const int * row = image(0, y);
+			for (int x = 0; x < w; x++)
+				level.storage[level.offset(x, y)] = row[x];
+		}
+	}
+	level.texels = level.storage.data();
+}
+
+int Texture::fetchCompressed(const Level & level, int x, int y) {
+	// 按块坐标的低3位直接映射, 双线性采样涉及的相邻块不会互相替换
+	int bx = x / TILE_SIZE, by = y / TILE_SIZE;
+	DecodedBlock & d = decodeCache[(bx & 7) | ((by & 7) << 3)];
+	if (d.level != level.id || d.x != bx || d.y != by) {
+		decodeBC1(level.texels + level.offset(x, y), d.texels);
+		d.level = level.id;
+		d.x = bx;
+		d.y = by;
+	}
+	return d.texels[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+}
+
+void Texture::setFilter(Filter filter) {
+	bool shared = sharesSource();
+	this->filter = filter;
+	// 点采样只读取原图, 其他过滤方式才需要按布局重排的第0级
+	if (sharesSource() != shared)
+		initLevel(*levels[0], *this);
+	version = nextVersion++;
+}
+
+void Texture::releaseSource() {
+	// 无损布局的第0级可能就是原图
+	if (layout != BC1 || !buffer) return;
+	release();
+}
+
+size_t Texture::memoryUsage() const {
+	size_t bytes = size * sizeof(int);
+	for (const auto & level : levels)
+		bytes += level->storage.size() * sizeof(int);
+	return bytes;
+}
+
+void Texture::buildMipmaps() {
+	if (!buffer) {
+		// 原图已释放时从第0级恢复
+		allocate();
+		for (size_t y = 0; y < height; y++)
+			for (size_t x = 0; x < width; x++)
+				set(x, y, texel(*levels[0], (int)x, (int)y));
+	}
+	version = nextVersion++;
+	levels.clear();
+	levels.emplace_back(new Level());
+	initLevel(*levels.back(), *this);
+
+	std::unique_ptr<IntBuffer> mip;
+	const IntBuffer * src = this;
+	while (src->getWidth() > 1 || src->getHeight() > 1) {
+		size_t sw = src->getWidth(), sh = src->getHeight();
+		size_t w = MAX(sw / 2, (size_t)1), h = MAX(sh / 2, (size_t)1);
+		IntBuffer * dst = new IntBuffer(w, h);
+		// 2x2盒式滤波, 奇数尺寸时最后一行(列)与前一行(列)合并到同一个纹素
+		for (size_t y = 0; y < h; y++) {
+			size_t y0 = MIN(2 * y, sh - 1), y1 = MIN(2 * y + 1, sh - 1);
+			for (size_t x = 0; x < w; x++) {
+				size_t x0 = MIN(2 * x, sw - 1), x1 = MIN(2 * x + 1, sw - 1);
+				int texels[4] = { src->get(x0, y0), src->get(x1, y0), src->get(x0, y1), src->get(x1, y1) };
+				int r = 0, g = 0, b = 0;
+				for (int i = 0; i < 4; i++) {
+					r += (texels[i] >> 16) & 0xff;
+					g += (texels[i] >> 8) & 0xff;
+					b += texels[i] & 0xff;
+				}
+				dst->set(x, y, (((r + 2) / 4) << 16) | (((g + 2) / 4) << 8) | ((b + 2) / 4));
+			}
+		}
+		levels.emplace_back(new Level());
+		initLevel(*levels.back(), *dst);
+		// 按行存放的上一级只在生成下一级时使用
+		mip.reset(dst);
+		src = dst;
+	}
+}
+
+int Texture::sampleBilinear(const Level & level, float u, float v) const {
+	int w = level.width, h = level.height;
+	// 纹素中心在(i + 0.5) / size处
+	float x = Math::fract(u) * w - 0.5f, y = Math::fract(v) * h - 0.5f;
+	int x0 = Math::floor(x), y0 = Math::floor(y);
+	unsigned tx = (unsigned)((x - x0) * 256), ty = (unsigned)((y - y0) * 256);
+	int x1 = wrap(x0 + 1, w), y1 = wrap(y0 + 1, h);
+	x0 = wrap(x0, w), y0 = wrap(y0, h);
+	unsigned top = lerpTexel(texel(level, x0, y0), texel(level, x1, y0), tx);
+	unsigned bottom = lerpTexel(texel(level, x0, y1), texel(level, x1, y1), tx);
+	return (int)lerpTexel(top, bottom, ty);
+}
+
+int Texture::sample(const Vector2 & uv, float lod) const {
+	int maxLevel = (int)levels.size() - 1;
+	switch (filter) {
+	case BILINEAR: {
+		int l = Math::clamp(Math::round(lod), 0, maxLevel);
+		return sampleBilinear(level(l), uv.x, uv.y);
+	}
+	case TRILINEAR: {
+		if (lod <= 0)
+			return sampleBilinear(level(0), uv.x, uv.y);
+		int l = Math::floor(lod);
+		if (l >= maxLevel)
+			return sampleBilinear(level(maxLevel), uv.x, uv.y);
+		unsigned t = (unsigned)((lod - l) * 256);
+		return (int)lerpTexel(sampleBilinear(level(l), uv.x, uv.y), sampleBilinear(level(l + 1), uv.x, uv.y), t);
+	}
+	default: {
+		// 与IntBuffer::get(uv)相同的最近纹素
+		const Level & l = level(0);
+		return texel(l, (int)(Math::fract(uv.x) * l.width) % l.width, (int)(Math::fract(uv.y) * l.height) % l.height);
+	}
+	}
+}
+
+namespace {
+	// 缓存文件: 标识, 宽, 高, 级数, 原图文件的大小与散列, 然后每级依次是宽, 高, int数与压缩后的块
+	const char cacheMagic[4] = { 'S', 'R', 'B', '2' };
+}
+
+bool Texture::saveCompressed(const char * filename, unsigned sourceSize, unsigned sourceHash) const {
+	if (layout != BC1 || levels.empty()) return false;
+	FILE * file = fopen(filename, "wb");
+	if (!file) return false;
+	unsigned header[5] = { (unsigned)width, (unsigned)height, (unsigned)levels.size(), sourceSize, sourceHash };
+	bool ok = fwrite(cacheMagic, 1, 4, file) == 4 && fwrite(header, sizeof(unsigned), 5, file) == 5;
+	for (size_t i = 0; ok && i < levels.size(); i++) {
+		const Level & l = *levels[i];
+		unsigned info[3] = { (unsigned)l.width, (unsigned)l.height, (unsigned)l.storage.size() };
+		ok = fwrite(info, sizeof(unsigned), 3, file) == 3 && fwrite(l.storage.data(), sizeof(int), l.storage.size(), file) == l.storage.size();
+	}
+	return fclose(file) == 0 && ok;
+}
+
+shared_ptr<Texture> Texture::loadCompressed(const char * filename, unsigned sourceSize, unsigned sourceHash) {
+	FILE * file = fopen(filename, "rb");
+	if (!file) return shared_ptr<Texture>();
+	char magic[4];
+	unsigned header[5];
+	shared_ptr<Texture> texture;
+	if (fread(magic, 1, 4, file) == 4 && !memcmp(magic, cacheMagic, 4) && fread(header, sizeof(unsigned), 5, file) == 5
+		&& header[3] == sourceSize && header[4] == sourceHash
+		&& header[0] > 0 && header[1] > 0 && header[0] <= 1 << 15 && header[1] <= 1 << 15) {
+		texture = make_shared<Texture>(header[0], header[1]);
+		texture->layout = BC1;
+		texture->releaseSource();
+		texture->levels.clear();
+		for (unsigned i = 0; i < header[2]; i++) {
+			unsigned info[3];
+			std::unique_ptr<Level> level(new Level());
+			if (fread(info, sizeof(unsigned), 3, file) != 3 || info[0] == 0 || info[1] == 0 || info[0] > header[0] || info[1] > header[1]
+				|| texture->initOffsets(*level, info[0], info[1], BC1) != info[2]) {
+				texture.reset();
+				break;
+			}
+			level->storage.resize(info[2]);
+			if (fread(level->storage.data(), sizeof(int), info[2], file) != info[2]) {
+				texture.reset();
+				break;
+			}
+			level->texels = level->storage.data();
+			texture->levels.push_back(std::move(level));
+		}
+		if (texture && texture->levels.empty()) texture.reset();
+	}
+	fclose(file);
+	return texture;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef _TEXTURE_H_
+#define _TEXTURE_H_
+
+#include "FrameBuffer.h"
+
+// 带多级渐远纹理(mipmap)的纹理. 自身(按行存放)是第0级的原图, 其余各级由buildMipmaps按2x2盒式滤波逐级缩小生成,
+// 采样时各级按layout指定的内存布局存放. 纹理坐标在两个方向上都按重复(repeat)方式寻址.
+// 无损布局下点采样只读取原图, 此时第0级不另存重排后的副本; 压缩布局下可以释放原图, 只保留压缩后的各级
+class Texture : public IntBuffer {
+public:
+	// 纹理过滤方式
+	enum Filter {
+		POINT = 0,                  // 在第0级上点采样(不使用mipmap)
+		BILINEAR = 1,               // 在最接近细节层次的一级上双线性插值
+		TRILINEAR = 2               // 在相邻两级上双线性插值后按细节层次混合
+	};
+
+	// 纹素的内存布局
+	enum Layout {
+		LINEAR = 0,                 // 按行存放
+		TILED = 1,                  // 4x4的块按行排列, 块内按行存放(一块64字节, 正好一个缓存行), 每行的块数为奇数
+		MORTON = 2,                 // Z序(x, y的二进制位交错), 尺寸按2的幂补齐
+		BC1 = 3                     // 4x4块压缩: 每块两个RGB565端点与16个2位索引共8字节(有损), 采样时按块解码
+	};
+	static const int TILE_SIZE = 4;
+
+	// 一级mipmap: 纹素(x, y)位于texels[xOffset[x] + yOffset[y]], 不同布局只是偏移表不同.
+	// BC1布局下该位置是纹素所在的块(每块占两个int), 需用Texture::texel解码
+	struct Level {
+		int width, height;
+		const int * texels;
+		vector<int> storage;        // 按布局重排后的纹素(第0级直接使用原图时为空)
+		vector<unsigned> xOffset, yOffset;
+		unsigned id;                // 全局唯一的编号, 用作解码缓存的键
+
+		size_t offset(int x, int y) const { return xOffset[x] + yOffset[y]; }
+		int fetch(int x, int y) const { return texels[xOffset[x] + yOffset[y]]; }
+	};
+
+private:
+	vector<std::unique_ptr<Level>> levels;
+	Filter filter;
+	Layout layout;
+	unsigned version;
+
+	// 按指定布局生成一级的偏移表, 返回该级需要的int数
+	size_t initOffsets(Level & level, int width, int height, Layout layout) const;
+	// 第0级是否直接使用原图(按行存放): 线性布局, 或无损布局下点采样时
+	bool sharesSource() const { return buffer && layout != BC1 && (layout == LINEAR || filter == POINT); }
+	// 生成一级的偏移表并重排(或压缩)纹素, image为本级按行存放的纹素
+	void initLevel(Level & level, const IntBuffer & image);
+	// 在一级上双线性插值
+	int sampleBilinear(const Level & level, float u, float v) const;
+	// 通过当前线程的解码缓存读取BC1块中的纹素
+	static int fetchCompressed(const Level & level, int x, int y);
+
+public:
+	// 只生成第0级(即原图), 各种过滤方式都可以直接采样, 需要mipmap时调用buildMipmaps
+	Texture(size_t width, size_t height);
+
+	// 根据原图重新生成各级并按当前布局存放(修改纹理数据后需要调用)
+	void buildMipmaps();
+	// 级数(包括第0级)
+	size_t levelCount() const { return levels.size(); }
+	// 第i级(调用buildMipmaps之前只有第0级)
+	const Level & level(size_t i) const { return *levels[i]; }
+	// 第i级的纹素(x, y), 各种布局通用
+	int texel(const Level & level, int x, int y) const {
+		return layout == BC1 ? fetchCompressed(level, x, y) : level.fetch(x, y);
+	}
+
+	// 是否保留了按行存放的原图
+	bool hasSource() const { return buffer != nullptr; }
+	// 释放原图以节省内存(只在BC1布局下有效), 之后不能再通过IntBuffer的接口访问纹素
+	void releaseSource();
+	// 点采样且布局无损时, 采样结果与直接读取原图相同
+	bool readsSource() const { return filter == POINT && layout != BC1 && buffer; }
+	// 原图与各级占用的字节数(不含偏移表)
+	size_t memoryUsage() const;
+
+	// 把BC1布局的各级写入缓存文件, 同时记录原图文件的大小与内容散列
+	bool saveCompressed(const char * filename, unsigned sourceSize, unsigned sourceHash) const;
+	// 从缓存文件读取BC1布局的纹理(不含原图), 失败或原图文件的大小、散列与记录不同时返回空
+	static shared_ptr<Texture> loadCompressed(const char * filename, unsigned sourceSize, unsigned sourceHash);
+
+	// 在点采样与其他过滤方式之间切换时重新生成第0级(不能与使用该纹理的渲染同时进行)
+	void setFilter(Filter filter);
+	Filter getFilter() const { return filter; }
+	// 改变内存布局并重新生成各级
+	void setLayout(Layout layout) { this->layout = layout; buildMipmaps(); }
+	Layout getLayout() const { return layout; }
+	// 全局唯一的编号, 采样结果可能改变时(生成各级, 改变过滤方式或布局)更新
+	unsigned getVersion() const { return version; }
+
+	// 由纹理坐标在屏幕空间的导数求细节层次: log2(一个像素覆盖的纹素数)
+	float lod(float dudx, float dvdx, float dudy, float dvdy) const {
+		float sx = (dudx * dudx) * (width * width) + (dvdx * dvdx) * (height * height);
+		float sy = (dudy * dudy) * (width * width) + (dvdy * dvdy) * (height * height);
+		return 0.5f * Math::fastLog2(MAX(MAX(sx, sy), 1e-8f));
+	}
+	// 按当前的过滤方式采样, lod为细节层次(点采样时忽略)
+	int sample(const Vector2 & uv, float lod) const;
+};
+
+// 着色器使用的纹理采样器: 纹理与当前像素的细节层次
+struct Sampler {
+	const Texture * texture;
+	float lod;
+
+	explicit operator bool() const { return texture != nullptr; }
+	int get(const Vector2 & uv) const { return texture->sample(uv, lod); }
+};
+
+// 从图片文件加载纹理, 按layout重排并生成mipmap, 失败时返回空.
+// BC1布局优先读取同名加.bc1后缀的缓存文件(图片文件改变后缓存失效), 没有时压缩后写入缓存, 并释放原图
+shared_ptr<Texture> CreateTexture(const char * filename, Texture::Layout layout = Texture::LINEAR);
+
+#endif
\ No newline at end of file
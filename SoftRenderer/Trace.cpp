@@ -0,0 +1,105 @@
+// 使用标准C的fopen
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "Trace.h"
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <mutex>
+
+namespace {
+	// 单个线程的环形缓冲区,只由所属线程写入
+	struct ThreadBuffer {
+		vector<Trace::Event> events;
+		size_t count = 0;           // 写入过的事件总数, 超过容量后覆盖最旧的事件
+		int thread;                 // 注册时的工作线程编号
+		int id;                     // 导出时的tid
+	};
+
+	std::mutex registryMutex;                       // 只在线程首次记录时加锁
+	vector<std::unique_ptr<ThreadBuffer>> registry;
+	std::atomic<unsigned> generation(0);            // 每次start递增,使线程缓存的缓冲区失效
+	size_t capacity = 0;
+	Trace::Clock::time_point origin;                // 导出时间戳的起点
+
+	thread_local ThreadBuffer * localBuffer = nullptr;
+	thread_local unsigned localGeneration = 0;
+
+	ThreadBuffer * threadBuffer() {
+		unsigned current = generation.load(std::memory_order_acquire);
+		if (localGeneration != current || !localBuffer) {
+			std::lock_guard<std::mutex> guard(registryMutex);
+			registry.emplace_back(new ThreadBuffer());
+			localBuffer = registry.back().get();
+			localBuffer->events.resize(capacity);
+			localBuffer->thread = JobSystem::threadIndex();
+			localBuffer->id = (int)registry.size();
+			localGeneration = current;
+		}
+		return localBuffer;
+	}
+
+	double toMicroseconds(Trace::Clock::time_point t) {
+		return std::chrono::duration<double, std::micro>(t - origin).count();
+	}
+}
+
+std::atomic<bool> Trace::active(false);
+
+void Trace::start(size_t eventsPerThread) {
+	active.store(false);
+	{
+		std::lock_guard<std::mutex> guard(registryMutex);
+		registry.clear();
+		capacity = MAX(eventsPerThread, (size_t)1);
+		origin = Clock::now();
+	}
+	generation.fetch_add(1, std::memory_order_release);
+	active.store(true);
+}
+
+void Trace::stop() {
+	active.store(false);
+}
+
+void Trace::record(const char * name, const char * argName, int arg, Clock::time_point start, Clock::time_point end) {
+	ThreadBuffer * buffer = threadBuffer();
+	Event & e = buffer->events[buffer->count % capacity];
+	e.name = name;
+	e.argName = argName;
+	e.arg = arg;
+	e.start = start;
+	e.end = end;
+	buffer->count++;
+}
+
+bool Trace::write(const char * filename) {
+	FILE * file = fopen(filename, "w");
+	if (!file) return false;
+
+	std::lock_guard<std::mutex> guard(registryMutex);
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"SoftRenderer\"}}");
+	for (size_t b = 0; b < registry.size(); b++) {
+		const ThreadBuffer & buffer = *registry[b];
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d (worker %d)\"}}",
+			buffer.id, buffer.id, buffer.thread);
+		fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+			buffer.id, buffer.id);
+		// 缓冲区写满后从最旧的事件开始输出
+		size_t n = MIN(buffer.count, capacity);
+		size_t first = buffer.count - n;
+		for (size_t i = first; i < buffer.count; i++) {
+			const Event & e = buffer.events[i % capacity];
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				e.name, buffer.id, toMicroseconds(e.start), toMicroseconds(e.end) - toMicroseconds(e.start));
+			if (e.argName)
+				fprintf(file, ",\"args\":{\"%s\":%d}", e.argName, e.arg);
+			fprintf(file, "}");
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "Define.h"
+
+#include <atomic>
+#include <chrono>
+
+// 帧时间线追踪: 开启后各线程把事件(开始时刻+持续时间)写入自己的环形缓冲区,
+// 写入时不加锁; 结束后导出为Chrome trace-event JSON, 可用chrome://tracing或Perfetto打开.
+// 未开启时每个追踪点只有一次原子变量读取与分支
+namespace Trace {
+	typedef std::chrono::steady_clock Clock;
+
+	// 一个完整事件(Chrome trace中的"X"事件)
+	struct Event {
+		const char * name;          // 事件名(必须是静态字符串)
+		const char * argName;       // 附加参数名(静态字符串, nullptr为无参数)
+		int arg;                    // 附加参数值
+		Clock::time_point start;
+		Clock::time_point end;
+	};
+
+	extern std::atomic<bool> active;
+
+	inline bool isActive() { return active.load(std::memory_order_relaxed); }
+
+	// 开始记录,丢弃之前的事件. 每个线程最多保留最近的eventsPerThread个事件.
+	// start/stop/write只能在渲染线程都空闲时(两次render之间)调用
+	void start(size_t eventsPerThread = 1 << 16);
+	// 停止记录,已记录的事件保留到下一次start
+	void stop();
+	// 以Chrome trace-event JSON格式写入文件
+	bool write(const char * filename);
+
+	// 记录一个事件到当前线程的缓冲区
+	void record(const char * name, const char * argName, int arg, Clock::time_point start, Clock::time_point end);
+
+	// 在作用域内记录一个事件
+	class Scope {
+		const char * name;
+		const char * argName;
+		int arg;
+		bool enabled;
+		Clock::time_point start;
+	public:
+		Scope(const char * name, const char * argName = nullptr, int arg = 0)
+			: name(name), argName(argName), arg(arg), enabled(isActive()) {
+			if (enabled) start = Clock::now();
+		}
+		~Scope() {
+			if (enabled) record(name, argName, arg, start, Clock::now());
+		}
+	};
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// 作用域内记录名为name的事件, 可附带一个整数参数: TRACE_SCOPE("mesh", "index", i)
+#define TRACE_SCOPE(...) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+#endif
\ No newline at end of file
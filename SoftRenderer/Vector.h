@@ -4,6 +4,7 @@
 #define _VECTOR3_H_
 
 #include "Define.h"
+#include "MathSIMD.h"
 
 class Vector2 {
 public:
@@ -290,7 +291,7 @@ public:
 };
 
 
-class Vector4 {
+class MATH_ALIGN Vector4 {
 public:
 	float x, y, z, w;
 	Vector4() :x(0), y(0), z(0), w(1.f) {};
@@ -299,11 +300,20 @@ public:
 	Vector4(const Vector4 &v) :x(v.x), y(v.y), z(v.z), w(v.w) {};
 	~Vector4() {};
 
+#if SOFTRENDERER_SIMD_MATH
+	explicit Vector4(__m128 v) { _mm_store_ps(&x, v); }
+	inline __m128 load() const { return _mm_load_ps(&x); }
+#endif
+
 	inline float operator [] (uint8_t i) const { return (&x)[i]; }
 	inline float & operator [] (uint8_t i) { return (&x)[i]; }
 
 	inline Vector4 operator-() const {
+#if SOFTRENDERER_SIMD_MATH
+		return Vector4(MathSIMD::withW1(_mm_xor_ps(load(), _mm_set1_ps(-0.0f))));
+#else
 		return Vector4(-x, -y, -z);
+#endif
 	}
 
 	inline bool operator==(const Vector4 & v) const {
@@ -314,6 +324,48 @@ public:
 		return x != v.x || y != v.y || z != v.z || w != v.w;
 	}
 
+#if SOFTRENDERER_SIMD_MATH
+	// 与标量版本相同: 二元运算结果的w为1, 复合赋值运算不改变w
+	inline Vector4 operator+(const Vector4 & v) const {
+		return Vector4(MathSIMD::withW1(_mm_add_ps(load(), v.load())));
+	}
+	inline Vector4 operator-(const Vector4 & v) const {
+		return Vector4(MathSIMD::withW1(_mm_sub_ps(load(), v.load())));
+	}
+
+	inline float operator*(const Vector4 & v) const {
+		return MathSIMD::dot3(load(), v.load());
+	}
+
+	inline Vector4 operator*(const float a) const {
+		return Vector4(MathSIMD::withW1(_mm_mul_ps(load(), _mm_set1_ps(a))));
+	}
+	inline Vector4 operator/(const float a) const {
+		return Vector4(MathSIMD::withW1(_mm_mul_ps(load(), _mm_set1_ps(1.0f / a))));
+	}
+
+	inline Vector4 & operator+=(const Vector4 & v) {
+		_mm_store_ps(&x, MathSIMD::keepW(_mm_add_ps(load(), v.load()), load()));
+		return *this;
+	}
+	inline Vector4 & operator-=(const Vector4 & v) {
+		_mm_store_ps(&x, MathSIMD::keepW(_mm_sub_ps(load(), v.load()), load()));
+		return *this;
+	}
+	inline Vector4 & operator*=(const Vector4 & v) {
+		_mm_store_ps(&x, MathSIMD::keepW(_mm_mul_ps(load(), v.load()), load()));
+		return *this;
+	}
+
+	inline Vector4 & operator*=(const float a) {
+		_mm_store_ps(&x, MathSIMD::keepW(_mm_mul_ps(load(), _mm_set1_ps(a)), load()));
+		return *this;
+	}
+	inline Vector4 & operator/=(const float a) {
+		_mm_store_ps(&x, MathSIMD::keepW(_mm_mul_ps(load(), _mm_set1_ps(1.0f / a)), load()));
+		return *this;
+	}
+#else
 	inline Vector4 operator+(const Vector4 & v) const {
 		return Vector4(x + v.x, y + v.y, z + v.z);
 	}
@@ -355,6 +407,7 @@ public:
 		x *= oneOverA, y *= oneOverA, z *= oneOverA;
 		return *this;
 	}
+#endif
 
 	// 将齐次坐标转换到笛卡尔坐标
 	inline explicit operator Vector3() const {
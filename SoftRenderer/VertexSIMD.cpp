@@ -0,0 +1,139 @@
+#include "VertexSIMD.h"
+
+// 各路径的乘加顺序与 Matrix44::apply / applyDir 以及 Pipeline::checkCVV / transformHomogenize 完全一致,
+// 结果与标量路径逐位相同
+
+// 把按通道存放的结果写回AoS的变换后顶点
+static inline void storeLanes(PostTransformVertex * out, int lanes, const float (*f)[8], const int * cvv, bool normal) {
+	for (int l = 0; l < lanes; l++) {
+		PostTransformVertex & t = out[l];
+		t.clip = Vector4(f[0][l], f[1][l], f[2][l], f[3][l]);
+		t.screen = Vector3(f[4][l], f[5][l], f[6][l]);
+		if (normal) t.normal = Vector3(f[7][l], f[8][l], f[9][l]);
+		t.cvv = cvv[l];
+	}
+}
+
+////          SSE2          ////
+
+void VertexSIMD::transform_SSE2(const VertexBatch & b, size_t begin, size_t end) {
+	const VertexStreams & s = *b.streams;
+	const float (*m)[4] = b.transform->x;
+	const __m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]), m03 = _mm_set1_ps(m[0][3]);
+	const __m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]), m13 = _mm_set1_ps(m[1][3]);
+	const __m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]), m23 = _mm_set1_ps(m[2][3]);
+	const __m128 m30 = _mm_set1_ps(m[3][0]), m31 = _mm_set1_ps(m[3][1]), m32 = _mm_set1_ps(m[3][2]), m33 = _mm_set1_ps(m[3][3]);
+	const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 width = _mm_set1_ps(b.screenWidth), height = _mm_set1_ps(b.screenHeight);
+	const bool normal = b.normalMatrix != nullptr;
+	const float (*n)[4] = normal ? b.normalMatrix->x : m;
+
+	alignas(16) float f[10][8];
+	alignas(16) int cvv[4];
+	for (size_t i = begin; i < end; i += 4) {
+		__m128 px = _mm_loadu_ps(&s.x[i]), py = _mm_loadu_ps(&s.y[i]), pz = _mm_loadu_ps(&s.z[i]);
+		// 裁剪空间坐标
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m00), _mm_mul_ps(py, m10)), _mm_mul_ps(pz, m20)), m30);
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m01), _mm_mul_ps(py, m11)), _mm_mul_ps(pz, m21)), m31);
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m02), _mm_mul_ps(py, m12)), _mm_mul_ps(pz, m22)), m32);
+		__m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m03), _mm_mul_ps(py, m13)), _mm_mul_ps(pz, m23)), m33);
+
+		// CVV测试
+		__m128 nw = _mm_xor_ps(cw, sign);
+		__m128i code = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cz, zero)), _mm_set1_epi32(1));
+		code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(cz, cw)), _mm_set1_epi32(2)));
+		code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cx, nw)), _mm_set1_epi32(4)));
+		code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(cx, cw)), _mm_set1_epi32(8)));
+		code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cy, nw)), _mm_set1_epi32(16)));
+		code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(cy, cw)), _mm_set1_epi32(32)));
+
+		// 归一化到屏幕空间
+		__m128 rw = _mm_div_ps(one, cw);
+		__m128 sx = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(cx, rw), one), width), half);
+		__m128 sy = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(cy, rw)), height), half);
+		__m128 sz = _mm_mul_ps(cz, rw);
+
+		_mm_store_ps(f[0], cx); _mm_store_ps(f[1], cy); _mm_store_ps(f[2], cz); _mm_store_ps(f[3], cw);
+		_mm_store_ps(f[4], sx); _mm_store_ps(f[5], sy); _mm_store_ps(f[6], sz);
+		_mm_store_si128((__m128i *)cvv, code);
+
+		if (normal) {
+			__m128 nx = _mm_loadu_ps(&s.nx[i]), ny = _mm_loadu_ps(&s.ny[i]), nz = _mm_loadu_ps(&s.nz[i]);
+			_mm_store_ps(f[7], _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(n[0][0])), _mm_mul_ps(ny, _mm_set1_ps(n[1][0]))), _mm_mul_ps(nz, _mm_set1_ps(n[2][0]))));
+			_mm_store_ps(f[8], _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(n[0][1])), _mm_mul_ps(ny, _mm_set1_ps(n[1][1]))), _mm_mul_ps(nz, _mm_set1_ps(n[2][1]))));
+			_mm_store_ps(f[9], _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(n[0][2])), _mm_mul_ps(ny, _mm_set1_ps(n[1][2]))), _mm_mul_ps(nz, _mm_set1_ps(n[2][2]))));
+		}
+		storeLanes(b.out + i, 4, f, cvv, normal);
+	}
+}
+
+////          AVX2          ////
+
+// 不使用FMA: 融合乘加的舍入与标量路径不同
+#ifdef _MSC_VER
+#define VERTEX_TARGET_AVX2
+#else
+#define VERTEX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+VERTEX_TARGET_AVX2
+void VertexSIMD::transform_AVX2(const VertexBatch & b, size_t begin, size_t end) {
+	const VertexStreams & s = *b.streams;
+	const float (*m)[4] = b.transform->x;
+	const __m256 m00 = _mm256_set1_ps(m[0][0]), m01 = _mm256_set1_ps(m[0][1]), m02 = _mm256_set1_ps(m[0][2]), m03 = _mm256_set1_ps(m[0][3]);
+	const __m256 m10 = _mm256_set1_ps(m[1][0]), m11 = _mm256_set1_ps(m[1][1]), m12 = _mm256_set1_ps(m[1][2]), m13 = _mm256_set1_ps(m[1][3]);
+	const __m256 m20 = _mm256_set1_ps(m[2][0]), m21 = _mm256_set1_ps(m[2][1]), m22 = _mm256_set1_ps(m[2][2]), m23 = _mm256_set1_ps(m[2][3]);
+	const __m256 m30 = _mm256_set1_ps(m[3][0]), m31 = _mm256_set1_ps(m[3][1]), m32 = _mm256_set1_ps(m[3][2]), m33 = _mm256_set1_ps(m[3][3]);
+	const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f), zero = _mm256_setzero_ps();
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 width = _mm256_set1_ps(b.screenWidth), height = _mm256_set1_ps(b.screenHeight);
+	const bool normal = b.normalMatrix != nullptr;
+	const float (*n)[4] = normal ? b.normalMatrix->x : m;
+
+	alignas(32) float f[10][8];
+	alignas(32) int cvv[8];
+	for (size_t i = begin; i < end; i += 8) {
+		__m256 px = _mm256_loadu_ps(&s.x[i]), py = _mm256_loadu_ps(&s.y[i]), pz = _mm256_loadu_ps(&s.z[i]);
+		// 裁剪空间坐标
+		__m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, m00), _mm256_mul_ps(py, m10)), _mm256_mul_ps(pz, m20)), m30);
+		__m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, m01), _mm256_mul_ps(py, m11)), _mm256_mul_ps(pz, m21)), m31);
+		__m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, m02), _mm256_mul_ps(py, m12)), _mm256_mul_ps(pz, m22)), m32);
+		__m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, m03), _mm256_mul_ps(py, m13)), _mm256_mul_ps(pz, m23)), m33);
+
+		// CVV测试
+		__m256 nw = _mm256_xor_ps(cw, sign);
+		__m256i code = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cz, zero, _CMP_LT_OQ)), _mm256_set1_epi32(1));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cz, cw, _CMP_GT_OQ)), _mm256_set1_epi32(2)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cx, nw, _CMP_LT_OQ)), _mm256_set1_epi32(4)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cx, cw, _CMP_GT_OQ)), _mm256_set1_epi32(8)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cy, nw, _CMP_LT_OQ)), _mm256_set1_epi32(16)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cy, cw, _CMP_GT_OQ)), _mm256_set1_epi32(32)));
+
+		// 归一化到屏幕空间
+		__m256 rw = _mm256_div_ps(one, cw);
+		__m256 sx = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(cx, rw), one), width), half);
+		__m256 sy = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(cy, rw)), height), half);
+		__m256 sz = _mm256_mul_ps(cz, rw);
+
+		_mm256_store_ps(f[0], cx); _mm256_store_ps(f[1], cy); _mm256_store_ps(f[2], cz); _mm256_store_ps(f[3], cw);
+		_mm256_store_ps(f[4], sx); _mm256_store_ps(f[5], sy); _mm256_store_ps(f[6], sz);
+		_mm256_store_si256((__m256i *)cvv, code);
+
+		if (normal) {
+			__m256 nx = _mm256_loadu_ps(&s.nx[i]), ny = _mm256_loadu_ps(&s.ny[i]), nz = _mm256_loadu_ps(&s.nz[i]);
+			_mm256_store_ps(f[7], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_set1_ps(n[0][0])), _mm256_mul_ps(ny, _mm256_set1_ps(n[1][0]))), _mm256_mul_ps(nz, _mm256_set1_ps(n[2][0]))));
+			_mm256_store_ps(f[8], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_set1_ps(n[0][1])), _mm256_mul_ps(ny, _mm256_set1_ps(n[1][1]))), _mm256_mul_ps(nz, _mm256_set1_ps(n[2][1]))));
+			_mm256_store_ps(f[9], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_set1_ps(n[0][2])), _mm256_mul_ps(ny, _mm256_set1_ps(n[1][2]))), _mm256_mul_ps(nz, _mm256_set1_ps(n[2][2]))));
+		}
+		storeLanes(b.out + i, 8, f, cvv, normal);
+	}
+}
+
+VertexTransformFunc VertexSIMD::select(Simd::Level maxLevel) {
+	switch (MIN(Simd::level(), maxLevel)) {
+	case Simd::AVX2: return transform_AVX2;
+	case Simd::SSE2: return transform_SSE2;
+	default: return nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef _VERTEXSIMD_H_
+#define _VERTEXSIMD_H_
+
+#include "Primitives.h"
+#include "Matrix44.h"
+#include "Simd.h"
+
+// 变换后的顶点(每帧每个Mesh顶点只变换一次)
+struct PostTransformVertex {
+	Vector4 clip;               // 裁剪空间坐标
+	Vector3 screen;             // 屏幕空间坐标
+	Vector3 normal;             // 视图空间法线(只在非线框模式下计算)
+	int cvv;                    // CVV测试结果, 0为在CVV内
+};
+
+// 一次批量顶点变换的输入输出
+struct VertexBatch {
+	const VertexStreams * streams;
+	const Matrix44 * transform;     // 模型-视图-投影矩阵
+	const Matrix44 * normalMatrix;  // 法线变换矩阵(为空时不计算法线)
+	float screenWidth, screenHeight;
+	PostTransformVertex * out;      // 长度不小于streams->paddedCount()
+};
+
+// 变换[begin, end)范围内的顶点, begin与end需按VertexStreams::BATCH_ALIGN对齐
+typedef void(*VertexTransformFunc)(const VertexBatch & batch, size_t begin, size_t end);
+
+namespace VertexSIMD {
+	// 每次变换4个顶点(SSE2)
+	void transform_SSE2(const VertexBatch & batch, size_t begin, size_t end);
+	// 每次变换8个顶点(AVX2)
+	void transform_AVX2(const VertexBatch & batch, size_t begin, size_t end);
+
+	// 根据CPUID选择不超过maxLevel的最快实现,返回空时使用标量路径
+	VertexTransformFunc select(Simd::Level maxLevel = Simd::AVX2);
+}
+
+#endif
\ No newline at end of file
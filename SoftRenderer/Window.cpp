@@ -1,3 +1,5 @@
+#ifdef _WIN32
+
 #include "Window.h"
 #include <time.h>
 
@@ -139,4 +141,6 @@ int * Window::operator()(unsigned int index) {
 int * Window::operator()(int x, int y) {
 	if (!screen_running) return nullptr;
 	return (int *)screen_fb + (y * screen_w + x);
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
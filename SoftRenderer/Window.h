@@ -3,6 +3,9 @@
 #ifndef _WINDOW_H_
 #define _WINDOW_H_
 
+// 窗口只在Windows平台下可用, 其他平台使用无窗口渲染(Headless.h)
+#ifdef _WIN32
+
 #include <unordered_map>
 #include <windows.h>
 #include <tchar.h>
@@ -50,4 +53,6 @@ public:
 	int * operator()(int x, int y);
 };
 
+#endif
+
 #endif
\ No newline at end of file